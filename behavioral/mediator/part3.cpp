@@ -0,0 +1,480 @@
+/*
+  Mediator under concurrency.
+
+  In part2, ShoppingMediator reads the quantities with GetPriceAndQuantity and only later calls
+  Store::SellProduct. If many restaurants shop at the same time, the stock can change between the
+  two calls, and an order that is only partially filled is never rolled back.
+
+  ConcurrentShoppingMediator fixes this by reserving across all stores atomically:
+  1. Lock every store that carries the product. Locks are always taken in the same global order
+     (by store address), so two mediators can never deadlock each other.
+  2. Plan the purchase against a consistent view of the stock.
+  3. Either sell the whole plan or nothing at all (all-or-nothing fill).
+
+  Only the stores that carry the product are locked, so orders for different products never
+  contend with each other. The list of those stores is read from an immutable snapshot without
+  taking any lock; the snapshot is rebuilt only after some store starts carrying a new product.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+class Store {
+ public:
+  Store(std::string name) : name_(name) {}
+
+  virtual ~Store() = default;
+
+  void AddProduct(const std::string& name, int price, int quantity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = inventory_.insert_or_assign(name, std::make_pair(price, quantity));
+    if (inserted) {
+      catalog_version_.fetch_add(1, std::memory_order_release);
+    }
+  }
+
+  // Changes whenever any store starts carrying a new product.
+  static uint64_t catalog_version() {
+    return catalog_version_.load(std::memory_order_acquire);
+  }
+
+  std::tuple<int, int, std::string> GetPriceAndQuantity(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return GetPriceAndQuantityLocked(name);
+  }
+
+  bool SellProduct(const std::string& name, int quantity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return SellProductLocked(name, quantity);
+  }
+
+  /*
+    The *Locked variants must only be called while holding the store lock (see Lock()).
+    They let a mediator read and sell under a single critical section.
+  */
+  std::unique_lock<std::mutex> Lock() const {
+    return std::unique_lock<std::mutex>(mutex_);
+  }
+
+  std::tuple<int, int, std::string> GetPriceAndQuantityLocked(const std::string& name) const {
+    auto it = inventory_.find(name);
+    if (it != inventory_.end()) {
+      return std::make_tuple(it->second.first, it->second.second, name_);
+    }
+    return {-1, 0, ""};  // Not found
+  }
+
+  bool SellProductLocked(const std::string& name, int quantity) {
+    auto it = inventory_.find(name);
+    if (it != inventory_.end() && it->second.second >= quantity) {
+      it->second.second -= quantity;
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  bool HasProduct(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inventory_.find(name) != inventory_.end();
+  }
+
+  std::string name() const {
+    return name_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, std::pair<int, int>> inventory_;  // product name, (price, quantity)
+  std::string name_;
+
+  static std::atomic<uint64_t> catalog_version_;
+};
+
+std::atomic<uint64_t> Store::catalog_version_{0};
+
+class Wallmart : public Store {
+ public:
+  Wallmart() : Store("Wallmart") {
+    AddProduct("Steak", 200, 100);
+    AddProduct("Fish", 400, 5);
+  }
+};
+
+class Kroger : public Store {
+ public:
+  Kroger() : Store("Kroger") {
+    AddProduct("Steak", 100, 50);
+    AddProduct("Fish", 200, 50);
+  }
+};
+
+class Publix : public Store {
+ public:
+  Publix() : Store("Publix") {
+    AddProduct("Steak", 5, 5);
+    AddProduct("Fish", 10, 5);
+  }
+};
+
+class Costco : public Store {
+ public:
+  Costco() : Store("Costco") {
+    AddProduct("Steak", 1, 1000);
+    AddProduct("Fish", 1, 1000);
+  }
+};
+
+using Purchase = std::tuple<int, int, std::string>;  // price, quantity, store name
+using PriceOrder = std::function<bool(int, int)>;
+
+class IShoppingMediator {
+ public:
+  virtual ~IShoppingMediator() = default;
+
+  std::vector<Purchase> BuyCheapestSteak(int quantity) {
+    return Buy("Steak", quantity, std::less<int>());
+  }
+
+  std::vector<Purchase> BuyMostExpensiveFish(int quantity) {
+    return Buy("Fish", quantity, std::greater<int>());
+  }
+
+ protected:
+  virtual std::vector<Purchase> Buy(const std::string& product, int quantity,
+                                    const PriceOrder& order) = 0;
+};
+
+/*
+  Same algorithm as part2. Each Store call is thread-safe on its own, but the mediator as a whole
+  is not atomic: the stock may change between reading and selling, and partial fills stay sold.
+*/
+class ShoppingMediator : public IShoppingMediator {
+ public:
+  ShoppingMediator(std::vector<Store*> stores) : stores_(stores) {}
+
+ protected:
+  std::vector<Purchase> Buy(const std::string& product, int quantity,
+                            const PriceOrder& order) override {
+    std::vector<std::tuple<int, int, Store*>> catalog_vec;  // price, quantity, store
+    for (const auto& store : stores_) {
+      auto catalog = store->GetPriceAndQuantity(product);
+      catalog_vec.push_back(std::make_tuple(std::get<0>(catalog), std::get<1>(catalog), store));
+    }
+
+    std::sort(catalog_vec.begin(), catalog_vec.end(), [&order](const auto& a, const auto& b) {
+      return order(std::get<0>(a), std::get<0>(b));
+    });
+
+    std::vector<Purchase> purchase_vec;
+    int remaining_quantity = quantity;
+
+    for (const auto& [price, available, store] : catalog_vec) {
+      if (available > 0 && remaining_quantity > 0) {
+        int purchase_quantity = std::min(available, remaining_quantity);
+        if (store->SellProduct(product, purchase_quantity)) {
+          purchase_vec.push_back(std::make_tuple(price, purchase_quantity, store->name()));
+          remaining_quantity -= purchase_quantity;
+        }
+      }
+      if (remaining_quantity <= 0) {
+        break;
+      }
+    }
+    return purchase_vec;
+  }
+
+ private:
+  std::vector<Store*> stores_;
+};
+
+/*
+  Concurrent mediator with all-or-nothing fills.
+
+  Returns an empty purchase list if the order cannot be filled completely; in that case no store
+  is modified.
+*/
+class ConcurrentShoppingMediator : public IShoppingMediator {
+ public:
+  ConcurrentShoppingMediator(std::vector<Store*> stores) : stores_(stores), participants_(nullptr) {
+    // Fixed global lock order: by address. Any mediator sharing these stores agrees on it.
+    std::sort(stores_.begin(), stores_.end());
+    stores_.erase(std::unique(stores_.begin(), stores_.end()), stores_.end());
+  }
+
+  ConcurrentShoppingMediator(const ConcurrentShoppingMediator&) = delete;
+  ConcurrentShoppingMediator& operator=(const ConcurrentShoppingMediator&) = delete;
+
+ protected:
+  std::vector<Purchase> Buy(const std::string& product, int quantity,
+                            const PriceOrder& order) override {
+    // Only stores carrying the product take part in the transaction.
+    const std::vector<Store*>& participants = ParticipantsFor(product);
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    locks.reserve(participants.size());
+    for (Store* store : participants) {
+      locks.push_back(store->Lock());
+    }
+
+    std::vector<std::tuple<int, int, Store*>> catalog_vec;  // price, quantity, store
+    catalog_vec.reserve(participants.size());
+    int total_available = 0;
+    for (Store* store : participants) {
+      auto catalog = store->GetPriceAndQuantityLocked(product);
+      catalog_vec.push_back(std::make_tuple(std::get<0>(catalog), std::get<1>(catalog), store));
+      total_available += std::get<1>(catalog);
+    }
+
+    if (total_available < quantity) {
+      return {};  // Cannot fill the whole order, nothing is sold
+    }
+
+    std::sort(catalog_vec.begin(), catalog_vec.end(), [&order](const auto& a, const auto& b) {
+      return order(std::get<0>(a), std::get<0>(b));
+    });
+
+    std::vector<Purchase> purchase_vec;
+    int remaining_quantity = quantity;
+
+    for (const auto& [price, available, store] : catalog_vec) {
+      if (remaining_quantity <= 0) {
+        break;
+      }
+      if (available > 0) {
+        int purchase_quantity = std::min(available, remaining_quantity);
+        // Cannot fail: we hold every participant's lock and checked the quantity above.
+        store->SellProductLocked(product, purchase_quantity);
+        purchase_vec.push_back(std::make_tuple(price, purchase_quantity, store->name()));
+        remaining_quantity -= purchase_quantity;
+      }
+    }
+    return purchase_vec;
+  }
+
+ private:
+  // Stores carrying each product, sorted, as of one catalog version. Never modified once
+  // published.
+  struct ParticipantTable {
+    uint64_t catalog_version;
+    std::map<std::string, std::vector<Store*>> stores;  // By product name
+  };
+
+  /*
+    The stores that carry `product`, sorted. Reads the published table without locking.
+    If the product is missing or a store has started carrying a new product since the table was
+    built, a new table is built under rebuild_mutex_, so a store that adds the product later is
+    offered the next order.
+
+    Replaced tables are kept until the mediator is destroyed, since a Buy may still read them.
+    Catalogs only grow, so there is at most one per product added to a store or newly looked up.
+  */
+  const std::vector<Store*>& ParticipantsFor(const std::string& product) {
+    uint64_t catalog_version = Store::catalog_version();
+    const ParticipantTable* table = participants_.load(std::memory_order_acquire);
+    if (table != nullptr && table->catalog_version == catalog_version) {
+      auto it = table->stores.find(product);
+      if (it != table->stores.end()) {
+        return it->second;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(rebuild_mutex_);
+    table = participants_.load(std::memory_order_acquire);
+    if (table != nullptr && table->catalog_version == catalog_version) {
+      auto it = table->stores.find(product);  // Another thread may have just added it
+      if (it != table->stores.end()) {
+        return it->second;
+      }
+    }
+
+    auto next = std::make_unique<ParticipantTable>();
+    next->catalog_version = catalog_version;
+    next->stores[product];
+    if (table != nullptr) {
+      for (const auto& [name, stores] : table->stores) {
+        next->stores[name];
+      }
+    }
+    for (auto& [name, participants] : next->stores) {
+      for (Store* store : stores_) {  // stores_ is sorted, so participants are too
+        if (store->HasProduct(name)) {
+          participants.push_back(store);
+        }
+      }
+    }
+    participants_.store(next.get(), std::memory_order_release);
+    tables_.push_back(std::move(next));
+    return tables_.back()->stores.at(product);
+  }
+
+  std::vector<Store*> stores_;
+
+  std::atomic<const ParticipantTable*> participants_;  // Latest of tables_
+  std::mutex rebuild_mutex_;
+  std::vector<std::unique_ptr<ParticipantTable>> tables_;  // Every table ever published
+};
+
+class Restaurant {
+ public:
+  Restaurant(std::string name) : name_(name) {}
+
+  virtual ~Restaurant() = default;
+
+  std::string name() const {
+    return name_;
+  }
+
+ private:
+  std::string name_;
+};
+
+class SteakRestaurant : public Restaurant {
+ public:
+  SteakRestaurant(IShoppingMediator* mediator) :
+      Restaurant("SteakRestaurant"), mediator_(mediator) {}
+
+  void BuyCheapestSteak(int quantity) {
+    auto purchase_vec = mediator_->BuyCheapestSteak(quantity);
+    if (purchase_vec.empty()) {
+      std::cout << "SteakRestaurant could not buy " << quantity << " steaks\n";
+      return;
+    }
+
+    std::cout << "SteakRestaurant Successfully bought " << quantity << " steaks from:\n";
+    for (const auto& purchase : purchase_vec) {
+      std::cout << " - " << std::get<1>(purchase) << " steaks at $" << std::get<0>(purchase)
+                << " from " << std::get<2>(purchase) << "\n";
+    }
+  }
+
+ private:
+  IShoppingMediator* mediator_;
+};
+
+class SushiRestaurant : public Restaurant {
+ public:
+  SushiRestaurant(IShoppingMediator* mediator) :
+      Restaurant("SushiRestaurant"), mediator_(mediator) {}
+
+  void BuyMostExpensiveFish(int quantity) {
+    auto purchase_vec = mediator_->BuyMostExpensiveFish(quantity);
+    if (purchase_vec.empty()) {
+      std::cout << "SushiRestaurant could not buy " << quantity << " fish\n";
+      return;
+    }
+
+    std::cout << "SushiRestaurant Successfully bought " << quantity << " fish from:\n";
+    for (const auto& purchase : purchase_vec) {
+      std::cout << " - " << std::get<1>(purchase) << " fish at $" << std::get<0>(purchase)
+                << " from " << std::get<2>(purchase) << "\n";
+    }
+  }
+
+ private:
+  IShoppingMediator* mediator_;
+};
+
+/*
+  Contention benchmark.
+
+  Many restaurant threads place random orders against the same small set of stores until the stock
+  runs out. The stock covers roughly 90% of the demand, so the last orders race for the leftovers.
+  We count orders that were filled only partially; the concurrent mediator must never produce one.
+*/
+template <typename Mediator>
+void RunContentionBenchmark(const std::string& label, int num_threads, int orders_per_thread) {
+  // Average order is 10.5 units, half of the orders are steak and half are fish.
+  int stock_per_store = static_cast<int>(num_threads * orders_per_thread * 10.5 / 2 * 0.9 / 4);
+
+  std::vector<std::unique_ptr<Store>> stores;
+  std::vector<Store*> store_ptrs;
+  int price = 100;
+  for (const char* name : {"Wallmart", "Kroger", "Publix", "Costco"}) {
+    stores.emplace_back(new Store(name));
+    stores.back()->AddProduct("Steak", price, stock_per_store);
+    stores.back()->AddProduct("Fish", price * 2, stock_per_store);
+    store_ptrs.push_back(stores.back().get());
+    price += 50;
+  }
+  Mediator mediator(store_ptrs);
+
+  std::atomic<long long> filled_orders(0);
+  std::atomic<long long> partial_orders(0);
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 rng(t);
+      std::uniform_int_distribution<int> quantity_dist(1, 20);
+      for (int i = 0; i < orders_per_thread; ++i) {
+        int quantity = quantity_dist(rng);
+        auto purchase_vec = (i % 2 == 0) ? mediator.BuyCheapestSteak(quantity)
+                                         : mediator.BuyMostExpensiveFish(quantity);
+        int bought = 0;
+        for (const auto& purchase : purchase_vec) {
+          bought += std::get<1>(purchase);
+        }
+        if (bought == quantity) {
+          filled_orders++;
+        } else if (bought > 0) {
+          partial_orders++;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  long long total_orders = static_cast<long long>(num_threads) * orders_per_thread;
+  std::cout << label << " | threads = " << num_threads
+            << ", orders/sec = " << static_cast<long long>(total_orders / duration.count())
+            << ", filled = " << filled_orders << ", partial = " << partial_orders << "\n";
+}
+
+int main() {
+  {
+    Wallmart wallmart;
+    Kroger kroger;
+    Publix publix;
+    Costco costco;
+
+    ConcurrentShoppingMediator mediator({&wallmart, &kroger, &publix, &costco});
+
+    SteakRestaurant steak_restaurant(&mediator);
+    steak_restaurant.BuyCheapestSteak(10);
+    steak_restaurant.BuyCheapestSteak(10000);  // Not enough stock, nothing is bought
+
+    SushiRestaurant sushi_restaurant(&mediator);
+    sushi_restaurant.BuyMostExpensiveFish(10);
+  }
+
+  std::cout << "----------------------------------\n";
+
+  unsigned int hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int num_threads : {1, 2, 4, static_cast<int>(hardware_threads) * 2}) {
+    RunContentionBenchmark<ShoppingMediator>("ShoppingMediator          ", num_threads, 20000);
+    RunContentionBenchmark<ConcurrentShoppingMediator>("ConcurrentShoppingMediator", num_threads,
+                                                       20000);
+  }
+  return 0;
+}
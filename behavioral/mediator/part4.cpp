@@ -0,0 +1,609 @@
+/*
+  Mediator with request coalescing.
+
+  In part2, every BuyCheapestSteak / BuyMostExpensiveFish call scans and sorts every store on its
+  own. When many restaurants buy at once, most of that work is repeated.
+
+  BatchingShoppingMediator queues purchase requests for a short window (batch_window) and then
+  handles the whole batch in one pass:
+  1. Requests are grouped by product and price order.
+  2. For each group, the stores are scanned and sorted once.
+  3. The sorted supply is handed out to the requests according to a fairness policy.
+  4. Each store is asked to sell once per group with the aggregated quantity.
+
+  Fairness policies:
+  - kFifo:    Requests are served in arrival order. Early requests get the best prices and, if the
+              supply runs short, the late ones are filled partially or not at all.
+  - kProRata: If the supply runs short, every request gets the same fraction of what it asked for.
+              Units left over by rounding are handed out in arrival order.
+
+  batch_window is the throughput-versus-latency knob: a longer window coalesces more requests per
+  pass, but every request waits up to that long before it is served.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class Store {
+ public:
+  Store(std::string name) : name_(name) {}
+
+  virtual ~Store() = default;
+
+  void AddProduct(const std::string& name, int price, int quantity) {
+    inventory_[name] = std::make_pair(price, quantity);
+  }
+
+  std::tuple<int, int, std::string> GetPriceAndQuantity(const std::string& name) const {
+    auto it = inventory_.find(name);
+    if (it != inventory_.end()) {
+      return std::make_tuple(it->second.first, it->second.second, name_);
+    }
+    return {-1, 0, ""};  // Not found
+  }
+
+  bool SellProduct(const std::string& name, int quantity) {
+    auto it = inventory_.find(name);
+    if (it != inventory_.end() && it->second.second >= quantity) {
+      it->second.second -= quantity;
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  std::string name() const {
+    return name_;
+  }
+
+ private:
+  std::map<std::string, std::pair<int, int>> inventory_;  // product name, (price, quantity)
+  std::string name_;
+};
+
+class Wallmart : public Store {
+ public:
+  Wallmart() : Store("Wallmart") {
+    AddProduct("Steak", 200, 100);
+    AddProduct("Fish", 400, 5);
+  }
+};
+
+class Kroger : public Store {
+ public:
+  Kroger() : Store("Kroger") {
+    AddProduct("Steak", 100, 50);
+    AddProduct("Fish", 200, 50);
+  }
+};
+
+class Publix : public Store {
+ public:
+  Publix() : Store("Publix") {
+    AddProduct("Steak", 5, 5);
+    AddProduct("Fish", 10, 5);
+  }
+};
+
+class Costco : public Store {
+ public:
+  Costco() : Store("Costco") {
+    AddProduct("Steak", 1, 1000);
+    AddProduct("Fish", 1, 1000);
+  }
+};
+
+using Purchase = std::tuple<int, int, std::string>;  // price, quantity, store name
+
+class IShoppingMediator {
+ public:
+  virtual ~IShoppingMediator() = default;
+
+  virtual std::vector<Purchase> BuyCheapestSteak(int quantity) = 0;
+
+  virtual std::vector<Purchase> BuyMostExpensiveFish(int quantity) = 0;
+};
+
+/*
+  Per-request mediator from part2, guarded by one mutex so that it can be shared by many threads.
+*/
+class ShoppingMediator : public IShoppingMediator {
+ public:
+  ShoppingMediator(std::vector<Store*> stores) : stores_(stores) {}
+
+  std::vector<Purchase> BuyCheapestSteak(int quantity) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Buy("Steak", quantity, true);
+  }
+
+  std::vector<Purchase> BuyMostExpensiveFish(int quantity) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return Buy("Fish", quantity, false);
+  }
+
+ private:
+  std::vector<Purchase> Buy(const std::string& product, int quantity, bool cheapest_first) {
+    std::vector<std::tuple<int, int, Store*>> catalog_vec;  // price, quantity, store
+    for (const auto& store : stores_) {
+      auto catalog = store->GetPriceAndQuantity(product);
+      catalog_vec.push_back(std::make_tuple(std::get<0>(catalog), std::get<1>(catalog), store));
+    }
+
+    std::sort(catalog_vec.begin(), catalog_vec.end(),
+              [cheapest_first](const auto& a, const auto& b) {
+                return cheapest_first ? std::get<0>(a) < std::get<0>(b)
+                                      : std::get<0>(a) > std::get<0>(b);
+              });
+
+    std::vector<Purchase> purchase_vec;
+    int remaining_quantity = quantity;
+
+    for (const auto& [price, available, store] : catalog_vec) {
+      if (available > 0 && remaining_quantity > 0) {
+        int purchase_quantity = std::min(available, remaining_quantity);
+        if (store->SellProduct(product, purchase_quantity)) {
+          purchase_vec.push_back(std::make_tuple(price, purchase_quantity, store->name()));
+          remaining_quantity -= purchase_quantity;
+        }
+      }
+      if (remaining_quantity <= 0) {
+        break;
+      }
+    }
+    return purchase_vec;
+  }
+
+  std::mutex mutex_;
+  std::vector<Store*> stores_;
+};
+
+class BatchingShoppingMediator : public IShoppingMediator {
+ public:
+  enum class FairnessPolicy { kFifo, kProRata };
+
+  BatchingShoppingMediator(std::vector<Store*> stores,
+                           std::chrono::microseconds batch_window = std::chrono::microseconds(100),
+                           FairnessPolicy policy = FairnessPolicy::kFifo,
+                           size_t max_batch_size = 1024) :
+      stores_(stores),
+      batch_window_(batch_window),
+      policy_(policy),
+      max_batch_size_(max_batch_size),
+      stopping_(false),
+      batches_(0),
+      requests_(0) {
+    dispatcher_ = std::thread(&BatchingShoppingMediator::DispatchLoop, this);
+  }
+
+  ~BatchingShoppingMediator() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    cv_.notify_one();
+    dispatcher_.join();
+  }
+
+  std::vector<Purchase> BuyCheapestSteak(int quantity) override {
+    return SubmitCheapestSteak(quantity).get();
+  }
+
+  std::vector<Purchase> BuyMostExpensiveFish(int quantity) override {
+    return SubmitMostExpensiveFish(quantity).get();
+  }
+
+  // Asynchronous variants: the future becomes ready once the batch holding the request is served.
+  std::future<std::vector<Purchase>> SubmitCheapestSteak(int quantity) {
+    return Submit("Steak", quantity, true);
+  }
+
+  std::future<std::vector<Purchase>> SubmitMostExpensiveFish(int quantity) {
+    return Submit("Fish", quantity, false);
+  }
+
+  double average_batch_size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return batches_ == 0 ? 0.0 : static_cast<double>(requests_) / batches_;
+  }
+
+ private:
+  struct Request {
+    std::string product;
+    int quantity;
+    bool cheapest_first;
+    std::promise<std::vector<Purchase>> promise;
+  };
+
+  std::future<std::vector<Purchase>> Submit(const std::string& product, int quantity,
+                                            bool cheapest_first) {
+    Request request{product, quantity, cheapest_first, {}};
+    auto future = request.promise.get_future();
+    bool notify;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(std::move(request));
+      notify = pending_.size() == 1 || pending_.size() >= max_batch_size_;
+    }
+    if (notify) {
+      cv_.notify_one();
+    }
+    return future;
+  }
+
+  void DispatchLoop() {
+    std::vector<Request> batch;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+          return;  // Stopping and nothing left to serve
+        }
+
+        // Let the batch fill up for one window, unless it is already full.
+        cv_.wait_for(lock, batch_window_,
+                     [this]() { return stopping_ || pending_.size() >= max_batch_size_; });
+
+        if (pending_.size() <= max_batch_size_) {
+          batch.swap(pending_);
+        } else {
+          batch.assign(std::make_move_iterator(pending_.begin()),
+                       std::make_move_iterator(pending_.begin() + max_batch_size_));
+          pending_.erase(pending_.begin(), pending_.begin() + max_batch_size_);
+        }
+        batches_++;
+        requests_ += batch.size();
+      }
+      ProcessBatch(batch);
+      batch.clear();
+    }
+  }
+
+  void ProcessBatch(std::vector<Request>& batch) {
+    // Group by (product, price order), keeping arrival order inside each group.
+    std::map<std::pair<std::string, bool>, std::vector<Request*>> groups;
+    for (auto& request : batch) {
+      groups[{request.product, request.cheapest_first}].push_back(&request);
+    }
+
+    for (auto& [key, requests] : groups) {
+      ProcessGroup(key.first, key.second, requests);
+    }
+  }
+
+  void ProcessGroup(const std::string& product, bool cheapest_first,
+                    std::vector<Request*>& requests) {
+    // One scan and one sort for the whole group.
+    std::vector<std::tuple<int, int, Store*>> catalog_vec;  // price, quantity, store
+    int supply = 0;
+    for (const auto& store : stores_) {
+      auto catalog = store->GetPriceAndQuantity(product);
+      if (std::get<1>(catalog) > 0) {
+        catalog_vec.push_back(std::make_tuple(std::get<0>(catalog), std::get<1>(catalog), store));
+        supply += std::get<1>(catalog);
+      }
+    }
+
+    std::sort(catalog_vec.begin(), catalog_vec.end(),
+              [cheapest_first](const auto& a, const auto& b) {
+                return cheapest_first ? std::get<0>(a) < std::get<0>(b)
+                                      : std::get<0>(a) > std::get<0>(b);
+              });
+
+    std::vector<int> allocation = Allocate(requests, supply);
+
+    // Hand out the sorted supply with a single cursor.
+    std::vector<int> sold(catalog_vec.size(), 0);
+    size_t cursor = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+      std::vector<Purchase> purchase_vec;
+      int remaining_quantity = allocation[i];
+      while (remaining_quantity > 0) {
+        int price = std::get<0>(catalog_vec[cursor]);
+        int available = std::get<1>(catalog_vec[cursor]) - sold[cursor];
+        int purchase_quantity = std::min(available, remaining_quantity);
+
+        purchase_vec.push_back(
+            std::make_tuple(price, purchase_quantity, std::get<2>(catalog_vec[cursor])->name()));
+        sold[cursor] += purchase_quantity;
+        remaining_quantity -= purchase_quantity;
+        if (sold[cursor] == std::get<1>(catalog_vec[cursor])) {
+          cursor++;
+        }
+      }
+      requests[i]->promise.set_value(std::move(purchase_vec));
+    }
+
+    // One sale per store for the whole group. Only the dispatcher sells, so this cannot fail.
+    for (size_t i = 0; i < catalog_vec.size(); ++i) {
+      if (sold[i] > 0) {
+        std::get<2>(catalog_vec[i])->SellProduct(product, sold[i]);
+      }
+    }
+  }
+
+  // Returns how many units each request receives. The total never exceeds the supply.
+  // A quantity of zero or less asks for nothing, as in part1.
+  std::vector<int> Allocate(const std::vector<Request*>& requests, int supply) const {
+    std::vector<int> allocation(requests.size(), 0);
+
+    std::vector<int> wanted(requests.size());
+    long long demand = 0;
+    for (size_t i = 0; i < requests.size(); ++i) {
+      wanted[i] = std::max(requests[i]->quantity, 0);
+      demand += wanted[i];
+    }
+
+    int remaining_supply = supply;
+    if (policy_ == FairnessPolicy::kProRata && demand > supply) {
+      for (size_t i = 0; i < requests.size(); ++i) {
+        allocation[i] = static_cast<int>(wanted[i] * static_cast<long long>(supply) / demand);
+        remaining_supply -= allocation[i];
+      }
+    }
+
+    // FIFO, or hand out the units left over by pro-rata rounding in arrival order.
+    for (size_t i = 0; i < requests.size() && remaining_supply > 0; ++i) {
+      int extra = std::min(wanted[i] - allocation[i], remaining_supply);
+      allocation[i] += extra;
+      remaining_supply -= extra;
+    }
+    return allocation;
+  }
+
+  std::vector<Store*> stores_;
+  const std::chrono::microseconds batch_window_;
+  const FairnessPolicy policy_;
+  const size_t max_batch_size_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Request> pending_;
+  bool stopping_;
+  long long batches_;
+  long long requests_;
+
+  std::thread dispatcher_;
+};
+
+class Restaurant {
+ public:
+  Restaurant(std::string name) : name_(name) {}
+
+  virtual ~Restaurant() = default;
+
+  std::string name() const {
+    return name_;
+  }
+
+ private:
+  std::string name_;
+};
+
+class SteakRestaurant : public Restaurant {
+ public:
+  SteakRestaurant(IShoppingMediator* mediator) :
+      Restaurant("SteakRestaurant"), mediator_(mediator) {}
+
+  void BuyCheapestSteak(int quantity) {
+    auto purchase_vec = mediator_->BuyCheapestSteak(quantity);
+
+    std::cout << "SteakRestaurant Successfully bought " << quantity << " steaks from:\n";
+    for (const auto& purchase : purchase_vec) {
+      std::cout << " - " << std::get<1>(purchase) << " steaks at $" << std::get<0>(purchase)
+                << " from " << std::get<2>(purchase) << "\n";
+    }
+  }
+
+ private:
+  IShoppingMediator* mediator_;
+};
+
+class SushiRestaurant : public Restaurant {
+ public:
+  SushiRestaurant(IShoppingMediator* mediator) :
+      Restaurant("SushiRestaurant"), mediator_(mediator) {}
+
+  void BuyMostExpensiveFish(int quantity) {
+    auto purchase_vec = mediator_->BuyMostExpensiveFish(quantity);
+
+    std::cout << "SushiRestaurant Successfully bought " << quantity << " fish from:\n";
+    for (const auto& purchase : purchase_vec) {
+      std::cout << " - " << std::get<1>(purchase) << " fish at $" << std::get<0>(purchase)
+                << " from " << std::get<2>(purchase) << "\n";
+    }
+  }
+
+ private:
+  IShoppingMediator* mediator_;
+};
+
+void PrintPurchases(const std::string& label, const std::vector<Purchase>& purchase_vec) {
+  int total = 0;
+  std::cout << label << ":";
+  for (const auto& purchase : purchase_vec) {
+    std::cout << " " << std::get<1>(purchase) << "@$" << std::get<0>(purchase) << "("
+              << std::get<2>(purchase) << ")";
+    total += std::get<1>(purchase);
+  }
+  std::cout << " -> " << total << " fish\n";
+}
+
+/*
+  Closed-loop benchmark: every restaurant thread places one order, waits for it and places the
+  next. Stock is large enough that every order is filled.
+*/
+template <typename Mediator, typename... Args>
+void RunThroughputBenchmark(const std::string& label, int num_restaurants,
+                            int orders_per_restaurant, Args... args) {
+  std::vector<std::unique_ptr<Store>> stores;
+  std::vector<Store*> store_ptrs;
+  for (int i = 0; i < 16; ++i) {
+    stores.emplace_back(new Store("Store" + std::to_string(i)));
+    stores.back()->AddProduct("Steak", 100 + i, 1000000);
+    stores.back()->AddProduct("Fish", 200 + i, 1000000);
+    store_ptrs.push_back(stores.back().get());
+  }
+  Mediator mediator(store_ptrs, args...);
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_restaurants; ++t) {
+    threads.emplace_back([&mediator, orders_per_restaurant, t]() {
+      for (int i = 0; i < orders_per_restaurant; ++i) {
+        if ((i + t) % 2 == 0) {
+          mediator.BuyCheapestSteak(1 + i % 10);
+        } else {
+          mediator.BuyMostExpensiveFish(1 + i % 10);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  long long total_orders = static_cast<long long>(num_restaurants) * orders_per_restaurant;
+  double average_latency_us = duration.count() * 1e6 * num_restaurants / total_orders;
+  std::cout << label
+            << " | orders/sec = " << static_cast<long long>(total_orders / duration.count())
+            << ", avg latency = " << average_latency_us << " us";
+  if constexpr (std::is_same_v<Mediator, BatchingShoppingMediator>) {
+    std::cout << ", avg batch = " << mediator.average_batch_size();
+  }
+  std::cout << "\n";
+}
+
+/*
+  Pipelined benchmark: every restaurant keeps `in_flight` orders outstanding through the Submit*
+  API. This is where coalescing pays off, because one batch serves many orders per handoff.
+*/
+void RunPipelinedBenchmark(const std::string& label, int num_restaurants, int orders_per_restaurant,
+                           int in_flight, std::chrono::microseconds batch_window) {
+  std::vector<std::unique_ptr<Store>> stores;
+  std::vector<Store*> store_ptrs;
+  for (int i = 0; i < 16; ++i) {
+    stores.emplace_back(new Store("Store" + std::to_string(i)));
+    stores.back()->AddProduct("Steak", 100 + i, 1000000);
+    stores.back()->AddProduct("Fish", 200 + i, 1000000);
+    store_ptrs.push_back(stores.back().get());
+  }
+  BatchingShoppingMediator mediator(store_ptrs, batch_window);
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_restaurants; ++t) {
+    threads.emplace_back([&mediator, orders_per_restaurant, in_flight, t]() {
+      std::vector<std::future<std::vector<Purchase>>> futures;
+      for (int i = 0; i < orders_per_restaurant; ++i) {
+        if ((i + t) % 2 == 0) {
+          futures.push_back(mediator.SubmitCheapestSteak(1 + i % 10));
+        } else {
+          futures.push_back(mediator.SubmitMostExpensiveFish(1 + i % 10));
+        }
+        if (static_cast<int>(futures.size()) == in_flight) {
+          for (auto& future : futures) {
+            future.get();
+          }
+          futures.clear();
+        }
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  long long total_orders = static_cast<long long>(num_restaurants) * orders_per_restaurant;
+  std::cout << label
+            << " | orders/sec = " << static_cast<long long>(total_orders / duration.count())
+            << ", avg batch = " << mediator.average_batch_size() << "\n";
+}
+
+int main() {
+  {
+    Wallmart wallmart;
+    Kroger kroger;
+    Publix publix;
+    Costco costco;
+
+    BatchingShoppingMediator mediator({&wallmart, &kroger, &publix, &costco});
+
+    SteakRestaurant steak_restaurant(&mediator);
+    steak_restaurant.BuyCheapestSteak(10);
+
+    SushiRestaurant sushi_restaurant(&mediator);
+    sushi_restaurant.BuyMostExpensiveFish(10);
+  }
+
+  std::cout << "----------------------------------\n";
+
+  /*
+    Three sushi restaurants ask for 60 fish in total, but Wallmart, Kroger and Publix only have
+    60 - 10 = 50 left after the first order. The fairness policy decides who gets what.
+  */
+  for (auto policy : {BatchingShoppingMediator::FairnessPolicy::kFifo,
+                      BatchingShoppingMediator::FairnessPolicy::kProRata}) {
+    Wallmart wallmart;
+    Kroger kroger;
+    Publix publix;
+
+    // A long window makes sure that all three requests land in the same batch.
+    BatchingShoppingMediator mediator({&wallmart, &kroger, &publix},
+                                      std::chrono::microseconds(100000), policy);
+    mediator.BuyMostExpensiveFish(10);
+
+    auto order1 = mediator.SubmitMostExpensiveFish(30);
+    auto order2 = mediator.SubmitMostExpensiveFish(20);
+    auto order3 = mediator.SubmitMostExpensiveFish(10);
+
+    std::cout << (policy == BatchingShoppingMediator::FairnessPolicy::kFifo ? "FIFO\n"
+                                                                             : "Pro-rata\n");
+    PrintPurchases(" - order1 (30)", order1.get());
+    PrintPurchases(" - order2 (20)", order2.get());
+    PrintPurchases(" - order3 (10)", order3.get());
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const int kRestaurants = 64;
+  const int kOrders = 2000;
+  RunThroughputBenchmark<ShoppingMediator>("Per-request mediator     ", kRestaurants, kOrders);
+  for (int window_us : {0, 50, 200, 1000}) {
+    std::string label = "Batching, window " + std::to_string(window_us) + " us";
+    label.resize(25, ' ');
+    RunThroughputBenchmark<BatchingShoppingMediator>(label, kRestaurants, kOrders,
+                                                     std::chrono::microseconds(window_us));
+  }
+  for (int window_us : {0, 50, 200, 1000}) {
+    std::string label = "Pipelined, window " + std::to_string(window_us) + " us";
+    label.resize(25, ' ');
+    RunPipelinedBenchmark(label, kRestaurants, kOrders, 32, std::chrono::microseconds(window_us));
+  }
+  return 0;
+}
@@ -0,0 +1,378 @@
+/*
+  Memento for large state.
+
+  In part1, BankAccount::Memento copies a single int. Real accounts carry much more state: here an
+  account holds the balance of many sub-accounts (savings pots). Copying all of them on every
+  Save() does not scale.
+
+  CowBankAccount keeps its sub-account balances in a persistent (copy-on-write) radix tree:
+  - Save() copies one shared pointer to the root. O(1).
+  - A write copies only the path from the root to the touched leaf, and only when that path is
+    still shared with a memento. O(log32 n) per write, O(1) amortized if nothing was saved.
+  - Restore() swaps the root back. O(1).
+
+  Each outstanding memento keeps alive only the nodes that differ from the current state, so
+  thousands of mementos cost memory proportional to the changes made since they were taken, not to
+  the size of the account.
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+class Query {
+ public:
+  Query(int pocket, int amount) : pocket_(pocket), amount_(amount) {}
+
+  virtual ~Query() = default;
+
+  int pocket() const {
+    return pocket_;
+  }
+
+  int amount() const {
+    return amount_;
+  }
+
+ private:
+  int pocket_;
+  int amount_;
+};
+
+class DepositQuery : public Query {
+ public:
+  DepositQuery(int pocket, int amount) : Query(pocket, amount) {}
+};
+
+class WithdrawQuery : public Query {
+ public:
+  WithdrawQuery(int pocket, int amount) : Query(pocket, amount) {}
+};
+
+class Transaction {
+ public:
+  void AddQuery(Query* query) {
+    queries_.emplace_back(query);
+  }
+
+  const std::vector<std::unique_ptr<Query>>& queries() const {
+    return queries_;
+  }
+
+ private:
+  std::vector<std::unique_ptr<Query>> queries_;
+};
+
+/*
+  Fixed-size persistent array of long long, stored as a radix tree with 32-way branching.
+  Inner nodes hold only child pointers and leaves hold only values, so a copied path costs no
+  more than it has to.
+*/
+class PersistentArray {
+  static constexpr int kBits = 5;
+  static constexpr int kWidth = 1 << kBits;
+  static constexpr int kMask = kWidth - 1;
+
+  struct Inner {
+    std::array<std::shared_ptr<void>, kWidth> children;  // Inner nodes, or leaves at shift 5
+  };
+
+  struct Leaf {
+    std::array<long long, kWidth> values{};
+  };
+
+ public:
+  explicit PersistentArray(int size) : size_(size), shift_(0) {
+    while ((1LL << (shift_ + kBits)) < size) {
+      shift_ += kBits;
+    }
+    root_ = Build(shift_, size);
+  }
+
+  int size() const {
+    return size_;
+  }
+
+  long long Get(int index) const {
+    const void* node = root_.get();
+    for (int shift = shift_; shift > 0; shift -= kBits) {
+      node = static_cast<const Inner*>(node)->children[(index >> shift) & kMask].get();
+    }
+    return static_cast<const Leaf*>(node)->values[index & kMask];
+  }
+
+  void Set(int index, long long value) {
+    std::shared_ptr<void>* slot = &root_;
+    for (int shift = shift_; shift > 0; shift -= kBits) {
+      // Copy the node only if someone else (a memento) still points to it.
+      if (slot->use_count() > 1) {
+        *slot = std::make_shared<Inner>(*static_cast<const Inner*>(slot->get()));
+      }
+      slot = &static_cast<Inner*>(slot->get())->children[(index >> shift) & kMask];
+    }
+    if (slot->use_count() > 1) {
+      *slot = std::make_shared<Leaf>(*static_cast<const Leaf*>(slot->get()));
+    }
+    static_cast<Leaf*>(slot->get())->values[index & kMask] = value;
+  }
+
+  // Calls visit(node, size in bytes) for every node, top-down. The children of a node are
+  // skipped if visit returns false for it, e.g. because they were already counted.
+  template <typename Visit>
+  void VisitNodes(Visit visit) const {
+    VisitNodes(root_.get(), shift_, visit);
+  }
+
+ private:
+  static std::shared_ptr<void> Build(int shift, int size) {
+    if (shift == 0) {
+      return std::make_shared<Leaf>();
+    }
+    auto node = std::make_shared<Inner>();
+    long long child_span = 1LL << shift;
+    for (int i = 0; i < kWidth && i * child_span < size; ++i) {
+      long long child_size = std::min<long long>(child_span, size - i * child_span);
+      node->children[i] = Build(shift - kBits, static_cast<int>(child_size));
+    }
+    return node;
+  }
+
+  template <typename Visit>
+  static void VisitNodes(const void* node, int shift, Visit& visit) {
+    if (shift == 0) {
+      visit(node, sizeof(Leaf));
+      return;
+    }
+    if (!visit(node, sizeof(Inner))) {
+      return;
+    }
+    for (const auto& child : static_cast<const Inner*>(node)->children) {
+      if (child != nullptr) {
+        VisitNodes(child.get(), shift - kBits, visit);
+      }
+    }
+  }
+
+  int size_;
+  int shift_;
+  std::shared_ptr<void> root_;  // An Inner node, or a Leaf if shift_ is 0
+};
+
+/*
+  Baseline: the memento copies every sub-account balance.
+*/
+class FullCopyBankAccount {
+ public:
+  class Memento {
+   private:
+    friend class FullCopyBankAccount;
+
+    Memento(std::vector<long long> balances) : balances_(std::move(balances)) {}
+
+    std::vector<long long> balances_;
+  };
+
+  explicit FullCopyBankAccount(int num_pockets) : balances_(num_pockets, 0) {}
+
+  bool ProcessTransaction(const Transaction& tx) {
+    for (const auto& query : tx.queries()) {
+      if (auto deposit = dynamic_cast<DepositQuery*>(query.get())) {
+        balances_[deposit->pocket()] += deposit->amount();
+      } else if (auto withdraw = dynamic_cast<WithdrawQuery*>(query.get())) {
+        if (withdraw->amount() > balances_[withdraw->pocket()]) {
+          return false;  // Transaction failed
+        }
+        balances_[withdraw->pocket()] -= withdraw->amount();
+      }
+    }
+    return true;  // Transaction successful
+  }
+
+  Memento Save() const {
+    return Memento(balances_);
+  }
+
+  void Restore(const Memento& memento) {
+    balances_ = memento.balances_;
+  }
+
+  long long balance(int pocket) const {
+    return balances_[pocket];
+  }
+
+  // Bytes that the mementos in `history` hold in addition to the account itself.
+  long long MementoBytes(const std::deque<Memento>& history) const {
+    long long bytes = 0;
+    for (const Memento& memento : history) {
+      bytes += memento.balances_.capacity() * sizeof(long long);
+    }
+    return bytes;
+  }
+
+ private:
+  std::vector<long long> balances_;
+};
+
+class CowBankAccount {
+ public:
+  class Memento {
+   private:
+    friend class CowBankAccount;
+
+    Memento(PersistentArray balances) : balances_(std::move(balances)) {}
+
+    PersistentArray balances_;  // Shares every untouched node with the account
+  };
+
+  explicit CowBankAccount(int num_pockets) : balances_(num_pockets) {}
+
+  bool ProcessTransaction(const Transaction& tx) {
+    for (const auto& query : tx.queries()) {
+      if (auto deposit = dynamic_cast<DepositQuery*>(query.get())) {
+        Deposit(deposit->pocket(), deposit->amount());
+      } else if (auto withdraw = dynamic_cast<WithdrawQuery*>(query.get())) {
+        if (!Withdraw(withdraw->pocket(), withdraw->amount())) {
+          return false;  // Transaction failed
+        }
+      }
+    }
+    return true;  // Transaction successful
+  }
+
+  Memento Save() const {
+    return Memento(balances_);
+  }
+
+  void Restore(const Memento& memento) {
+    balances_ = memento.balances_;
+  }
+
+  long long balance(int pocket) const {
+    return balances_.Get(pocket);
+  }
+
+  // Bytes that the mementos in `history` hold in addition to the account itself: the nodes they
+  // do not share with the account, each counted once.
+  long long MementoBytes(const std::deque<Memento>& history) const {
+    std::unordered_set<const void*> seen;
+    balances_.VisitNodes([&](const void* node, size_t) { return seen.insert(node).second; });
+    long long bytes = 0;
+    for (const Memento& memento : history) {
+      memento.balances_.VisitNodes([&](const void* node, size_t size) {
+        if (!seen.insert(node).second) {
+          return false;  // Shared, and so is everything below it
+        }
+        bytes += size;
+        return true;
+      });
+    }
+    return bytes;
+  }
+
+ private:
+  void Deposit(int pocket, int amount) {
+    balances_.Set(pocket, balances_.Get(pocket) + amount);
+  }
+
+  bool Withdraw(int pocket, int amount) {
+    long long balance = balances_.Get(pocket);
+    if (amount > balance) {
+      return false;
+    }
+    balances_.Set(pocket, balance - amount);
+    return true;
+  }
+
+  PersistentArray balances_;
+};
+
+/*
+  The care-taker saves before every transaction, restores on failure, and keeps the last
+  `kept_mementos` mementos around (e.g. for auditing or multi-step undo).
+*/
+template <typename Account>
+void RunBenchmark(const char* label, int num_pockets, int num_transactions, int kept_mementos) {
+  Account account(num_pockets);
+  std::deque<typename Account::Memento> history;
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> pocket_dist(0, num_pockets - 1);
+  std::uniform_int_distribution<int> amount_dist(1, 100);
+
+  // Build the transactions up front so that only Save/Process/Restore is measured.
+  std::vector<Transaction> transactions(num_transactions);
+  for (auto& tx : transactions) {
+    int pocket = pocket_dist(rng);
+    tx.AddQuery(new DepositQuery(pocket, amount_dist(rng)));
+    tx.AddQuery(new WithdrawQuery(pocket, amount_dist(rng)));  // Fails about half the time
+  }
+
+  int failed = 0;
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (const auto& tx : transactions) {
+    history.push_back(account.Save());
+    if (!account.ProcessTransaction(tx)) {
+      account.Restore(history.back());
+      failed++;
+    }
+    if (static_cast<int>(history.size()) > kept_mementos) {
+      history.pop_front();
+    }
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  std::cout << label << " | transactions/sec = "
+            << static_cast<long long>(num_transactions / duration.count())
+            << ", failed = " << failed
+            << ", held by mementos = " << account.MementoBytes(history) / 1024 << " KiB\n";
+}
+
+int main() {
+  {
+    CowBankAccount account(1000);
+    Transaction tx;
+    tx.AddQuery(new DepositQuery(7, 100));
+    tx.AddQuery(new WithdrawQuery(7, 150));  // This will fail
+
+    std::cout << "Initial balance of pocket 7: $" << account.balance(7) << "\n";
+    auto memento = account.Save();
+    if (account.ProcessTransaction(tx)) {
+      std::cout << "Transaction successful\n";
+    } else {
+      std::cout << "Transaction failed\n";
+    }
+    std::cout << "Final balance of pocket 7 (Wrong): $" << account.balance(7) << "\n";
+
+    std::cout << "Restoring the internal state...\n";
+    account.Restore(memento);
+    std::cout << "Final balance of pocket 7 (Rolled Back): $" << account.balance(7) << "\n";
+  }
+  std::cout << "----------------------------------\n";
+  {
+    const int kPockets = 1 << 20;
+    const int kTransactions = 2000;
+    const int kKeptMementos = 10;
+    RunBenchmark<FullCopyBankAccount>("Full-copy memento, 10 kept  ", kPockets, kTransactions,
+                                      kKeptMementos);
+    RunBenchmark<CowBankAccount>("COW memento, 10 kept        ", kPockets, kTransactions,
+                                 kKeptMementos);
+
+    // Full-copy would need 8 MiB per memento here, so only the COW account is run this large.
+    const int kManyKeptMementos = 1000;
+    RunBenchmark<CowBankAccount>("COW memento, 1000 kept      ", kPockets, kTransactions * 100,
+                                 kManyKeptMementos);
+    std::cout << "(full-copy keeping " << kManyKeptMementos << " mementos would need "
+              << static_cast<long long>(kPockets) * sizeof(long long) * kManyKeptMementos /
+                     (1 << 20)
+              << " MiB)\n";
+  }
+  return 0;
+}
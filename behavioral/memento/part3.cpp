@@ -0,0 +1,320 @@
+/*
+  Memento with a devirtualized transaction hot path.
+
+  In part1, every Query is allocated with `new`, and BankAccount::ProcessTransaction identifies it
+  with a dynamic_cast to DepositQuery and then to WithdrawQuery.
+
+  Here a Transaction is a contiguous array of tagged operations (kind, amount):
+  - No RTTI: ProcessTransaction switches on the kind.
+  - No per-query allocation: Clear() keeps the capacity, so a reused Transaction never allocates.
+  - Net-delta fast path: while queries are added, the transaction tracks its net effect on the
+    balance and the lowest point the running balance reaches. If the current balance covers that
+    lowest point, the whole transaction succeeds and is applied with a single addition.
+    Otherwise it fails without touching the balance.
+
+  The care-taker still relies on the memento for rollback; with the fast path a failed transaction
+  leaves the account untouched, so restoring is a no-op but still correct.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace legacy {
+
+// Same Query/Transaction/ProcessTransaction as part1, kept for the benchmark.
+class Query {
+ public:
+  explicit Query(int amount) : amount_(amount) {}
+
+  virtual ~Query() = default;
+
+  int amount() const {
+    return amount_;
+  }
+
+ private:
+  int amount_;
+};
+
+class DepositQuery : public Query {
+ public:
+  explicit DepositQuery(int amount) : Query(amount) {}
+};
+
+class WithdrawQuery : public Query {
+ public:
+  explicit WithdrawQuery(int amount) : Query(amount) {}
+};
+
+class Transaction {
+ public:
+  void AddQuery(Query* query) {
+    queries_.emplace_back(query);
+  }
+
+  const std::vector<std::unique_ptr<Query>>& queries() const {
+    return queries_;
+  }
+
+ private:
+  std::vector<std::unique_ptr<Query>> queries_;
+};
+
+class BankAccount {
+ public:
+  BankAccount(int balance = 0) : balance_(balance) {}
+
+  bool ProcessTransaction(const Transaction& tx) {
+    for (const auto& query : tx.queries()) {
+      if (auto deposit = dynamic_cast<DepositQuery*>(query.get())) {
+        balance_ += deposit->amount();
+      } else if (auto withdraw = dynamic_cast<WithdrawQuery*>(query.get())) {
+        if (withdraw->amount() > balance_) {
+          return false;  // Transaction failed
+        }
+        balance_ -= withdraw->amount();
+      }
+    }
+    return true;  // Transaction successful
+  }
+
+  int balance() const {
+    return balance_;
+  }
+
+ private:
+  int balance_;
+};
+
+}  // namespace legacy
+
+class Transaction {
+ public:
+  enum class Kind : int { kDeposit, kWithdraw };
+
+  struct Op {
+    Kind kind;
+    int amount;
+  };
+
+  Transaction() : net_delta_(0), lowest_delta_(0) {}
+
+  void AddDeposit(int amount) {
+    ops_.push_back({Kind::kDeposit, amount});
+    net_delta_ += amount;
+  }
+
+  void AddWithdraw(int amount) {
+    ops_.push_back({Kind::kWithdraw, amount});
+    net_delta_ -= amount;
+    lowest_delta_ = std::min(lowest_delta_, net_delta_);
+  }
+
+  // Keeps the capacity so that a reused transaction does not allocate.
+  void Clear() {
+    ops_.clear();
+    net_delta_ = 0;
+    lowest_delta_ = 0;
+  }
+
+  const std::vector<Op>& ops() const {
+    return ops_;
+  }
+
+  // Sum of all deposits minus all withdrawals.
+  long long net_delta() const {
+    return net_delta_;
+  }
+
+  // Lowest running sum reached after any withdrawal (never above 0).
+  long long lowest_delta() const {
+    return lowest_delta_;
+  }
+
+ private:
+  std::vector<Op> ops_;
+  long long net_delta_;
+  long long lowest_delta_;
+};
+
+class BankAccount {
+ public:
+  class Memento {
+   private:
+    friend class BankAccount;
+
+    Memento(int balance) : balance_(balance) {}
+
+    int balance() const {
+      return balance_;
+    }
+
+    int balance_;
+  };
+
+  BankAccount(int balance = 0) : balance_(balance) {}
+
+  // Applies the queries one by one, exactly like part1 but with a switch instead of RTTI.
+  bool ProcessTransaction(const Transaction& tx) {
+    for (const auto& op : tx.ops()) {
+      switch (op.kind) {
+        case Transaction::Kind::kDeposit:
+          Deposit(op.amount);
+          break;
+        case Transaction::Kind::kWithdraw:
+          if (!Withdraw(op.amount)) {
+            return false;  // Transaction failed
+          }
+          break;
+      }
+    }
+    return true;  // Transaction successful
+  }
+
+  // Same outcome as ProcessTransaction, in O(1), and a failed transaction changes nothing.
+  bool ProcessTransactionFast(const Transaction& tx) {
+    if (balance_ + tx.lowest_delta() < 0) {
+      return false;  // Some withdrawal would exceed the balance at that point
+    }
+    balance_ += static_cast<int>(tx.net_delta());
+    return true;
+  }
+
+  Memento Save() const {
+    return Memento(balance_);
+  }
+
+  void Restore(const Memento& memento) {
+    balance_ = memento.balance();
+  }
+
+  int balance() const {
+    return balance_;
+  }
+
+ private:
+  void Deposit(int amount) {
+    balance_ += amount;
+  }
+
+  bool Withdraw(int amount) {
+    if (amount > balance_) {
+      return false;
+    }
+    balance_ -= amount;
+    return true;
+  }
+
+ private:
+  int balance_;
+};
+
+/*
+  Every benchmark builds each transaction and then processes it, so that the cost of allocating
+  queries is included. The same random sequence is used for all three.
+*/
+const int kQueriesPerTransaction = 8;
+
+template <typename Body>
+void RunBenchmark(const char* label, int num_transactions, Body body) {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> amount_dist(1, 100);
+  std::vector<int> amounts(num_transactions * kQueriesPerTransaction);
+  for (auto& amount : amounts) {
+    amount = amount_dist(rng);
+  }
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  auto [succeeded, balance] = body(amounts);
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  std::cout << label << " | transactions/sec = "
+            << static_cast<long long>(num_transactions / duration.count())
+            << ", succeeded = " << succeeded << ", final balance = " << balance << "\n";
+}
+
+int main() {
+  {
+    BankAccount account(49);
+    Transaction tx;
+    tx.AddDeposit(100);
+    tx.AddWithdraw(150);  // This will fail
+
+    std::cout << "Initial balance: $" << account.balance() << "\n";
+    auto memento = account.Save();
+    if (account.ProcessTransaction(tx)) {
+      std::cout << "Transaction successful\n";
+    } else {
+      std::cout << "Transaction failed\n";
+    }
+    std::cout << "Final balance (Wrong): $" << account.balance() << "\n";
+
+    std::cout << "Restoring the internal state...\n";
+    account.Restore(memento);
+    std::cout << "Final balance (Rolled Back): $" << account.balance() << "\n";
+
+    if (!account.ProcessTransactionFast(tx)) {
+      std::cout << "Fast path: transaction failed, balance untouched: $" << account.balance()
+                << "\n";
+    }
+  }
+  std::cout << "----------------------------------\n";
+
+  const int kTransactions = 2000000;
+
+  // Even queries deposit and odd queries withdraw; a transaction fails when the balance runs dry.
+  RunBenchmark("virtual + dynamic_cast", kTransactions, [](const std::vector<int>& amounts) {
+    legacy::BankAccount account;
+    int succeeded = 0;
+    for (size_t i = 0; i < amounts.size(); i += kQueriesPerTransaction) {
+      legacy::Transaction tx;
+      for (int q = 0; q < kQueriesPerTransaction; ++q) {
+        if (q % 2 == 0) {
+          tx.AddQuery(new legacy::DepositQuery(amounts[i + q]));
+        } else {
+          tx.AddQuery(new legacy::WithdrawQuery(amounts[i + q]));
+        }
+      }
+      int saved = account.balance();
+      if (account.ProcessTransaction(tx)) {
+        succeeded++;
+      } else {
+        account = legacy::BankAccount(saved);  // Roll back
+      }
+    }
+    return std::make_pair(succeeded, account.balance());
+  });
+
+  auto run_tagged = [](bool fast) {
+    return [fast](const std::vector<int>& amounts) {
+      BankAccount account;
+      Transaction tx;
+      int succeeded = 0;
+      for (size_t i = 0; i < amounts.size(); i += kQueriesPerTransaction) {
+        tx.Clear();
+        for (int q = 0; q < kQueriesPerTransaction; ++q) {
+          if (q % 2 == 0) {
+            tx.AddDeposit(amounts[i + q]);
+          } else {
+            tx.AddWithdraw(amounts[i + q]);
+          }
+        }
+        auto memento = account.Save();
+        if (fast ? account.ProcessTransactionFast(tx) : account.ProcessTransaction(tx)) {
+          succeeded++;
+        } else {
+          account.Restore(memento);
+        }
+      }
+      return std::make_pair(succeeded, account.balance());
+    };
+  };
+  RunBenchmark("tagged ops + switch   ", kTransactions, run_tagged(false));
+  RunBenchmark("tagged ops + net delta", kTransactions, run_tagged(true));
+  return 0;
+}
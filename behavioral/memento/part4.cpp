@@ -0,0 +1,494 @@
+/*
+  Memento with durability.
+
+  In part1, rollback depends on the care-taker holding an in-memory Memento. If the process dies
+  in the middle of ProcessTransaction, the whole state is gone.
+
+  DurableBankAccount adds an optional durable mode on top of BankAccount:
+  - Write-ahead log: each successful transaction is appended to a log file as one record
+    (length, checksum, sequence number, ops).
+  - Group commit: records are buffered and written with one write + fsync per
+    `group_commit_size` transactions. A transaction is durable once its group is synced
+    (see durable_sequence()).
+  - Snapshots: every `snapshot_interval` transactions, the account state is written to a snapshot
+    file (write to a temporary file, fsync, rename, fsync the directory) and the log is started
+    over. The snapshot is framed and checksummed like a log record.
+  - Recovery: on startup, the snapshot is loaded and the log tail is replayed. A torn or corrupted
+    record (short read or checksum mismatch) marks the end of the log.
+
+  Failed transactions are rolled back with the memento, exactly like in part1, and never reach the
+  log.
+
+  This example uses POSIX file APIs (open/write/fsync/rename).
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class Transaction {
+ public:
+  enum class Kind : int32_t { kDeposit, kWithdraw };
+
+  struct Op {
+    Kind kind;
+    int32_t amount;
+  };
+
+  void AddDeposit(int amount) {
+    ops_.push_back({Kind::kDeposit, amount});
+  }
+
+  void AddWithdraw(int amount) {
+    ops_.push_back({Kind::kWithdraw, amount});
+  }
+
+  void Clear() {
+    ops_.clear();
+  }
+
+  const std::vector<Op>& ops() const {
+    return ops_;
+  }
+
+ private:
+  std::vector<Op> ops_;
+};
+
+class BankAccount {
+ public:
+  class Memento {
+   private:
+    friend class BankAccount;
+
+    Memento(int balance) : balance_(balance) {}
+
+    int balance() const {
+      return balance_;
+    }
+
+    int balance_;
+  };
+
+  BankAccount(int balance = 0) : balance_(balance) {}
+
+  bool ProcessTransaction(const Transaction& tx) {
+    for (const auto& op : tx.ops()) {
+      switch (op.kind) {
+        case Transaction::Kind::kDeposit:
+          Deposit(op.amount);
+          break;
+        case Transaction::Kind::kWithdraw:
+          if (!Withdraw(op.amount)) {
+            return false;  // Transaction failed
+          }
+          break;
+      }
+    }
+    return true;  // Transaction successful
+  }
+
+  Memento Save() const {
+    return Memento(balance_);
+  }
+
+  void Restore(const Memento& memento) {
+    balance_ = memento.balance();
+  }
+
+  int balance() const {
+    return balance_;
+  }
+
+ private:
+  void Deposit(int amount) {
+    balance_ += amount;
+  }
+
+  bool Withdraw(int amount) {
+    if (amount > balance_) {
+      return false;
+    }
+    balance_ -= amount;
+    return true;
+  }
+
+ private:
+  int balance_;
+};
+
+namespace {
+uint32_t Checksum(const char* data, size_t size) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+[[noreturn]] void ThrowErrno(const std::string& what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+void WriteAll(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = ::write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ThrowErrno("Failed to write");
+    }
+    data += written;
+    size -= written;
+  }
+}
+
+template <typename T>
+void Append(std::vector<char>& buffer, const T& value) {
+  const char* bytes = reinterpret_cast<const char*>(&value);
+  buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+void Fsync(int fd) {
+  if (::fsync(fd) != 0) {
+    ThrowErrno("Failed to fsync");
+  }
+}
+
+// Makes a rename inside directory durable.
+void FsyncDirectory(const std::string& directory) {
+  int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    ThrowErrno("Failed to open " + directory);
+  }
+  if (::fsync(fd) != 0) {
+    int error = errno;
+    ::close(fd);
+    errno = error;
+    ThrowErrno("Failed to fsync " + directory);
+  }
+  ::close(fd);
+}
+}  // namespace
+
+class DurableBankAccount {
+ public:
+  DurableBankAccount(std::string directory, int group_commit_size = 64,
+                     int snapshot_interval = 100000) :
+      directory_(directory),
+      group_commit_size_(group_commit_size),
+      snapshot_interval_(snapshot_interval),
+      log_fd_(-1),
+      sequence_(0),
+      durable_sequence_(0),
+      pending_transactions_(0),
+      transactions_since_snapshot_(0) {
+    std::filesystem::create_directories(directory_);
+    Recover();
+    log_fd_ = ::open(LogPath().c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (log_fd_ < 0) {
+      throw std::runtime_error("Failed to open the log");
+    }
+  }
+
+  // Owns the log file descriptor.
+  DurableBankAccount(const DurableBankAccount&) = delete;
+  DurableBankAccount& operator=(const DurableBankAccount&) = delete;
+
+  ~DurableBankAccount() {
+    if (log_fd_ >= 0) {
+      try {
+        Flush();
+      } catch (const std::runtime_error& e) {
+        std::cerr << "Failed to flush the log: " << e.what() << std::endl;
+      }
+      ::close(log_fd_);
+    }
+  }
+
+  bool ProcessTransaction(const Transaction& tx) {
+    auto memento = account_.Save();
+    if (!account_.ProcessTransaction(tx)) {
+      account_.Restore(memento);
+      return false;
+    }
+
+    sequence_++;
+    AppendRecord(tx);
+    if (++pending_transactions_ >= group_commit_size_) {
+      Flush();
+    }
+    if (++transactions_since_snapshot_ >= snapshot_interval_) {
+      TakeSnapshot();
+    }
+    return true;
+  }
+
+  /*
+    Writes and fsyncs every buffered record. Afterwards every processed transaction is durable.
+    Throws std::runtime_error if the write or fsync fails; durable_sequence() is then unchanged.
+  */
+  void Flush() {
+    if (buffer_.empty()) {
+      return;
+    }
+    WriteAll(log_fd_, buffer_.data(), buffer_.size());
+    Fsync(log_fd_);
+    buffer_.clear();
+    pending_transactions_ = 0;
+    durable_sequence_ = sequence_;
+  }
+
+  // For demonstration: drop the buffered records and the file handle as if the process died.
+  void SimulateCrash() {
+    buffer_.clear();
+    ::close(log_fd_);
+    log_fd_ = -1;
+  }
+
+  int balance() const {
+    return account_.balance();
+  }
+
+  // Sequence number of the last transaction that survives a crash.
+  uint64_t durable_sequence() const {
+    return durable_sequence_;
+  }
+
+  uint64_t sequence() const {
+    return sequence_;
+  }
+
+ private:
+  std::string LogPath() const {
+    return directory_ + "/wal.log";
+  }
+
+  std::string SnapshotPath() const {
+    return directory_ + "/snapshot.bin";
+  }
+
+  /*
+    Log records and the snapshot share one framing:
+    [uint32 payload size][uint32 checksum][payload]
+    Log payload: uint64 sequence, then (int32 kind, int32 amount) per op.
+    Snapshot payload: uint64 sequence, int32 balance.
+  */
+  static constexpr size_t kHeaderSize = 2 * sizeof(uint32_t);
+  static constexpr size_t kSnapshotPayloadSize = sizeof(uint64_t) + sizeof(int32_t);
+
+  // Appends a header to be filled in by SealRecord. Returns its offset.
+  static size_t BeginRecord(std::vector<char>& buffer) {
+    size_t header_offset = buffer.size();
+    buffer.resize(header_offset + kHeaderSize);
+    return header_offset;
+  }
+
+  // Fills in the header at `header_offset` for the payload that follows it.
+  static void SealRecord(std::vector<char>& buffer, size_t header_offset) {
+    size_t payload_offset = header_offset + kHeaderSize;
+    uint32_t payload_size = static_cast<uint32_t>(buffer.size() - payload_offset);
+    uint32_t checksum = Checksum(buffer.data() + payload_offset, payload_size);
+    std::memcpy(buffer.data() + header_offset, &payload_size, sizeof(payload_size));
+    std::memcpy(buffer.data() + header_offset + sizeof(payload_size), &checksum,
+                sizeof(checksum));
+  }
+
+  void AppendRecord(const Transaction& tx) {
+    size_t header_offset = BeginRecord(buffer_);
+    Append(buffer_, sequence_);
+    for (const auto& op : tx.ops()) {
+      Append(buffer_, static_cast<int32_t>(op.kind));
+      Append(buffer_, op.amount);
+    }
+    SealRecord(buffer_, header_offset);
+  }
+
+  void TakeSnapshot() {
+    Flush();
+
+    std::vector<char> snapshot;
+    BeginRecord(snapshot);
+    Append(snapshot, sequence_);
+    Append(snapshot, static_cast<int32_t>(account_.balance()));
+    SealRecord(snapshot, 0);
+
+    std::string temporary_path = SnapshotPath() + ".tmp";
+    int fd = ::open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      ThrowErrno("Failed to write the snapshot");
+    }
+    try {
+      WriteAll(fd, snapshot.data(), snapshot.size());
+      Fsync(fd);
+    } catch (const std::runtime_error&) {
+      ::close(fd);
+      throw;
+    }
+    ::close(fd);
+    std::filesystem::rename(temporary_path, SnapshotPath());
+    // The rename must be durable before the log is truncated, or a crash could keep the truncate
+    // and lose the snapshot that replaces it.
+    FsyncDirectory(directory_);
+
+    // Every logged transaction is now covered by the snapshot.
+    if (::ftruncate(log_fd_, 0) != 0) {
+      ThrowErrno("Failed to truncate the log");
+    }
+    Fsync(log_fd_);
+    transactions_since_snapshot_ = 0;
+  }
+
+  /*
+    Throws std::runtime_error if the snapshot exists but is torn or corrupted. It is only
+    replaced by rename, so that means the disk lost data, and the log no longer covers it.
+  */
+  void Recover() {
+    sequence_ = 0;
+    if (std::filesystem::exists(SnapshotPath())) {
+      std::ifstream snapshot_file(SnapshotPath(), std::ios::binary);
+      char snapshot[kHeaderSize + kSnapshotPayloadSize];
+      uint32_t payload_size, checksum;
+      if (!snapshot_file.read(snapshot, sizeof(snapshot))) {
+        throw std::runtime_error("The snapshot is truncated");
+      }
+      std::memcpy(&payload_size, snapshot, sizeof(payload_size));
+      std::memcpy(&checksum, snapshot + sizeof(payload_size), sizeof(checksum));
+      if (payload_size != kSnapshotPayloadSize ||
+          Checksum(snapshot + kHeaderSize, kSnapshotPayloadSize) != checksum) {
+        throw std::runtime_error("The snapshot is corrupted");
+      }
+      int32_t balance;
+      std::memcpy(&sequence_, snapshot + kHeaderSize, sizeof(sequence_));
+      std::memcpy(&balance, snapshot + kHeaderSize + sizeof(sequence_), sizeof(balance));
+      account_ = BankAccount(balance);
+    }
+
+    std::ifstream log_file(LogPath(), std::ios::binary);
+    uint64_t file_size =
+        std::filesystem::exists(LogPath()) ? std::filesystem::file_size(LogPath()) : 0;
+    std::vector<char> payload;
+    uint64_t valid_bytes = 0;
+    while (true) {
+      uint32_t payload_size, checksum;
+      if (!log_file.read(reinterpret_cast<char*>(&payload_size), sizeof(payload_size)) ||
+          !log_file.read(reinterpret_cast<char*>(&checksum), sizeof(checksum))) {
+        break;
+      }
+      // A torn header can hold any size, so check it before allocating.
+      uint64_t bytes_left = file_size - valid_bytes - sizeof(payload_size) - sizeof(checksum);
+      if (payload_size > bytes_left) {
+        break;  // Torn or corrupted tail
+      }
+      payload.resize(payload_size);
+      if (payload_size < sizeof(uint64_t) || !log_file.read(payload.data(), payload_size) ||
+          Checksum(payload.data(), payload_size) != checksum) {
+        break;  // Torn or corrupted tail
+      }
+
+      uint64_t sequence;
+      std::memcpy(&sequence, payload.data(), sizeof(sequence));
+      if (sequence > sequence_) {  // Older records are already in the snapshot
+        Transaction tx;
+        constexpr size_t kOpSize = 2 * sizeof(int32_t);
+        for (size_t offset = sizeof(sequence); offset + kOpSize <= payload_size;
+             offset += kOpSize) {
+          int32_t kind, amount;
+          std::memcpy(&kind, payload.data() + offset, sizeof(kind));
+          std::memcpy(&amount, payload.data() + offset + sizeof(kind), sizeof(amount));
+          kind == static_cast<int32_t>(Transaction::Kind::kDeposit) ? tx.AddDeposit(amount)
+                                                                    : tx.AddWithdraw(amount);
+        }
+        account_.ProcessTransaction(tx);  // Only successful transactions were logged
+        sequence_ = sequence;
+        transactions_since_snapshot_++;
+      }
+      valid_bytes += sizeof(payload_size) + sizeof(checksum) + payload_size;
+    }
+    log_file.close();
+
+    // Drop the torn tail so that new records are appended right after the last valid one.
+    if (std::filesystem::exists(LogPath())) {
+      std::filesystem::resize_file(LogPath(), valid_bytes);
+    }
+    durable_sequence_ = sequence_;
+  }
+
+  std::string directory_;
+  const int group_commit_size_;
+  const int snapshot_interval_;
+
+  BankAccount account_;
+  int log_fd_;
+  std::vector<char> buffer_;
+  uint64_t sequence_;
+  uint64_t durable_sequence_;
+  int pending_transactions_;
+  int transactions_since_snapshot_;
+};
+
+int main() {
+  const std::string directory =
+      (std::filesystem::temp_directory_path() / "design_patterns_memento_wal").string();
+
+  {
+    std::filesystem::remove_all(directory);
+
+    DurableBankAccount account(directory, 4, 10);
+    Transaction tx;
+    for (int i = 0; i < 23; ++i) {
+      tx.Clear();
+      tx.AddDeposit(10);
+      tx.AddWithdraw(3);
+      account.ProcessTransaction(tx);
+    }
+    tx.Clear();
+    tx.AddWithdraw(1000000);  // This will fail and is rolled back by the memento
+    account.ProcessTransaction(tx);
+
+    std::cout << "Balance before crash: $" << account.balance() << " (" << account.sequence()
+              << " transactions, " << account.durable_sequence() << " durable)\n";
+    account.SimulateCrash();
+  }
+  {
+    DurableBankAccount recovered(directory, 4, 10);
+    std::cout << "Balance after recovery: $" << recovered.balance() << " ("
+              << recovered.sequence() << " transactions)\n";
+  }
+  std::cout << "----------------------------------\n";
+
+  const int kTransactions = 20000;
+  for (int group_commit_size : {1, 8, 64, 512}) {
+    std::filesystem::remove_all(directory);
+    DurableBankAccount account(directory, group_commit_size);
+
+    Transaction tx;
+    tx.AddDeposit(10);
+    tx.AddWithdraw(3);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < kTransactions; ++i) {
+      account.ProcessTransaction(tx);
+    }
+    account.Flush();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+
+    std::cout << "group commit size = " << group_commit_size << " | committed transactions/sec = "
+              << static_cast<long long>(kTransactions / duration.count()) << "\n";
+  }
+  std::filesystem::remove_all(directory);
+  return 0;
+}
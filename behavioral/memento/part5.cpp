@@ -0,0 +1,430 @@
+/*
+  Memento in a concurrent multi-account ledger.
+
+  BankAccount in part1 is single-threaded and holds one account per object. Ledger manages many
+  accounts and moves money between them from many threads at once, without a global lock:
+
+  - Accounts are split into shards, contiguous ranges of account ids. Each shard owns its accounts
+    in its own allocation and counts its own retries on its own cache line, so threads that work
+    mostly within one home shard touch little memory in common. Each account carries a version
+    number; an odd version means the account is being written.
+  - Transfers within a shard use optimistic concurrency: read both versions and the source balance
+    without locking, then lock both accounts by bumping their versions with compare-and-swap
+    from the values that were read. If either account changed in between, the CAS fails and the
+    transfer retries.
+  - Transfers across shards are pessimistic: they wait for and lock both accounts, save a memento
+    of each, then withdraw and deposit. If either half fails, both accounts are restored from
+    their mementos before the locks are released.
+
+  In both paths a failed transfer is rolled back through BankAccount::Restore, never through a
+  global lock. Accounts are always locked in ascending id order, so two transfers cannot deadlock.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+class Transaction {
+ public:
+  enum class Kind : int { kDeposit, kWithdraw };
+
+  struct Op {
+    Kind kind;
+    int amount;
+  };
+
+  void AddDeposit(int amount) {
+    ops_.push_back({Kind::kDeposit, amount});
+  }
+
+  void AddWithdraw(int amount) {
+    ops_.push_back({Kind::kWithdraw, amount});
+  }
+
+  void Clear() {
+    ops_.clear();
+  }
+
+  const std::vector<Op>& ops() const {
+    return ops_;
+  }
+
+ private:
+  std::vector<Op> ops_;
+};
+
+/*
+  Same interface as part1. The balance is atomic so that optimistic readers can look at it while
+  a writer (holding the version lock) changes it.
+*/
+class BankAccount {
+ public:
+  class Memento {
+   private:
+    friend class BankAccount;
+
+    Memento(int balance) : balance_(balance) {}
+
+    int balance() const {
+      return balance_;
+    }
+
+    int balance_;
+  };
+
+  BankAccount(int balance = 0) : balance_(balance) {}
+
+  bool ProcessTransaction(const Transaction& tx) {
+    for (const auto& op : tx.ops()) {
+      switch (op.kind) {
+        case Transaction::Kind::kDeposit:
+          Deposit(op.amount);
+          break;
+        case Transaction::Kind::kWithdraw:
+          if (!Withdraw(op.amount)) {
+            return false;  // Transaction failed
+          }
+          break;
+      }
+    }
+    return true;  // Transaction successful
+  }
+
+  Memento Save() const {
+    return Memento(balance());
+  }
+
+  void Restore(const Memento& memento) {
+    balance_.store(memento.balance(), std::memory_order_relaxed);
+  }
+
+  int balance() const {
+    return balance_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void Deposit(int amount) {
+    balance_.store(balance() + amount, std::memory_order_relaxed);
+  }
+
+  bool Withdraw(int amount) {
+    if (amount > balance()) {
+      return false;
+    }
+    balance_.store(balance() - amount, std::memory_order_relaxed);
+    return true;
+  }
+
+ private:
+  std::atomic<int> balance_;
+};
+
+class Ledger {
+ public:
+  /*
+    Splits the accounts into at most `num_shards` shards of shard_size() accounts; the last one
+    may be smaller, and rounding may leave fewer shards than asked for (see num_shards()).
+    Throws std::invalid_argument unless there is at least one account and one shard.
+  */
+  Ledger(int num_accounts, int num_shards, int initial_balance) :
+      num_accounts_(num_accounts), shard_size_(ShardSize(num_accounts, num_shards)) {
+    Transaction initial_deposit;
+    initial_deposit.AddDeposit(initial_balance);
+    for (int begin = 0; begin < num_accounts; begin += shard_size_) {
+      shards_.push_back(std::make_unique<Shard>(std::min(shard_size_, num_accounts - begin)));
+      for (auto& account : shards_.back()->accounts) {
+        account.account.ProcessTransaction(initial_deposit);
+      }
+    }
+  }
+
+  int shard_of(int account_id) const {
+    return account_id / shard_size_;
+  }
+
+  // Shards actually created.
+  int num_shards() const {
+    return static_cast<int>(shards_.size());
+  }
+
+  int shard_size() const {
+    return shard_size_;
+  }
+
+  int num_accounts() const {
+    return num_accounts_;
+  }
+
+  /*
+    Moves `amount` from one account to another. Returns false (and changes nothing) if the source
+    account does not have enough money. A transfer from an account to itself changes nothing
+    either, but still fails if the account holds less than `amount`, like any other transfer.
+  */
+  bool Transfer(int from, int to, int amount) {
+    if (from == to) {
+      return amount <= balance(from);
+    }
+    if (shard_of(from) == shard_of(to)) {
+      return TransferOptimistic(from, to, amount);
+    }
+    return TransferLocked(from, to, amount);
+  }
+
+  int balance(int account_id) const {
+    return shards_[shard_of(account_id)]->accounts[account_id % shard_size_].account.balance();
+  }
+
+  long long TotalBalance() const {
+    long long total = 0;
+    for (const auto& shard : shards_) {
+      for (const auto& account : shard->accounts) {
+        total += account.account.balance();
+      }
+    }
+    return total;
+  }
+
+  long long retries() const {
+    long long total = 0;
+    for (const auto& shard : shards_) {
+      total += shard->retries.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+ private:
+  struct VersionedAccount {
+    std::atomic<uint64_t> version{0};  // Odd while a writer holds the account
+    BankAccount account;
+  };
+
+  struct alignas(64) Shard {
+    explicit Shard(int size) : accounts(size) {}
+
+    std::vector<VersionedAccount> accounts;
+    std::atomic<long long> retries{0};  // Optimistic transfers from this shard that retried
+  };
+
+  VersionedAccount& account(int account_id) {
+    return shards_[shard_of(account_id)]->accounts[account_id % shard_size_];
+  }
+
+  // Per-thread scratch so that transfers do not allocate.
+  struct Scratch {
+    Transaction& Withdraw(int amount) {
+      withdraw.Clear();
+      withdraw.AddWithdraw(amount);
+      return withdraw;
+    }
+
+    Transaction& Deposit(int amount) {
+      deposit.Clear();
+      deposit.AddDeposit(amount);
+      return deposit;
+    }
+
+    Transaction withdraw;
+    Transaction deposit;
+  };
+
+  static Scratch& scratch() {
+    thread_local Scratch scratch;
+    return scratch;
+  }
+
+  bool TryLock(VersionedAccount& account, uint64_t expected_version) {
+    return account.version.compare_exchange_strong(expected_version, expected_version + 1,
+                                                   std::memory_order_acquire);
+  }
+
+  void Lock(VersionedAccount& account) {
+    while (true) {
+      uint64_t version = account.version.load(std::memory_order_relaxed);
+      if (version % 2 == 0 && TryLock(account, version)) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  void Unlock(VersionedAccount& account) {
+    account.version.fetch_add(1, std::memory_order_release);
+  }
+
+  bool TransferOptimistic(int from, int to, int amount) {
+    VersionedAccount& source = account(from);
+    VersionedAccount& target = account(to);
+    std::atomic<long long>& retries = shards_[shard_of(from)]->retries;
+    VersionedAccount& first = from < to ? source : target;
+    VersionedAccount& second = from < to ? target : source;
+
+    while (true) {
+      // Read phase: no locks.
+      uint64_t source_version = source.version.load(std::memory_order_acquire);
+      uint64_t target_version = target.version.load(std::memory_order_acquire);
+      if (source_version % 2 == 1 || target_version % 2 == 1) {
+        retries.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+        continue;
+      }
+      if (source.account.balance() < amount) {
+        // Insufficient funds is a valid answer only if nobody wrote in the meantime.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (source.version.load(std::memory_order_acquire) == source_version) {
+          return false;
+        }
+        retries.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      uint64_t first_version = from < to ? source_version : target_version;
+      uint64_t second_version = from < to ? target_version : source_version;
+
+      // Validate and lock: the CAS succeeds only if the version is still the one we read.
+      if (!TryLock(first, first_version)) {
+        retries.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+      if (!TryLock(second, second_version)) {
+        first.version.store(first_version, std::memory_order_release);  // Nothing was written
+        retries.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+
+      // Write phase.
+      auto source_memento = source.account.Save();
+      bool success = source.account.ProcessTransaction(scratch().Withdraw(amount)) &&
+                     target.account.ProcessTransaction(scratch().Deposit(amount));
+      if (!success) {
+        source.account.Restore(source_memento);
+      }
+      Unlock(second);
+      Unlock(first);
+      return success;
+    }
+  }
+
+  bool TransferLocked(int from, int to, int amount) {
+    VersionedAccount& source = account(from);
+    VersionedAccount& target = account(to);
+
+    // Lock in ascending id order, then save both accounts before touching either.
+    Lock(from < to ? source : target);
+    Lock(from < to ? target : source);
+    auto source_memento = source.account.Save();
+    auto target_memento = target.account.Save();
+
+    bool success = source.account.ProcessTransaction(scratch().Withdraw(amount)) &&
+                   target.account.ProcessTransaction(scratch().Deposit(amount));
+    if (!success) {
+      source.account.Restore(source_memento);
+      target.account.Restore(target_memento);
+    }
+    Unlock(from < to ? target : source);
+    Unlock(from < to ? source : target);
+    return success;
+  }
+
+  static int ShardSize(int num_accounts, int num_shards) {
+    if (num_accounts <= 0 || num_shards <= 0) {
+      throw std::invalid_argument("A ledger needs at least one account and one shard");
+    }
+    return (num_accounts + num_shards - 1) / num_shards;
+  }
+
+  const int num_accounts_;
+  const int shard_size_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+};
+
+/*
+  Each thread works mostly on its home shard; `cross_shard_percent` of the transfers go to an
+  account in another shard. There is one shard per thread, so cross-shard transfers need at least
+  two threads.
+*/
+void RunBenchmark(int num_threads, int cross_shard_percent, int transfers_per_thread) {
+  const int kAccounts = 1 << 20;
+  const int kInitialBalance = 1000;
+  int num_shards = std::max(1, num_threads);
+  Ledger ledger(kAccounts, num_shards, kInitialBalance);
+
+  std::atomic<long long> succeeded(0);
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      std::mt19937 rng(t);
+      std::uniform_int_distribution<int> in_shard(0, ledger.shard_size() - 1);
+      std::uniform_int_distribution<int> other_shard(1, std::max(1, ledger.num_shards() - 1));
+      std::uniform_int_distribution<int> percent(0, 99);
+      std::uniform_int_distribution<int> amount_dist(1, 500);
+
+      int home_shard = t % ledger.num_shards();
+      auto account_in = [&](int shard) {
+        return std::min(shard * ledger.shard_size() + in_shard(rng), ledger.num_accounts() - 1);
+      };
+      long long local_succeeded = 0;
+      for (int i = 0; i < transfers_per_thread; ++i) {
+        int from = account_in(home_shard);
+        int to = percent(rng) < cross_shard_percent
+                     ? account_in((home_shard + other_shard(rng)) % ledger.num_shards())
+                     : account_in(home_shard);
+        if (ledger.Transfer(from, to, amount_dist(rng))) {
+          local_succeeded++;
+        }
+      }
+      succeeded += local_succeeded;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  long long total_transfers = static_cast<long long>(num_threads) * transfers_per_thread;
+  bool conserved = ledger.TotalBalance() == static_cast<long long>(kAccounts) * kInitialBalance;
+  std::cout << "threads = " << num_threads << ", cross-shard = " << cross_shard_percent
+            << "% | transfers/sec = " << static_cast<long long>(total_transfers / duration.count())
+            << ", succeeded = " << succeeded << ", retries = " << ledger.retries()
+            << ", money conserved = " << (conserved ? "yes" : "NO") << "\n";
+}
+
+int main() {
+  {
+    Ledger ledger(8, 2, 100);  // Accounts 0-3 in shard 0, 4-7 in shard 1
+
+    std::cout << "Transfer $30 from 0 to 1 (same shard): "
+              << (ledger.Transfer(0, 1, 30) ? "success" : "failed") << "\n";
+    std::cout << "Transfer $50 from 1 to 6 (cross shard): "
+              << (ledger.Transfer(1, 6, 50) ? "success" : "failed") << "\n";
+    std::cout << "Transfer $500 from 2 to 7 (cross shard, rolled back): "
+              << (ledger.Transfer(2, 7, 500) ? "success" : "failed") << "\n";
+    for (int id = 0; id < 8; ++id) {
+      std::cout << " - account " << id << ": $" << ledger.balance(id) << "\n";
+    }
+  }
+  std::cout << "----------------------------------\n";
+
+  unsigned int hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int cross_shard_percent : {0, 10}) {
+    for (int num_threads = 1; num_threads <= static_cast<int>(hardware_threads) * 2;
+         num_threads *= 2) {
+      if (cross_shard_percent > 0 && num_threads == 1) {
+        continue;  // One shard: nothing to cross
+      }
+      RunBenchmark(num_threads, cross_shard_percent, 500000);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,412 @@
+/*
+  Observer with lock-free, allocation-free dispatch.
+
+  In part1, Publiser::Notify walks a std::set<IObserver*> (a pointer-chasing red-black tree) and
+  passes EventInfo by value, copying two std::strings for every observer.
+
+  CowPublisher keeps its observers in a contiguous array that is never modified in place:
+  - Subscribe / Unsubscribe copy the array, apply the change and publish the new array with one
+    atomic pointer store. Writers are serialized by a mutex; readers never take it.
+  - Notify loads the current array and walks it. It does not lock and does not allocate.
+  - Events are passed by const reference, so nothing is copied per observer.
+
+  Old arrays are freed with epoch-based reclamation (EpochDomain): every thread that calls Notify
+  owns a slot on its own cache line, where it announces the epoch it started reading in. Notify
+  writes only to its own slot, so concurrent Notify calls never contend on a shared counter. A
+  writer tags each array it replaces with the epoch after the swap, and frees it once every slot
+  is idle or has announced that epoch or a later one. Since each Notify announces the current
+  epoch, old arrays are freed even while Notify runs continuously on several threads.
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+std::string GetCurrentDateTime() {
+  auto now = std::chrono::system_clock::now();
+  std::time_t now_time = std::chrono::system_clock::to_time_t(now);
+  auto time_string = std::string(std::ctime(&now_time));
+  // Remove newline character added by ctime
+  time_string.erase(time_string.length() - 1);
+  return time_string;
+}
+
+class EventInfo {
+ public:
+  explicit EventInfo(std::string name) : event_name(name), event_time(GetCurrentDateTime()) {}
+
+  const std::string& GetName() const {
+    return event_name;
+  }
+
+  const std::string& GetTime() const {
+    return event_time;
+  }
+
+ private:
+  std::string event_name;
+  std::string event_time;
+};
+
+class IObserver {
+ public:
+  virtual ~IObserver() = default;
+  virtual void Update(const EventInfo& event_info) = 0;
+};
+
+class EventNameTracker : public IObserver {
+ public:
+  void Update(const EventInfo& event_info) override {
+    std::cout << "EventNameTracker: Event '" << event_info.GetName() << "' occurred at "
+              << event_info.GetTime() << std::endl;
+
+    event_names_.push_back(event_info.GetName());
+  }
+
+  std::vector<std::string> GetEventNames() const {
+    return event_names_;
+  }
+
+ private:
+  std::vector<std::string> event_names_;
+};
+
+class LogCounter : public IObserver {
+ public:
+  LogCounter() : count_(0) {}
+
+  void Update(const EventInfo&) override {
+    count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  int count() const {
+    return count_.load();
+  }
+
+ private:
+  std::atomic<int> count_;
+};
+
+/*
+  Epoch-based reclamation, shared by all publishers. A pointer swapped out of an atomic before
+  Retire() returned its epoch is unreachable for readers that started after that, so it can be
+  freed once OldestReader() is at least that epoch.
+*/
+class EpochDomain {
+ public:
+  static constexpr size_t kMaxReaderThreads = 256;
+
+  // Marks the calling thread as reading until destroyed. May be nested.
+  class ReadGuard;
+
+  static EpochDomain& Global() {
+    static EpochDomain domain;
+    return domain;
+  }
+
+  // Call after swapping a pointer out. Returns the epoch to tag it with.
+  uint64_t Retire() {
+    return epoch_.fetch_add(1) + 1;
+  }
+
+  // Smallest epoch announced by a reading thread, or UINT64_MAX if none is reading.
+  uint64_t OldestReader() const {
+    uint64_t oldest = UINT64_MAX;
+    for (const Slot& slot : slots_) {
+      uint64_t epoch = slot.epoch.load();
+      if (epoch != kIdle) {
+        oldest = std::min(oldest, epoch);
+      }
+    }
+    return oldest;
+  }
+
+ private:
+  static constexpr uint64_t kIdle = 0;
+
+  struct alignas(64) Slot {  // One cache line per thread
+    std::atomic<uint64_t> epoch{kIdle};
+    std::atomic<bool> in_use{false};
+  };
+
+  // The calling thread's slot, released when the thread exits.
+  struct ThreadSlot {
+    ~ThreadSlot() {
+      if (slot != nullptr) {
+        slot->epoch.store(kIdle);
+        slot->in_use.store(false, std::memory_order_release);
+      }
+    }
+
+    Slot* slot = nullptr;
+    int depth = 0;  // Nested ReadGuards
+  };
+
+  static ThreadSlot& GetThreadSlot() {
+    thread_local ThreadSlot thread_slot;
+    if (thread_slot.slot == nullptr) {
+      thread_slot.slot = Global().Acquire();
+    }
+    return thread_slot;
+  }
+
+  // Throws std::runtime_error if more than kMaxReaderThreads threads read at once.
+  Slot* Acquire() {
+    for (Slot& slot : slots_) {
+      bool expected = false;
+      if (slot.in_use.compare_exchange_strong(expected, true)) {
+        return &slot;
+      }
+    }
+    throw std::runtime_error("Too many reader threads");
+  }
+
+  std::atomic<uint64_t> epoch_{1};
+  std::array<Slot, kMaxReaderThreads> slots_;
+};
+
+class EpochDomain::ReadGuard {
+ public:
+  ReadGuard() : thread_slot_(GetThreadSlot()) {
+    if (thread_slot_.depth++ == 0) {
+      // Must be visible before the reader loads any protected pointer (seq_cst store).
+      thread_slot_.slot->epoch.store(Global().epoch_.load());
+    }
+  }
+
+  ~ReadGuard() {
+    if (--thread_slot_.depth == 0) {
+      thread_slot_.slot->epoch.store(kIdle, std::memory_order_release);
+    }
+  }
+
+  ReadGuard(const ReadGuard&) = delete;
+  ReadGuard& operator=(const ReadGuard&) = delete;
+
+ private:
+  ThreadSlot& thread_slot_;
+};
+
+class CowPublisher {
+  using ObserverList = std::vector<IObserver*>;
+
+ public:
+  CowPublisher() : observers_(new ObserverList()) {}
+
+  ~CowPublisher() {
+    delete observers_.load();
+    for (const auto& [epoch, list] : retired_) {
+      delete list;
+    }
+  }
+
+  void Subscribe(IObserver* observer) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const ObserverList* current = observers_.load();
+    if (std::find(current->begin(), current->end(), observer) != current->end()) {
+      return;  // Already subscribed
+    }
+    auto* next = new ObserverList(*current);
+    next->push_back(observer);
+    Publish(next);
+  }
+
+  void Unsubscribe(IObserver* observer) {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    const ObserverList* current = observers_.load();
+    auto* next = new ObserverList();
+    next->reserve(current->size());
+    std::copy_if(current->begin(), current->end(), std::back_inserter(*next),
+                 [observer](IObserver* o) { return o != observer; });
+    Publish(next);
+  }
+
+  void Notify(const EventInfo& event_info) {
+    EpochDomain::ReadGuard guard;
+    const ObserverList* observers = observers_.load();
+    for (IObserver* observer : *observers) {
+      observer->Update(event_info);
+    }
+  }
+
+  // Replaced arrays that some reader may still be using.
+  size_t num_retired() {
+    std::lock_guard<std::mutex> lock(writer_mutex_);
+    return retired_.size();
+  }
+
+ private:
+  // Must be called with writer_mutex_ held.
+  void Publish(const ObserverList* next) {
+    const ObserverList* previous = observers_.exchange(next);
+    retired_.push_back({EpochDomain::Global().Retire(), previous});
+
+    // A reader that announced `epoch` or later started after the swap and sees `next` or newer.
+    uint64_t oldest_reader = EpochDomain::Global().OldestReader();
+    auto reachable = std::remove_if(retired_.begin(), retired_.end(), [&](const auto& entry) {
+      if (entry.first > oldest_reader) {
+        return false;
+      }
+      delete entry.second;
+      return true;
+    });
+    retired_.erase(reachable, retired_.end());
+  }
+
+  std::atomic<const ObserverList*> observers_;
+
+  std::mutex writer_mutex_;
+  std::vector<std::pair<uint64_t, const ObserverList*>> retired_;  // (epoch, list)
+};
+
+/*
+  The publisher from part1, with a counting observer, for comparison.
+*/
+namespace legacy {
+
+class IObserver {
+ public:
+  virtual ~IObserver() = default;
+  virtual void Update(EventInfo event_info) = 0;
+};
+
+class LogCounter : public IObserver {
+ public:
+  LogCounter() : count_(0) {}
+
+  void Update(EventInfo) override {
+    count_++;
+  }
+
+  int count() const {
+    return count_;
+  }
+
+ private:
+  int count_;
+};
+
+class Publiser {
+ public:
+  void Subscribe(IObserver* observer) {
+    observers_.insert(observer);
+  }
+
+  void Unsubscribe(IObserver* observer) {
+    observers_.erase(observer);
+  }
+
+  void Notify(EventInfo event_info) {
+    for (IObserver* observer : observers_) {
+      observer->Update(event_info);
+    }
+  }
+
+ private:
+  std::set<IObserver*> observers_;
+};
+
+}  // namespace legacy
+
+template <typename Publisher, typename Counter>
+double MeasureEventsPerSecond(int num_observers, int num_events) {
+  Publisher publisher;
+  std::vector<Counter> counters(num_observers);
+  for (auto& counter : counters) {
+    publisher.Subscribe(&counter);
+  }
+
+  EventInfo event_info("Benchmark Event");
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < num_events; ++i) {
+    publisher.Notify(event_info);
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+  return num_events / duration.count();
+}
+
+int main() {
+  {
+    CowPublisher publisher;
+    EventNameTracker name_tracker;
+    LogCounter log_counter;
+
+    publisher.Subscribe(&name_tracker);
+    publisher.Subscribe(&log_counter);
+
+    publisher.Notify(EventInfo("Event 1"));
+    publisher.Notify(EventInfo("Event 2"));
+
+    publisher.Unsubscribe(&log_counter);
+    publisher.Notify(EventInfo("Event 3"));
+
+    std::cout << "\nTotal Events Logged after unsubscribe: " << log_counter.count() << "\n";
+  }
+
+  std::cout << "----------------------------------\n";
+  {
+    // Subscribe and unsubscribe from another thread while several threads keep publishing.
+    const int kPublishers = 4;
+    const int kEventsPerPublisher = 100000;
+    CowPublisher publisher;
+    LogCounter always_subscribed;
+    LogCounter flapping;
+    publisher.Subscribe(&always_subscribed);
+
+    std::atomic<bool> done(false);
+    size_t max_retired = 0;
+    std::thread writer([&]() {
+      while (!done) {
+        publisher.Subscribe(&flapping);
+        publisher.Unsubscribe(&flapping);
+        max_retired = std::max(max_retired, publisher.num_retired());
+      }
+    });
+
+    std::vector<std::thread> publishers;
+    for (int p = 0; p < kPublishers; ++p) {
+      publishers.emplace_back([&]() {
+        EventInfo event_info("Event");
+        for (int i = 0; i < kEventsPerPublisher; ++i) {
+          publisher.Notify(event_info);
+        }
+      });
+    }
+    for (auto& thread : publishers) {
+      thread.join();
+    }
+    done = true;
+    writer.join();
+
+    std::cout << "Always subscribed observer received " << always_subscribed.count()
+              << " events, flapping observer received " << flapping.count() << "\n";
+    std::cout << "At most " << max_retired << " replaced arrays were waiting to be freed\n";
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const int kDeliveries = 10000000;  // Events * observers, kept constant per run
+  for (int num_observers : {1, 10, 1000}) {
+    int num_events = kDeliveries / num_observers;
+    double legacy_rate =
+        MeasureEventsPerSecond<legacy::Publiser, legacy::LogCounter>(num_observers, num_events);
+    double cow_rate = MeasureEventsPerSecond<CowPublisher, LogCounter>(num_observers, num_events);
+    std::cout << "observers = " << num_observers
+              << " | std::set + by value: " << static_cast<long long>(legacy_rate)
+              << " events/sec, COW array + const&: " << static_cast<long long>(cow_rate)
+              << " events/sec\n";
+  }
+  return 0;
+}
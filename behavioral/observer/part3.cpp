@@ -0,0 +1,222 @@
+/*
+  Observer with cheap event timestamps.
+
+  In part1, every EventInfo constructor calls GetCurrentDateTime(), which reads the system clock,
+  formats it with std::ctime (not thread-safe) and builds a std::string. EventTimeTracker then
+  stores those strings.
+
+  Here an event carries a raw 64-bit timestamp (nanoseconds on the monotonic steady_clock):
+  - Taking a timestamp is a single clock read, no formatting and no allocation.
+  - Formatting happens lazily, only when a time is displayed (FormatTimestamp), using the
+    thread-safe localtime_r.
+  - For high-rate publishers, CoarseClock caches the time in an atomic that a background thread
+    refreshes every millisecond. Reading it is one relaxed atomic load.
+
+  Monotonic timestamps are turned into wall-clock time with an offset captured once at startup.
+*/
+
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Timestamp = uint64_t;  // Nanoseconds on std::chrono::steady_clock
+
+Timestamp Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*
+  Keeps a cached copy of Now() that is refreshed every `resolution` by a background thread.
+*/
+class CoarseClock {
+ public:
+  explicit CoarseClock(std::chrono::microseconds resolution = std::chrono::milliseconds(1)) :
+      now_(::Now()), running_(true) {
+    ticker_ = std::thread([this, resolution]() {
+      while (running_.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(resolution);
+        now_.store(::Now(), std::memory_order_relaxed);
+      }
+    });
+  }
+
+  ~CoarseClock() {
+    running_ = false;
+    ticker_.join();
+  }
+
+  Timestamp Now() const {
+    return now_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<Timestamp> now_;
+  std::atomic<bool> running_;
+  std::thread ticker_;
+};
+
+// Converts a timestamp to the same format as part1, e.g. "Mon Oct 19 02:21:06 2026".
+std::string FormatTimestamp(Timestamp timestamp) {
+  // Wall-clock time of steady_clock's epoch, captured once.
+  static const int64_t wall_clock_offset =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count() -
+      static_cast<int64_t>(Now());
+
+  std::time_t seconds = (static_cast<int64_t>(timestamp) + wall_clock_offset) / 1000000000;
+  std::tm local_time;
+  localtime_r(&seconds, &local_time);
+
+  char buffer[32];
+  std::strftime(buffer, sizeof(buffer), "%a %b %d %H:%M:%S %Y", &local_time);
+  return buffer;
+}
+
+class EventInfo {
+ public:
+  explicit EventInfo(std::string name) : event_name(std::move(name)), event_time(Now()) {}
+
+  EventInfo(std::string name, const CoarseClock& clock) :
+      event_name(std::move(name)), event_time(clock.Now()) {}
+
+  const std::string& GetName() const {
+    return event_name;
+  }
+
+  Timestamp GetTime() const {
+    return event_time;
+  }
+
+ private:
+  std::string event_name;
+  Timestamp event_time;
+};
+
+class IObserver {
+ public:
+  virtual ~IObserver() = default;
+  virtual void Update(const EventInfo& event_info) = 0;
+};
+
+class EventNameTracker : public IObserver {
+ public:
+  void Update(const EventInfo& event_info) override {
+    std::cout << "EventNameTracker: Event '" << event_info.GetName() << "' occurred at "
+              << FormatTimestamp(event_info.GetTime()) << std::endl;
+
+    event_names_.push_back(event_info.GetName());
+  }
+
+  std::vector<std::string> GetEventNames() const {
+    return event_names_;
+  }
+
+ private:
+  std::vector<std::string> event_names_;
+};
+
+class EventTimeTracker : public IObserver {
+ public:
+  void Update(const EventInfo& event_info) override {
+    event_times_.push_back(event_info.GetTime());  // Formatted only when displayed
+  }
+
+  const std::vector<Timestamp>& GetEventTimes() const {
+    return event_times_;
+  }
+
+ private:
+  std::vector<Timestamp> event_times_;
+};
+
+class Publiser {
+ public:
+  void Subscribe(IObserver* observer) {
+    observers_.insert(observer);
+  }
+
+  void Unsubscribe(IObserver* observer) {
+    observers_.erase(observer);
+  }
+
+  void Notify(const EventInfo& event_info) {
+    for (IObserver* observer : observers_) {
+      observer->Update(event_info);
+    }
+  }
+
+ private:
+  std::set<IObserver*> observers_;
+};
+
+// The timestamp from part1, for comparison.
+std::string GetCurrentDateTime() {
+  auto now = std::chrono::system_clock::now();
+  std::time_t now_time = std::chrono::system_clock::to_time_t(now);
+  auto time_string = std::string(std::ctime(&now_time));
+  // Remove newline character added by ctime
+  time_string.erase(time_string.length() - 1);
+  return time_string;
+}
+
+template <typename MakeEvent>
+void MeasureConstruction(const char* label, int num_events, MakeEvent make_event) {
+  uint64_t checksum = 0;  // Keeps the compiler from dropping the work
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < num_events; ++i) {
+    checksum += make_event();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::nano> duration = end_time - start_time;
+
+  std::cout << label << " | " << duration.count() / num_events
+            << " ns/event, checksum = " << checksum << "\n";
+}
+
+int main() {
+  {
+    Publiser publisher;
+    EventNameTracker name_tracker;
+    EventTimeTracker time_tracker;
+
+    publisher.Subscribe(&name_tracker);
+    publisher.Subscribe(&time_tracker);
+
+    publisher.Notify(EventInfo("Event 1"));
+    publisher.Notify(EventInfo("Event 2"));
+
+    std::cout << "\nEvent Times:\n";
+    for (Timestamp time : time_tracker.GetEventTimes()) {
+      std::cout << "- " << FormatTimestamp(time) << " (" << time << " ns)\n";
+    }
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const int kEvents = 2000000;
+  CoarseClock coarse_clock;
+
+  MeasureConstruction("ctime string (part1)", kEvents, []() {
+    std::string name("Event");
+    std::string time = GetCurrentDateTime();
+    return name.size() + time.size();
+  });
+  MeasureConstruction("steady_clock        ", kEvents,
+                      []() { return EventInfo("Event").GetTime(); });
+  MeasureConstruction("coarse clock        ", kEvents,
+                      [&coarse_clock]() { return EventInfo("Event", coarse_clock).GetTime(); });
+  return 0;
+}
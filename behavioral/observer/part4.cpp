@@ -0,0 +1,330 @@
+/*
+  Observer with asynchronous delivery.
+
+  In part1, Publiser::Notify calls every observer's Update in turn, so one slow observer (for
+  example one that prints to the console) stalls the publisher and every other observer.
+
+  AsyncPublisher gives each subscriber its own bounded queue and worker thread:
+  - Notify wraps the event in one shared immutable payload and enqueues a pointer to it for each
+    subscriber. It never calls Update itself.
+  - The worker drains its queue and calls Update on its observer.
+  - When a queue is full, the subscriber's overflow policy decides what happens:
+    - kBlock:      Notify waits until the worker makes room. Nothing is lost while subscribed.
+    - kDropOldest: The oldest queued event is dropped to make room.
+    - kCoalesce:   If an event with the same name is already queued, it is replaced by the new
+                   one (only the latest state matters). Otherwise the oldest event is dropped.
+  - Queue depth, delivered, dropped and coalesced counters are exposed for monitoring.
+*/
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+class EventInfo {
+ public:
+  explicit EventInfo(std::string name, int value = 0) : event_name(name), event_value(value) {}
+
+  const std::string& GetName() const {
+    return event_name;
+  }
+
+  int GetValue() const {
+    return event_value;
+  }
+
+ private:
+  std::string event_name;
+  int event_value;
+};
+
+class IObserver {
+ public:
+  virtual ~IObserver() = default;
+  virtual void Update(const EventInfo& event_info) = 0;
+};
+
+class SlowConsolePrinter : public IObserver {
+ public:
+  void Update(const EventInfo& event_info) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));  // Simulate slow console output
+    last_value_ = event_info.GetValue();
+  }
+
+  int last_value() const {
+    return last_value_.load();
+  }
+
+ private:
+  std::atomic<int> last_value_{-1};
+};
+
+class LogCounter : public IObserver {
+ public:
+  void Update(const EventInfo&) override {
+    count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  int count() const {
+    return count_.load();
+  }
+
+ private:
+  std::atomic<int> count_{0};
+};
+
+enum class OverflowPolicy { kBlock, kDropOldest, kCoalesce };
+
+struct SubscriberStats {
+  size_t queue_depth;
+  long long delivered;
+  long long dropped;
+  long long coalesced;
+};
+
+class AsyncPublisher {
+  using Event = std::shared_ptr<const EventInfo>;
+
+  /*
+    A bounded multi-producer, single-consumer queue plus the worker that drains it.
+  */
+  class Subscriber {
+   public:
+    Subscriber(IObserver* observer, size_t capacity, OverflowPolicy policy) :
+        observer_(observer),
+        capacity_(capacity),
+        policy_(policy),
+        stopping_(false),
+        delivered_(0),
+        dropped_(0),
+        coalesced_(0) {
+      worker_ = std::thread(&Subscriber::Run, this);
+    }
+
+    ~Subscriber() {
+      Stop();
+    }
+
+    // Delivers the events already queued and stops the worker. Later events are ignored.
+    void Stop() {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      not_empty_.notify_one();
+      not_full_.notify_all();  // Blocked producers give up
+      if (worker_.joinable()) {
+        worker_.join();
+      }
+    }
+
+    void Enqueue(const Event& event) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (stopping_) {
+        return;
+      }
+      if (queue_.size() >= capacity_) {
+        switch (policy_) {
+          case OverflowPolicy::kBlock:
+            not_full_.wait(lock, [this]() { return stopping_ || queue_.size() < capacity_; });
+            if (stopping_) {
+              return;
+            }
+            break;
+          case OverflowPolicy::kCoalesce:
+            for (auto it = queue_.rbegin(); it != queue_.rend(); ++it) {
+              if ((*it)->GetName() == event->GetName()) {
+                *it = event;
+                coalesced_++;
+                return;
+              }
+            }
+            [[fallthrough]];
+          case OverflowPolicy::kDropOldest:
+            queue_.pop_front();
+            dropped_++;
+            break;
+        }
+      }
+      queue_.push_back(event);
+      lock.unlock();
+      not_empty_.notify_one();
+    }
+
+    SubscriberStats stats() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return {queue_.size(), delivered_, dropped_, coalesced_};
+    }
+
+   private:
+    void Run() {
+      while (true) {
+        Event event;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          not_empty_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+          if (queue_.empty()) {
+            return;  // Stopping and fully drained
+          }
+          event = std::move(queue_.front());
+          queue_.pop_front();
+        }
+        not_full_.notify_one();
+
+        observer_->Update(*event);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        delivered_++;
+      }
+    }
+
+    IObserver* observer_;
+    const size_t capacity_;
+    const OverflowPolicy policy_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Event> queue_;
+    bool stopping_;
+    long long delivered_;
+    long long dropped_;
+    long long coalesced_;
+
+    std::thread worker_;
+  };
+
+  using SubscriberList = std::vector<std::shared_ptr<Subscriber>>;
+
+ public:
+  AsyncPublisher() : snapshot_(std::make_shared<const SubscriberList>()) {}
+
+  // Throws std::invalid_argument if capacity is 0: no event could ever be queued, so kBlock would
+  // wait forever and the dropping policies would pop from an empty queue.
+  void Subscribe(IObserver* observer, size_t capacity = 1024,
+                 OverflowPolicy policy = OverflowPolicy::kBlock) {
+    if (capacity == 0) {
+      throw std::invalid_argument("Subscriber queue capacity must be positive");
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (subscribers_.find(observer) == subscribers_.end()) {
+      subscribers_.emplace(observer, std::make_shared<Subscriber>(observer, capacity, policy));
+      UpdateSnapshot();
+    }
+  }
+
+  // Events already queued for the observer are still delivered before this returns, and Update
+  // is not called on it afterwards.
+  void Unsubscribe(IObserver* observer) {
+    std::shared_ptr<Subscriber> subscriber;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = subscribers_.find(observer);
+      if (it == subscribers_.end()) {
+        return;
+      }
+      subscriber = std::move(it->second);
+      subscribers_.erase(it);
+      UpdateSnapshot();
+    }
+    // Stopped outside the lock, so that draining does not block Notify. A Notify that still
+    // holds the old snapshot may enqueue to it; those events are ignored.
+    subscriber->Stop();
+  }
+
+  /*
+    The subscriber list is copied under the lock and the events are enqueued after releasing it,
+    so a kBlock subscriber with a full queue delays only this Notify: other publishers' Notify
+    calls, Subscribe, Unsubscribe and stats() do not wait for it.
+  */
+  void Notify(const EventInfo& event_info) {
+    auto event = std::make_shared<const EventInfo>(event_info);  // One payload for everyone
+    std::shared_ptr<const SubscriberList> subscribers;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      subscribers = snapshot_;
+    }
+    for (const auto& subscriber : *subscribers) {
+      subscriber->Enqueue(event);
+    }
+  }
+
+  SubscriberStats stats(IObserver* observer) const {
+    std::shared_ptr<Subscriber> subscriber;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = subscribers_.find(observer);
+      if (it == subscribers_.end()) {
+        return SubscriberStats{0, 0, 0, 0};
+      }
+      subscriber = it->second;
+    }
+    return subscriber->stats();
+  }
+
+ private:
+  // Rebuilds the list that Notify iterates. Called with mutex_ held.
+  void UpdateSnapshot() {
+    auto snapshot = std::make_shared<SubscriberList>();
+    for (const auto& [observer, subscriber] : subscribers_) {
+      snapshot->push_back(subscriber);
+    }
+    snapshot_ = std::move(snapshot);
+  }
+
+  mutable std::mutex mutex_;
+  std::map<IObserver*, std::shared_ptr<Subscriber>> subscribers_;
+  std::shared_ptr<const SubscriberList> snapshot_;  // Copy-on-write, see Notify
+};
+
+void PrintStats(const std::string& label, const SubscriberStats& stats) {
+  std::cout << label << ": depth = " << stats.queue_depth << ", delivered = " << stats.delivered
+            << ", dropped = " << stats.dropped << ", coalesced = " << stats.coalesced << "\n";
+}
+
+int main() {
+  const int kEvents = 20000;
+
+  for (auto policy : {OverflowPolicy::kDropOldest, OverflowPolicy::kCoalesce,
+                      OverflowPolicy::kBlock}) {
+    AsyncPublisher publisher;
+    SlowConsolePrinter printer;
+    LogCounter counter;
+
+    publisher.Subscribe(&printer, 64, policy);
+    publisher.Subscribe(&counter, 1024, OverflowPolicy::kBlock);
+
+    // kBlock on the slow printer would throttle the publisher to its speed; use fewer events.
+    int num_events = policy == OverflowPolicy::kBlock ? 200 : kEvents;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_events; ++i) {
+      // Two event names, so that coalescing has something to merge.
+      publisher.Notify(EventInfo(i % 2 == 0 ? "Price" : "Volume", i));
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::micro> duration = end_time - start_time;
+
+    const char* policy_name = policy == OverflowPolicy::kBlock        ? "kBlock"
+                              : policy == OverflowPolicy::kDropOldest ? "kDropOldest"
+                                                                      : "kCoalesce";
+    std::cout << "Slow printer with " << policy_name << " | " << num_events << " events, "
+              << duration.count() / num_events << " us per Notify\n";
+    PrintStats(" - printer", publisher.stats(&printer));
+    PrintStats(" - counter", publisher.stats(&counter));
+
+    publisher.Unsubscribe(&printer);  // Drains what is left
+    publisher.Unsubscribe(&counter);
+    std::cout << " - printer saw last value " << printer.last_value() << ", counter saw "
+              << counter.count() << " events\n";
+  }
+  return 0;
+}
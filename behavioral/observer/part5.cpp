@@ -0,0 +1,364 @@
+/*
+  Observer with topic-based subscriptions.
+
+  In part1, Publiser broadcasts every event to every observer. An observer that only cares about
+  some event names still receives everything and has to filter on its own. With thousands of
+  observers and high event rates, most of the work in Notify is wasted.
+
+  TopicPublisher indexes subscriptions so that Notify only touches interested observers:
+  - Subscribe(observer, topic):             exact event name, stored in a hash map.
+  - SubscribePrefix(observer, prefix):      every event name starting with `prefix` (e.g.
+                                            "order." matches "order.created"), stored in a trie.
+                                            The empty prefix subscribes to everything.
+  - SubscribeIf(observer, predicate):       arbitrary condition, evaluated for every event. Use it
+                                            sparingly; it cannot be indexed.
+
+  An observer that matches an event through several subscriptions receives it once.
+  Each observer's subscriptions are recorded, so Unsubscribe only touches those; emptied trie
+  branches are pruned and observer ids are reused.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class EventInfo {
+ public:
+  explicit EventInfo(std::string name) : event_name(name) {}
+
+  const std::string& GetName() const {
+    return event_name;
+  }
+
+ private:
+  std::string event_name;
+};
+
+class IObserver {
+ public:
+  virtual ~IObserver() = default;
+  virtual void Update(const EventInfo& event_info) = 0;
+};
+
+class EventNameTracker : public IObserver {
+ public:
+  explicit EventNameTracker(std::string name) : name_(name) {}
+
+  void Update(const EventInfo& event_info) override {
+    std::cout << name_ << ": Event '" << event_info.GetName() << "'\n";
+  }
+
+ private:
+  std::string name_;
+};
+
+class LogCounter : public IObserver {
+ public:
+  void Update(const EventInfo&) override {
+    count_++;
+  }
+
+  long long count() const {
+    return count_;
+  }
+
+ private:
+  long long count_ = 0;
+};
+
+class TopicPublisher {
+ public:
+  using Predicate = std::function<bool(const EventInfo&)>;
+
+  void Subscribe(IObserver* observer, const std::string& topic) {
+    size_t id = Register(observer);
+    exact_[topic].push_back(id);
+    subscriptions_[id].topics.push_back(topic);
+  }
+
+  void SubscribePrefix(IObserver* observer, const std::string& prefix) {
+    size_t id = Register(observer);
+    subscriptions_[id].prefixes.push_back(prefix);
+    TrieNode* node = &prefix_root_;
+    for (char c : prefix) {
+      auto& child = node->children[c];
+      if (!child) {
+        child = std::make_unique<TrieNode>();
+      }
+      node = child.get();
+    }
+    node->subscribers.push_back(id);
+  }
+
+  void SubscribeIf(IObserver* observer, Predicate predicate) {
+    size_t id = Register(observer);
+    predicates_.push_back({id, std::move(predicate)});
+    subscriptions_[id].has_predicate = true;
+  }
+
+  // Removes every subscription of the observer.
+  void Unsubscribe(IObserver* observer) {
+    auto it = ids_.find(observer);
+    if (it == ids_.end()) {
+      return;
+    }
+    size_t id = it->second;
+    auto erase_id = [id](std::vector<size_t>& ids) {
+      ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
+    };
+
+    Subscriptions& subscriptions = subscriptions_[id];
+    for (const std::string& topic : subscriptions.topics) {
+      auto exact = exact_.find(topic);
+      if (exact != exact_.end()) {  // Gone if the topic was subscribed twice
+        erase_id(exact->second);
+        if (exact->second.empty()) {
+          exact_.erase(exact);
+        }
+      }
+    }
+    for (const std::string& prefix : subscriptions.prefixes) {
+      std::vector<TrieNode*> path = {&prefix_root_};
+      for (char c : prefix) {
+        auto child = path.back()->children.find(c);
+        if (child == path.back()->children.end()) {
+          break;  // Pruned already if the prefix was subscribed twice
+        }
+        path.push_back(child->second.get());
+      }
+      if (path.size() != prefix.size() + 1) {
+        continue;
+      }
+      erase_id(path.back()->subscribers);
+      // Prune the branch bottom-up while it holds nothing.
+      for (size_t depth = prefix.size(); depth > 0; --depth) {
+        TrieNode* node = path[depth];
+        if (!node->subscribers.empty() || !node->children.empty()) {
+          break;
+        }
+        path[depth - 1]->children.erase(prefix[depth - 1]);
+      }
+    }
+    if (subscriptions.has_predicate) {
+      predicates_.erase(std::remove_if(predicates_.begin(), predicates_.end(),
+                                       [id](const auto& entry) { return entry.first == id; }),
+                        predicates_.end());
+    }
+
+    subscriptions = Subscriptions();
+    observers_[id] = nullptr;
+    free_ids_.push_back(id);
+    ids_.erase(it);
+  }
+
+  void Notify(const EventInfo& event_info) {
+    epoch_++;
+    const std::string& name = event_info.GetName();
+
+    auto exact = exact_.find(name);
+    if (exact != exact_.end()) {
+      Deliver(exact->second, event_info);
+    }
+
+    // Every trie node on the path spelled by the event name is a matching prefix.
+    const TrieNode* node = &prefix_root_;
+    Deliver(node->subscribers, event_info);
+    for (char c : name) {
+      auto child = node->children.find(c);
+      if (child == node->children.end()) {
+        break;
+      }
+      node = child->second.get();
+      Deliver(node->subscribers, event_info);
+    }
+
+    for (const auto& [id, predicate] : predicates_) {
+      if (predicate(event_info)) {
+        DeliverOnce(id, event_info);
+      }
+    }
+  }
+
+ private:
+  struct TrieNode {
+    std::map<char, std::unique_ptr<TrieNode>> children;
+    std::vector<size_t> subscribers;
+  };
+
+  // What Unsubscribe has to undo for one observer.
+  struct Subscriptions {
+    std::vector<std::string> topics;
+    std::vector<std::string> prefixes;
+    bool has_predicate = false;
+  };
+
+  // Returns the observer's id, reusing the id of an unsubscribed observer if there is one.
+  size_t Register(IObserver* observer) {
+    auto [it, inserted] = ids_.insert({observer, 0});
+    if (inserted) {
+      if (free_ids_.empty()) {
+        it->second = observers_.size();
+        observers_.push_back(observer);
+        delivered_epoch_.push_back(0);
+        subscriptions_.emplace_back();
+      } else {
+        // The id's delivered epoch is older than any future Notify, so it is reset already.
+        it->second = free_ids_.back();
+        free_ids_.pop_back();
+        observers_[it->second] = observer;
+      }
+    }
+    return it->second;
+  }
+
+  void Deliver(const std::vector<size_t>& ids, const EventInfo& event_info) {
+    for (size_t id : ids) {
+      DeliverOnce(id, event_info);
+    }
+  }
+
+  void DeliverOnce(size_t id, const EventInfo& event_info) {
+    if (delivered_epoch_[id] != epoch_) {
+      delivered_epoch_[id] = epoch_;
+      observers_[id]->Update(event_info);
+    }
+  }
+
+  std::unordered_map<IObserver*, size_t> ids_;
+  std::vector<IObserver*> observers_;         // Indexed by id
+  std::vector<uint64_t> delivered_epoch_;     // Indexed by id, last Notify that reached it
+  std::vector<Subscriptions> subscriptions_;  // Indexed by id
+  std::vector<size_t> free_ids_;              // Ids of unsubscribed observers
+  uint64_t epoch_ = 0;
+
+  std::unordered_map<std::string, std::vector<size_t>> exact_;
+  TrieNode prefix_root_;
+  std::vector<std::pair<size_t, Predicate>> predicates_;
+};
+
+/*
+  The part1 approach: broadcast to everyone, and every observer filters by name itself.
+*/
+class FilteringCounter : public IObserver {
+ public:
+  explicit FilteringCounter(std::string topic) : topic_(topic) {}
+
+  void Update(const EventInfo& event_info) override {
+    if (event_info.GetName() == topic_) {
+      count_++;
+    }
+  }
+
+  long long count() const {
+    return count_;
+  }
+
+ private:
+  std::string topic_;
+  long long count_ = 0;
+};
+
+class Publiser {
+ public:
+  void Subscribe(IObserver* observer) {
+    observers_.insert(observer);
+  }
+
+  void Notify(const EventInfo& event_info) {
+    for (IObserver* observer : observers_) {
+      observer->Update(event_info);
+    }
+  }
+
+ private:
+  std::set<IObserver*> observers_;
+};
+
+int main() {
+  {
+    TopicPublisher publisher;
+    EventNameTracker order_tracker("OrderTracker");
+    EventNameTracker created_tracker("CreatedTracker");
+    EventNameTracker everything_tracker("EverythingTracker");
+    EventNameTracker long_name_tracker("LongNameTracker");
+
+    publisher.SubscribePrefix(&order_tracker, "order.");
+    publisher.Subscribe(&created_tracker, "order.created");
+    publisher.Subscribe(&created_tracker, "user.created");
+    publisher.SubscribePrefix(&everything_tracker, "");
+    publisher.SubscribeIf(&long_name_tracker, [](const EventInfo& event_info) {
+      return event_info.GetName().size() > 12;
+    });
+
+    for (const char* name : {"order.created", "order.cancelled", "user.created", "heartbeat"}) {
+      std::cout << "Notify '" << name << "'\n";
+      publisher.Notify(EventInfo(name));
+    }
+
+    publisher.Unsubscribe(&everything_tracker);
+    std::cout << "Notify 'heartbeat' after unsubscribe\n";
+    publisher.Notify(EventInfo("heartbeat"));
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const int kObservers = 5000;
+  const int kTopics = 1000;
+  const int kEvents = 20000;
+
+  std::vector<std::string> topics;
+  for (int i = 0; i < kTopics; ++i) {
+    topics.push_back("topic." + std::to_string(i));
+  }
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> topic_dist(0, kTopics - 1);
+  std::vector<EventInfo> events;
+  for (int i = 0; i < kEvents; ++i) {
+    events.emplace_back(topics[topic_dist(rng)]);
+  }
+
+  {
+    Publiser publisher;
+    std::vector<std::unique_ptr<FilteringCounter>> counters;
+    for (int i = 0; i < kObservers; ++i) {
+      counters.emplace_back(new FilteringCounter(topics[i % kTopics]));
+      publisher.Subscribe(counters.back().get());
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (const auto& event : events) {
+      publisher.Notify(event);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    std::cout << "Broadcast + filter | events/sec = "
+              << static_cast<long long>(kEvents / duration.count()) << "\n";
+  }
+  {
+    TopicPublisher publisher;
+    std::vector<std::unique_ptr<LogCounter>> counters;
+    for (int i = 0; i < kObservers; ++i) {
+      counters.emplace_back(new LogCounter());
+      publisher.Subscribe(counters.back().get(), topics[i % kTopics]);
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (const auto& event : events) {
+      publisher.Notify(event);
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    std::cout << "Topic index        | events/sec = "
+              << static_cast<long long>(kEvents / duration.count()) << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+  Observer with batched publishing.
+
+  In part1, every observer handles one EventInfo at a time through a virtual Update call, and
+  EventNameTracker keeps a copy of every event name in an ever-growing std::vector<std::string>.
+
+  Here:
+  - Publiser::NotifyBatch hands a whole array of events to each observer with one virtual call to
+    IObserver::UpdateBatch. The default UpdateBatch loops over Update, so existing observers keep
+    working; observers that can process events in bulk override it.
+  - LogCounter adds the batch size, and EventTimeHistogram bins the timestamps in a tight loop that
+    the compiler can vectorize.
+  - Event names are interned: NameTable maps each distinct name to a small integer id once, and
+    events carry the id. EventNameTracker stores 4 bytes per event instead of a string, and the
+    names are looked up only when they are displayed.
+
+  C++17 has no std::span, so EventSpan is a minimal (pointer, size) view.
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using NameId = uint32_t;
+using Timestamp = uint64_t;  // Nanoseconds on std::chrono::steady_clock
+
+Timestamp Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/*
+  Maps each distinct event name to a dense id. Names are stored once and never move, so references
+  returned by Name stay valid. Thread-safe.
+*/
+class NameTable {
+ public:
+  static NameTable& Global() {
+    static NameTable table;
+    return table;
+  }
+
+  NameId Intern(const std::string& name) {
+    {
+      std::shared_lock<std::shared_mutex> lock(mutex_);
+      auto it = ids_.find(name);
+      if (it != ids_.end()) {
+        return it->second;
+      }
+    }
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto [it, inserted] = ids_.insert({name, static_cast<NameId>(names_.size())});
+    if (inserted) {
+      names_.push_back(name);
+    }
+    return it->second;
+  }
+
+  const std::string& Name(NameId id) const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return names_[id];
+  }
+
+  size_t size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return names_.size();
+  }
+
+ private:
+  mutable std::shared_mutex mutex_;
+  std::unordered_map<std::string, NameId> ids_;
+  std::deque<std::string> names_;  // Not a vector: growing must not move the names
+};
+
+class EventInfo {
+ public:
+  explicit EventInfo(const std::string& name) :
+      event_name(NameTable::Global().Intern(name)), event_time(Now()) {}
+
+  // For high-rate publishers that intern their names once up front.
+  EventInfo(NameId name, Timestamp time) : event_name(name), event_time(time) {}
+
+  NameId GetNameId() const {
+    return event_name;
+  }
+
+  const std::string& GetName() const {
+    return NameTable::Global().Name(event_name);
+  }
+
+  Timestamp GetTime() const {
+    return event_time;
+  }
+
+ private:
+  NameId event_name;
+  Timestamp event_time;
+};
+
+class EventSpan {
+ public:
+  EventSpan(const EventInfo* data, size_t size) : data_(data), size_(size) {}
+
+  EventSpan(const std::vector<EventInfo>& events) : data_(events.data()), size_(events.size()) {}
+
+  const EventInfo* begin() const {
+    return data_;
+  }
+
+  const EventInfo* end() const {
+    return data_ + size_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  const EventInfo* data_;
+  size_t size_;
+};
+
+class IObserver {
+ public:
+  virtual ~IObserver() = default;
+  virtual void Update(const EventInfo& event_info) = 0;
+
+  virtual void UpdateBatch(EventSpan events) {
+    for (const auto& event_info : events) {
+      Update(event_info);
+    }
+  }
+};
+
+class EventNameTracker : public IObserver {
+ public:
+  void Update(const EventInfo& event_info) override {
+    event_names_.push_back(event_info.GetNameId());
+  }
+
+  void UpdateBatch(EventSpan events) override {
+    size_t offset = event_names_.size();
+    event_names_.resize(offset + events.size());
+    std::transform(events.begin(), events.end(), event_names_.begin() + offset,
+                   [](const EventInfo& event_info) { return event_info.GetNameId(); });
+  }
+
+  size_t size() const {
+    return event_names_.size();
+  }
+
+  std::vector<std::string> GetEventNames() const {
+    std::vector<std::string> names;
+    names.reserve(event_names_.size());
+    for (NameId id : event_names_) {
+      names.push_back(NameTable::Global().Name(id));
+    }
+    return names;
+  }
+
+ private:
+  std::vector<NameId> event_names_;  // Interned, 4 bytes per event
+};
+
+class LogCounter : public IObserver {
+ public:
+  void Update(const EventInfo&) override {
+    count_++;
+  }
+
+  void UpdateBatch(EventSpan events) override {
+    count_ += events.size();
+  }
+
+  long long count() const {
+    return count_;
+  }
+
+ private:
+  long long count_ = 0;
+};
+
+/*
+  Counts events per time bucket (e.g. per millisecond), relative to the first event seen. Events
+  earlier than the first one count in the first bucket, events past the last bucket in the last.
+*/
+class EventTimeHistogram : public IObserver {
+ public:
+  static constexpr int kBuckets = 64;
+
+  explicit EventTimeHistogram(Timestamp bucket_width) : bucket_width_(bucket_width) {}
+
+  void Update(const EventInfo& event_info) override {
+    Add(event_info.GetTime());
+  }
+
+  void UpdateBatch(EventSpan events) override {
+    if (events.size() == 0) {
+      return;
+    }
+    Start(events.begin()->GetTime());
+    for (const auto& event_info : events) {
+      buckets_[Bucket(event_info.GetTime())]++;
+    }
+  }
+
+  const std::array<long long, kBuckets>& buckets() const {
+    return buckets_;
+  }
+
+ private:
+  void Start(Timestamp time) {
+    if (!started_) {
+      start_ = time;
+      started_ = true;
+    }
+  }
+
+  void Add(Timestamp time) {
+    Start(time);
+    buckets_[Bucket(time)]++;
+  }
+
+  Timestamp Bucket(Timestamp time) const {
+    // Timestamps are unsigned, so clamp before subtracting.
+    Timestamp bucket = (std::max(time, start_) - start_) / bucket_width_;
+    return std::min<Timestamp>(bucket, kBuckets - 1);
+  }
+
+  Timestamp bucket_width_;
+  Timestamp start_ = 0;
+  bool started_ = false;
+  std::array<long long, kBuckets> buckets_{};
+};
+
+class Publiser {
+ public:
+  void Subscribe(IObserver* observer) {
+    observers_.insert(observer);
+  }
+
+  void Unsubscribe(IObserver* observer) {
+    observers_.erase(observer);
+  }
+
+  void Notify(const EventInfo& event_info) {
+    for (IObserver* observer : observers_) {
+      observer->Update(event_info);
+    }
+  }
+
+  void NotifyBatch(EventSpan events) {
+    for (IObserver* observer : observers_) {
+      observer->UpdateBatch(events);
+    }
+  }
+
+ private:
+  std::set<IObserver*> observers_;
+};
+
+int main() {
+  {
+    Publiser publisher;
+    EventNameTracker name_tracker;
+    LogCounter log_counter;
+
+    publisher.Subscribe(&name_tracker);
+    publisher.Subscribe(&log_counter);
+
+    publisher.Notify(EventInfo("Event 1"));
+    std::vector<EventInfo> batch = {EventInfo("Event 2"), EventInfo("Event 1"),
+                                    EventInfo("Event 3")};
+    publisher.NotifyBatch(batch);
+
+    std::cout << "Event Names:\n";
+    for (const auto& name : name_tracker.GetEventNames()) {
+      std::cout << "- " << name << "\n";
+    }
+    std::cout << "Distinct names stored: " << NameTable::Global().size() << "\n";
+    std::cout << "Total Events Logged: " << log_counter.count() << "\n";
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const int kEvents = 4000000;
+  std::vector<NameId> names;
+  for (int i = 0; i < 16; ++i) {
+    names.push_back(NameTable::Global().Intern("Event " + std::to_string(i)));
+  }
+  std::vector<EventInfo> events;
+  events.reserve(kEvents);
+  Timestamp start = Now();
+  for (int i = 0; i < kEvents; ++i) {
+    events.emplace_back(names[i % names.size()], start + i * 100);  // One event every 100 ns
+  }
+
+  for (size_t batch_size : {size_t(1), size_t(16), size_t(256), size_t(4096)}) {
+    Publiser publisher;
+    EventNameTracker name_tracker;
+    LogCounter log_counter;
+    EventTimeHistogram histogram(10000000);  // 10 ms buckets
+    publisher.Subscribe(&name_tracker);
+    publisher.Subscribe(&log_counter);
+    publisher.Subscribe(&histogram);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    if (batch_size == 1) {
+      for (const auto& event : events) {
+        publisher.Notify(event);
+      }
+    } else {
+      for (size_t offset = 0; offset < events.size(); offset += batch_size) {
+        publisher.NotifyBatch(
+            EventSpan(events.data() + offset, std::min(batch_size, events.size() - offset)));
+      }
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+
+    std::cout << (batch_size == 1 ? "Notify      " : "NotifyBatch ") << "batch = " << batch_size
+              << " | events/sec = " << static_cast<long long>(kEvents / duration.count())
+              << ", counted = " << log_counter.count() << ", tracked = " << name_tracker.size()
+              << "\n";
+  }
+  return 0;
+}
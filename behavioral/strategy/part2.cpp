@@ -0,0 +1,521 @@
+/*
+  Strategy with weighted routes.
+
+  In part1, NavigatorStrategy::FindShortestPath is an unweighted BFS: every hop costs the same.
+  Real routes have distances and travel times, so here:
+
+  - WeightedMap stores locations with coordinates, walk routes with a distance (meters) and drive
+    routes with a distance and a speed limit (km/h).
+  - WalkNavigator minimizes the walking distance, DriveNavigator minimizes the travel time.
+  - Both run Dijkstra's algorithm on a pairing heap (O(1) insert and amortized O(log n)
+    delete-min, with a cheap decrease-key).
+  - Both optionally run A*: a pluggable heuristic estimates the remaining cost from a location to
+    the destination. It must be consistent: h(a) <= cost(a, b) + h(b) for every route a-b, and 0
+    at the destination. Otherwise the route may not be the shortest, since a location is never
+    reopened once it is settled. The straight-line distance is consistent for walking, and the
+    straight-line distance at the highest speed limit is consistent for driving.
+
+  Location names are interned to integer ids once, when the map is built, so that the search
+  works on flat arrays.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct Location {
+  double x;  // meters
+  double y;  // meters
+};
+
+class WeightedMap {
+ public:
+  struct Edge {
+    int to;
+    double cost;
+  };
+
+  void AddLocation(const std::string& name, double x, double y) {
+    if (ids_.insert({name, static_cast<int>(names_.size())}).second) {
+      names_.push_back(name);
+      locations_.push_back({x, y});
+      walk_adjacency_list_.emplace_back();
+      drive_adjacency_list_.emplace_back();
+    }
+  }
+
+  void AddWalkRoute(const std::string& x, const std::string& y, double distance) {
+    AddEdge(walk_adjacency_list_, id(x), id(y), distance);
+  }
+
+  // Cost of a drive route is its travel time in seconds.
+  void AddDriveRoute(const std::string& x, const std::string& y, double distance,
+                     double speed_limit_kmh) {
+    AddEdge(drive_adjacency_list_, id(x), id(y), distance / (speed_limit_kmh / 3.6));
+    max_speed_ = std::max(max_speed_, speed_limit_kmh / 3.6);
+  }
+
+  int id(const std::string& name) const {
+    return ids_.at(name);
+  }
+
+  const std::string& name(int id) const {
+    return names_[id];
+  }
+
+  const Location& location(int id) const {
+    return locations_[id];
+  }
+
+  int size() const {
+    return static_cast<int>(names_.size());
+  }
+
+  // Highest speed on any drive route, in m/s.
+  double max_speed() const {
+    return max_speed_;
+  }
+
+  const std::vector<std::vector<Edge>>& GetWalkAdjList() const {
+    return walk_adjacency_list_;
+  }
+
+  const std::vector<std::vector<Edge>>& GetDriveAdjList() const {
+    return drive_adjacency_list_;
+  }
+
+ private:
+  static void AddEdge(std::vector<std::vector<Edge>>& adjacency_list, int x, int y, double cost) {
+    adjacency_list[x].push_back({y, cost});
+    adjacency_list[y].push_back({x, cost});
+  }
+
+  std::unordered_map<std::string, int> ids_;
+  std::vector<std::string> names_;
+  std::vector<Location> locations_;
+  std::vector<std::vector<Edge>> walk_adjacency_list_;
+  std::vector<std::vector<Edge>> drive_adjacency_list_;
+  double max_speed_ = 0.0;
+};
+
+/*
+  Min-heap of node ids keyed by double, with decrease-key.
+  Only touched nodes are reset between searches, so one heap can be reused on a large graph.
+*/
+class PairingHeap {
+ public:
+  explicit PairingHeap(int capacity) : nodes_(capacity), root_(-1) {}
+
+  bool empty() const {
+    return root_ < 0;
+  }
+
+  bool contains(int id) const {
+    return nodes_[id].in_heap;
+  }
+
+  void Push(int id, double key) {
+    nodes_[id] = {key, -1, -1, -1, true};
+    root_ = Meld(root_, id);
+  }
+
+  // `key` must not be larger than the current key of `id`.
+  void DecreaseKey(int id, double key) {
+    Node& node = nodes_[id];
+    node.key = key;
+    if (id == root_) {
+      return;
+    }
+    // Detach the subtree rooted at `id` and meld it back at the top.
+    if (nodes_[node.prev].child == id) {
+      nodes_[node.prev].child = node.sibling;
+    } else {
+      nodes_[node.prev].sibling = node.sibling;
+    }
+    if (node.sibling >= 0) {
+      nodes_[node.sibling].prev = node.prev;
+    }
+    node.sibling = node.prev = -1;
+    root_ = Meld(root_, id);
+  }
+
+  int Pop() {
+    int top = root_;
+    nodes_[top].in_heap = false;
+    root_ = MergePairs(nodes_[top].child);
+    return top;
+  }
+
+  void Clear() {
+    while (!empty()) {
+      Pop();
+    }
+  }
+
+ private:
+  struct Node {
+    double key;
+    int child;
+    int sibling;
+    int prev;  // Parent if this is the first child, left sibling otherwise
+    bool in_heap;
+  };
+
+  int Meld(int a, int b) {
+    if (a < 0) {
+      return b;
+    }
+    if (b < 0) {
+      return a;
+    }
+    if (nodes_[b].key < nodes_[a].key) {
+      std::swap(a, b);
+    }
+    // b becomes the first child of a.
+    nodes_[b].sibling = nodes_[a].child;
+    if (nodes_[a].child >= 0) {
+      nodes_[nodes_[a].child].prev = b;
+    }
+    nodes_[b].prev = a;
+    nodes_[a].child = b;
+    nodes_[a].sibling = nodes_[a].prev = -1;
+    return a;
+  }
+
+  // Standard two-pass pairing: meld siblings pairwise left to right, then right to left.
+  int MergePairs(int first) {
+    pairs_.clear();
+    while (first >= 0) {
+      int a = first;
+      int b = nodes_[a].sibling;
+      first = b >= 0 ? nodes_[b].sibling : -1;
+      nodes_[a].sibling = nodes_[a].prev = -1;
+      if (b >= 0) {
+        nodes_[b].sibling = nodes_[b].prev = -1;
+      }
+      pairs_.push_back(Meld(a, b));
+    }
+    int root = -1;
+    for (auto it = pairs_.rbegin(); it != pairs_.rend(); ++it) {
+      root = Meld(root, *it);
+    }
+    return root;
+  }
+
+  std::vector<Node> nodes_;
+  std::vector<int> pairs_;
+  int root_;
+};
+
+struct Route {
+  bool found;
+  double cost;
+  std::vector<std::string> stops;
+  int settled;  // Nodes taken out of the heap, to compare Dijkstra and A*
+};
+
+// Estimated remaining cost from one location to another. Must be consistent (see above).
+using Heuristic = std::function<double(const Location& from, const Location& to)>;
+
+class NavigatorStrategy {
+ public:
+  virtual ~NavigatorStrategy() = default;
+  virtual Route Navigate(const WeightedMap& map, std::string from, std::string to) const = 0;
+
+  static Route FindShortestPath(const WeightedMap& map,
+                                const std::vector<std::vector<WeightedMap::Edge>>& adjacency_list,
+                                int from, int to, const Heuristic& heuristic) {
+    Scratch& scratch = GetScratch(map.size());
+    const Location& target = map.location(to);
+    auto estimate = [&](int id) {
+      return heuristic ? heuristic(map.location(id), target) : 0.0;
+    };
+
+    scratch.Touch(from);
+    scratch.distance[from] = 0.0;
+    scratch.heap.Push(from, estimate(from));
+
+    int settled = 0;
+    bool found = false;
+    while (!scratch.heap.empty()) {
+      int current = scratch.heap.Pop();
+      settled++;
+      if (current == to) {
+        found = true;
+        break;
+      }
+      for (const auto& edge : adjacency_list[current]) {
+        double distance = scratch.distance[current] + edge.cost;
+        if (scratch.Touch(edge.to) || distance < scratch.distance[edge.to]) {
+          // With a consistent heuristic, a settled node is never improved again.
+          bool in_heap = scratch.heap.contains(edge.to);
+          if (!in_heap && scratch.distance[edge.to] < std::numeric_limits<double>::infinity()) {
+            continue;
+          }
+          scratch.distance[edge.to] = distance;
+          scratch.parent[edge.to] = current;
+          if (in_heap) {
+            scratch.heap.DecreaseKey(edge.to, distance + estimate(edge.to));
+          } else {
+            scratch.heap.Push(edge.to, distance + estimate(edge.to));
+          }
+        }
+      }
+    }
+
+    Route route{found, found ? scratch.distance[to] : 0.0, {}, settled};
+    if (found) {
+      for (int at = to; at != -1; at = scratch.parent[at]) {
+        route.stops.push_back(map.name(at));
+      }
+      std::reverse(route.stops.begin(), route.stops.end());
+    }
+    scratch.Reset();
+    return route;
+  }
+
+ private:
+  // Search state sized for the whole map, reused across queries on the same thread.
+  struct Scratch {
+    explicit Scratch(int size) :
+        distance(size, std::numeric_limits<double>::infinity()), parent(size, -1), heap(size) {}
+
+    // Returns true if the node had not been reached yet in this search.
+    bool Touch(int id) {
+      if (parent[id] == -1 && distance[id] == std::numeric_limits<double>::infinity()) {
+        touched.push_back(id);
+        return true;
+      }
+      return false;
+    }
+
+    void Reset() {
+      for (int id : touched) {
+        distance[id] = std::numeric_limits<double>::infinity();
+        parent[id] = -1;
+      }
+      touched.clear();
+      heap.Clear();
+    }
+
+    std::vector<double> distance;
+    std::vector<int> parent;
+    std::vector<int> touched;
+    PairingHeap heap;
+  };
+
+  static Scratch& GetScratch(int size) {
+    thread_local std::vector<Scratch> scratch;
+    if (scratch.empty() || static_cast<int>(scratch.back().distance.size()) != size) {
+      scratch.clear();
+      scratch.emplace_back(size);
+    }
+    return scratch.back();
+  }
+};
+
+class WalkNavigator : public NavigatorStrategy {
+ public:
+  // Straight-line distance: no walk route can be shorter.
+  static double StraightLine(const Location& from, const Location& to) {
+    return std::hypot(from.x - to.x, from.y - to.y);
+  }
+
+  explicit WalkNavigator(bool use_a_star = false) : use_a_star_(use_a_star) {}
+
+  Route Navigate(const WeightedMap& map, std::string from, std::string to) const override {
+    return FindShortestPath(map, map.GetWalkAdjList(), map.id(from), map.id(to),
+                            use_a_star_ ? Heuristic(StraightLine) : Heuristic());
+  }
+
+ private:
+  bool use_a_star_;
+};
+
+class DriveNavigator : public NavigatorStrategy {
+ public:
+  // Uses A* with `heuristic` if one is given, plain Dijkstra otherwise.
+  explicit DriveNavigator(Heuristic heuristic = Heuristic()) : heuristic_(heuristic) {}
+
+  Route Navigate(const WeightedMap& map, std::string from, std::string to) const override {
+    return FindShortestPath(map, map.GetDriveAdjList(), map.id(from), map.id(to), heuristic_);
+  }
+
+  // Straight line at the highest speed limit on the map: no drive can be faster.
+  // A map without drive routes has no speed limit; the heuristic is then 0 (plain Dijkstra).
+  static Heuristic FastestStraightLine(const WeightedMap& map) {
+    double max_speed = map.max_speed();
+    if (max_speed <= 0.0) {
+      return [](const Location&, const Location&) { return 0.0; };
+    }
+    return [max_speed](const Location& from, const Location& to) {
+      return std::hypot(from.x - to.x, from.y - to.y) / max_speed;
+    };
+  }
+
+ private:
+  Heuristic heuristic_;
+};
+
+class Traveler {
+ public:
+  Traveler() : strategy_(nullptr) {}
+
+  void set_strategy(NavigatorStrategy* strategy) {
+    strategy_ = strategy;
+  }
+
+  Route Navigate(const WeightedMap& map, std::string from, std::string to) const {
+    assert(strategy_ != nullptr && "Strategy must be set before navigating");
+    return strategy_->Navigate(map, from, to);
+  }
+
+ private:
+  NavigatorStrategy* strategy_;  // Strategy for navigation
+};
+
+void PrintRoute(const std::string& label, const Route& route, const std::string& unit) {
+  if (!route.found) {
+    std::cout << label << ": no route found\n";
+    return;
+  }
+  std::cout << label << ": ";
+  for (const auto& stop : route.stops) {
+    std::cout << stop << " ";
+  }
+  std::cout << "(" << route.cost << " " << unit << ")\n";
+}
+
+/*
+  Road-network-sized benchmark graph: a side x side grid with jittered coordinates.
+  Every edge is at least as long as the straight line between its ends, so the A* heuristics
+  stay consistent.
+*/
+WeightedMap BuildGridMap(int side) {
+  WeightedMap map;
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> jitter(-30.0, 30.0);
+  std::uniform_real_distribution<double> detour(1.0, 1.5);
+  std::uniform_int_distribution<int> speed(3, 10);  // x10 km/h
+
+  auto name = [side](int r, int c) { return std::to_string(r * side + c); };
+  for (int r = 0; r < side; ++r) {
+    for (int c = 0; c < side; ++c) {
+      map.AddLocation(name(r, c), c * 100.0 + jitter(rng), r * 100.0 + jitter(rng));
+    }
+  }
+  auto connect = [&](int r1, int c1, int r2, int c2) {
+    const Location& a = map.location(r1 * side + c1);
+    const Location& b = map.location(r2 * side + c2);
+    double distance = std::hypot(a.x - b.x, a.y - b.y) * detour(rng);
+    map.AddWalkRoute(name(r1, c1), name(r2, c2), distance);
+    map.AddDriveRoute(name(r1, c1), name(r2, c2), distance, speed(rng) * 10.0);
+  };
+  for (int r = 0; r < side; ++r) {
+    for (int c = 0; c < side; ++c) {
+      if (c + 1 < side) {
+        connect(r, c, r, c + 1);
+      }
+      if (r + 1 < side) {
+        connect(r, c, r + 1, c);
+      }
+    }
+  }
+  return map;
+}
+
+int main() {
+  {
+    /*
+      Same places as part1, with distances in meters:
+
+          A --100-- B --100-- C
+          |                   |
+         50                  300
+          |                   |
+          D -------400------- E
+
+      Walking from A to E: A-B-C-E is 500 m, A-D-E is 450 m.
+      Driving: A-D-E has a 30 km/h limit, A-B-C-E has a 90 km/h limit, so A-B-C-E is faster.
+    */
+    WeightedMap map;
+    map.AddLocation("A", 0, 0);
+    map.AddLocation("B", 100, 0);
+    map.AddLocation("C", 200, 0);
+    map.AddLocation("D", 0, 50);
+    map.AddLocation("E", 200, 50);
+
+    map.AddWalkRoute("A", "B", 100);
+    map.AddWalkRoute("B", "C", 100);
+    map.AddWalkRoute("C", "E", 300);
+    map.AddWalkRoute("A", "D", 50);
+    map.AddWalkRoute("D", "E", 400);
+
+    map.AddDriveRoute("A", "B", 100, 90);
+    map.AddDriveRoute("B", "C", 100, 90);
+    map.AddDriveRoute("C", "E", 300, 90);
+    map.AddDriveRoute("A", "D", 50, 30);
+    map.AddDriveRoute("D", "E", 400, 30);
+
+    Traveler traveler;
+    WalkNavigator walk_navigator(true);
+    DriveNavigator drive_navigator(DriveNavigator::FastestStraightLine(map));
+
+    traveler.set_strategy(&walk_navigator);
+    PrintRoute("Walk route from A to E", traveler.Navigate(map, "A", "E"), "meters");
+
+    traveler.set_strategy(&drive_navigator);
+    PrintRoute("Drive route from A to E", traveler.Navigate(map, "A", "E"), "seconds");
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const int kSide = 1000;  // 10^6 locations
+  auto build_start = std::chrono::high_resolution_clock::now();
+  WeightedMap map = BuildGridMap(kSide);
+  auto build_end = std::chrono::high_resolution_clock::now();
+  std::cout << "Built a map with " << map.size() << " locations in "
+            << std::chrono::duration<double>(build_end - build_start).count() << " s\n";
+
+  std::mt19937 rng(5);
+  std::uniform_int_distribution<int> node_dist(0, map.size() - 1);
+  std::vector<std::pair<std::string, std::string>> queries;
+  for (int i = 0; i < 10; ++i) {
+    queries.push_back({map.name(node_dist(rng)), map.name(node_dist(rng))});
+  }
+
+  DriveNavigator dijkstra;
+  DriveNavigator a_star(DriveNavigator::FastestStraightLine(map));
+  WalkNavigator walk_a_star(true);
+
+  auto run = [&](const char* label, const NavigatorStrategy& strategy) {
+    long long settled = 0;
+    double total_cost = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (const auto& [from, to] : queries) {
+      Route route = strategy.Navigate(map, from, to);
+      settled += route.settled;
+      total_cost += route.cost;
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> duration = end_time - start_time;
+    std::cout << label << " | " << duration.count() / queries.size() << " ms/query, "
+              << settled / static_cast<long long>(queries.size()) << " settled/query, "
+              << "total cost = " << total_cost << "\n";
+  };
+
+  run("Drive, Dijkstra (pairing heap)", dijkstra);
+  run("Drive, A* (pairing heap)      ", a_star);
+  run("Walk,  A* (pairing heap)      ", walk_a_star);
+  return 0;
+}
@@ -0,0 +1,459 @@
+/*
+  Strategy on a compact graph.
+
+  In part1, Map stores both adjacency lists as std::map<std::string, std::set<std::string>>, so
+  the BFS in NavigatorStrategy::FindShortestPath compares strings, walks trees for every
+  adjacency_list.at(current), and copies strings into its queue and its visited map.
+
+  Here Map is only used to build the routes. Map::Freeze() compiles it into a CompactMap:
+  - Every location gets a dense integer id. The name <-> id dictionary is kept in CompactMap.
+  - Walk and drive routes become compressed sparse row (CSR) graphs: the neighbors of node i are
+    targets[offsets[i]] .. targets[offsets[i + 1] - 1], all in one flat array.
+  - BFS marks visited nodes in a bitset, uses a flat array as its queue and records parents in
+    another flat array. The arrays are reused across queries on the same thread.
+  - The Navigate API still takes and returns names: they are mapped to ids on the way in and back
+    to names on the way out.
+
+  Ids are assigned in name order and neighbors are sorted, so routes are the same as in part1.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class CompactMap;
+
+class Map {
+ public:
+  void AddWalkRoute(std::string x, std::string y) {
+    walk_adjacency_list_[x].insert(y);
+    walk_adjacency_list_[y].insert(x);
+  }
+
+  void AddDriveRoute(std::string x, std::string y) {
+    drive_adjacency_list_[x].insert(y);
+    drive_adjacency_list_[y].insert(x);
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetWalkAdjList() const {
+    return walk_adjacency_list_;
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetDriveAdjList() const {
+    return drive_adjacency_list_;
+  }
+
+  // Compiles the current routes into a read-only CompactMap.
+  CompactMap Freeze() const;
+
+ private:
+  std::map<std::string, std::set<std::string>>
+      walk_adjacency_list_;  // Adjacency list representation of the map
+  std::map<std::string, std::set<std::string>>
+      drive_adjacency_list_;  // Adjacency list for driving routes
+};
+
+using NodeId = uint32_t;
+constexpr NodeId kInvalidNode = ~NodeId(0);
+
+/*
+  Compressed sparse row adjacency: one offsets array and one targets array.
+*/
+class CsrGraph {
+ public:
+  CsrGraph() : offsets_(1, 0) {}
+
+  // `adjacency_list` may not contain every node; missing nodes get no neighbors.
+  CsrGraph(const std::map<std::string, std::set<std::string>>& adjacency_list,
+           const std::unordered_map<std::string, NodeId>& ids, size_t num_nodes) :
+      offsets_(num_nodes + 1, 0) {
+    for (const auto& [name, neighbors] : adjacency_list) {
+      offsets_[ids.at(name) + 1] = static_cast<uint32_t>(neighbors.size());
+    }
+    for (size_t i = 0; i < num_nodes; ++i) {
+      offsets_[i + 1] += offsets_[i];
+    }
+    targets_.resize(offsets_.back());
+    for (const auto& [name, neighbors] : adjacency_list) {
+      NodeId* out = targets_.data() + offsets_[ids.at(name)];
+      for (const auto& neighbor : neighbors) {
+        *out++ = ids.at(neighbor);  // Sorted, since ids follow name order
+      }
+    }
+  }
+
+  const NodeId* begin(NodeId node) const {
+    return targets_.data() + offsets_[node];
+  }
+
+  const NodeId* end(NodeId node) const {
+    return targets_.data() + offsets_[node + 1];
+  }
+
+  size_t num_nodes() const {
+    return offsets_.size() - 1;
+  }
+
+  size_t num_edges() const {
+    return targets_.size();
+  }
+
+ private:
+  std::vector<uint32_t> offsets_;  // num_nodes + 1 entries
+  std::vector<NodeId> targets_;
+};
+
+class CompactMap {
+ public:
+  explicit CompactMap(const Map& map) {
+    // Both adjacency maps are sorted by name, so merging their keys gives sorted, unique names.
+    const auto& walk = map.GetWalkAdjList();
+    const auto& drive = map.GetDriveAdjList();
+    auto w = walk.begin();
+    auto d = drive.begin();
+    while (w != walk.end() || d != drive.end()) {
+      if (d == drive.end() || (w != walk.end() && w->first < d->first)) {
+        names_.push_back((w++)->first);
+      } else if (w == walk.end() || d->first < w->first) {
+        names_.push_back((d++)->first);
+      } else {
+        names_.push_back(w->first);
+        ++w;
+        ++d;
+      }
+    }
+    ids_.reserve(names_.size());
+    for (NodeId id = 0; id < names_.size(); ++id) {
+      ids_.emplace(names_[id], id);
+    }
+    walk_graph_ = CsrGraph(walk, ids_, names_.size());
+    drive_graph_ = CsrGraph(drive, ids_, names_.size());
+  }
+
+  // kInvalidNode if the location is not on the map.
+  NodeId id(const std::string& name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? kInvalidNode : it->second;
+  }
+
+  const std::string& name(NodeId id) const {
+    return names_[id];
+  }
+
+  size_t size() const {
+    return names_.size();
+  }
+
+  const CsrGraph& GetWalkGraph() const {
+    return walk_graph_;
+  }
+
+  const CsrGraph& GetDriveGraph() const {
+    return drive_graph_;
+  }
+
+ private:
+  std::vector<std::string> names_;  // Indexed by id
+  std::unordered_map<std::string, NodeId> ids_;
+  CsrGraph walk_graph_;
+  CsrGraph drive_graph_;
+};
+
+CompactMap Map::Freeze() const {
+  return CompactMap(*this);
+}
+
+class NavigatorStrategy {
+ public:
+  virtual ~NavigatorStrategy() = default;
+  virtual std::pair<bool, std::vector<std::string>> Navigate(const CompactMap& map,
+                                                             std::string from,
+                                                             std::string to) const = 0;
+
+  // Returns the ids on the route from `from` to `to`, or an empty vector if there is none.
+  static std::vector<NodeId> FindShortestPath(const CsrGraph& graph, NodeId from, NodeId to) {
+    Scratch& scratch = GetScratch(graph.num_nodes());
+    std::fill(scratch.visited.begin(), scratch.visited.end(), 0);
+
+    size_t head = 0;
+    size_t tail = 0;
+    scratch.queue[tail++] = from;
+    scratch.Visit(from);
+    scratch.parent[from] = kInvalidNode;
+
+    bool found = false;
+    while (head < tail) {
+      NodeId current = scratch.queue[head++];
+      if (current == to) {
+        found = true;
+        break;
+      }
+      for (const NodeId* it = graph.begin(current); it != graph.end(current); ++it) {
+        if (!scratch.IsVisited(*it)) {
+          scratch.Visit(*it);
+          scratch.parent[*it] = current;
+          scratch.queue[tail++] = *it;  // Every node is queued at most once
+        }
+      }
+    }
+
+    if (!found) {
+      return {};
+    }
+    std::vector<NodeId> route;
+    for (NodeId at = to; at != kInvalidNode; at = scratch.parent[at]) {
+      route.push_back(at);
+    }
+    std::reverse(route.begin(), route.end());
+    return route;
+  }
+
+ protected:
+  // Maps names to ids, searches, and maps the route back to names.
+  static std::pair<bool, std::vector<std::string>> Navigate(const CompactMap& map,
+                                                            const CsrGraph& graph,
+                                                            const std::string& from,
+                                                            const std::string& to) {
+    NodeId from_id = map.id(from);
+    NodeId to_id = map.id(to);
+    if (from_id == kInvalidNode || to_id == kInvalidNode) {
+      return {false, {}};
+    }
+    std::vector<std::string> route;
+    for (NodeId id : FindShortestPath(graph, from_id, to_id)) {
+      route.push_back(map.name(id));
+    }
+    return {route.empty() == false, route};
+  }
+
+ private:
+  struct Scratch {
+    explicit Scratch(size_t num_nodes) :
+        visited((num_nodes + 63) / 64), parent(num_nodes), queue(num_nodes) {}
+
+    bool IsVisited(NodeId node) const {
+      return (visited[node / 64] >> (node % 64)) & 1;
+    }
+
+    void Visit(NodeId node) {
+      visited[node / 64] |= uint64_t(1) << (node % 64);
+    }
+
+    std::vector<uint64_t> visited;  // Bitset, 1 bit per node
+    std::vector<NodeId> parent;     // Only valid for visited nodes
+    std::vector<NodeId> queue;
+  };
+
+  static Scratch& GetScratch(size_t num_nodes) {
+    thread_local std::vector<Scratch> scratch;
+    if (scratch.empty() || scratch.back().parent.size() != num_nodes) {
+      scratch.clear();
+      scratch.emplace_back(num_nodes);
+    }
+    return scratch.back();
+  }
+};
+
+class WalkNavigator : public NavigatorStrategy {
+ public:
+  std::pair<bool, std::vector<std::string>> Navigate(const CompactMap& map, std::string from,
+                                                     std::string to) const override {
+    return NavigatorStrategy::Navigate(map, map.GetWalkGraph(), from, to);
+  }
+};
+
+class DriveNavigator : public NavigatorStrategy {
+ public:
+  std::pair<bool, std::vector<std::string>> Navigate(const CompactMap& map, std::string from,
+                                                     std::string to) const override {
+    return NavigatorStrategy::Navigate(map, map.GetDriveGraph(), from, to);
+  }
+};
+
+class Traveler {
+ public:
+  Traveler() : strategy_(nullptr) {}
+
+  void set_strategy(NavigatorStrategy* strategy) {
+    strategy_ = strategy;
+  }
+
+  std::pair<bool, std::vector<std::string>> Navigate(const CompactMap& map, std::string from,
+                                                     std::string to,
+                                                     std::string stopover = std::string()) const {
+    assert(strategy_ != nullptr && "Strategy must be set before navigating");
+
+    std::vector<std::string> complete_route;
+    if (stopover.empty()) {
+      auto [found, route] = strategy_->Navigate(map, from, to);
+      if (found) {
+        complete_route = route;
+      }
+    } else {
+      auto [found1, route1] = strategy_->Navigate(map, from, stopover);
+      auto [found2, route2] = strategy_->Navigate(map, stopover, to);
+
+      if (found1 && found2) {
+        complete_route = route1;
+        complete_route.insert(complete_route.end(), route2.begin(), route2.end());
+      }
+    }
+
+    return {complete_route.empty() == false, complete_route};
+  }
+
+ private:
+  NavigatorStrategy* strategy_;  // Strategy for navigation
+};
+
+namespace legacy {
+
+// The part1 BFS, for comparison.
+std::vector<std::string> FindShortestPath(
+    const std::map<std::string, std::set<std::string>>& adjacency_list, std::string from,
+    std::string to) {
+  std::map<std::string, std::string> visited;  // also store visited from where
+
+  std::queue<std::string> queue;
+  queue.push(from);
+  visited.insert({from, ""});
+
+  bool found = false;
+  while (!queue.empty()) {
+    std::string current = queue.front();
+    queue.pop();
+
+    if (current == to) {
+      found = true;
+      break;
+    }
+
+    for (const auto& neighbor : adjacency_list.at(current)) {
+      if (visited.find(neighbor) == visited.end()) {
+        visited.insert({neighbor, current});
+        queue.push(neighbor);
+      }
+    }
+  }
+
+  if (!found) {
+    return {};
+  }
+  std::vector<std::string> route;
+  for (std::string at = to; !at.empty(); at = visited[at]) {
+    route.push_back(at);
+  }
+  std::reverse(route.begin(), route.end());
+  return route;
+}
+
+}  // namespace legacy
+
+void PrintRoute(const std::string& label, const std::pair<bool, std::vector<std::string>>& result) {
+  if (!result.first) {
+    std::cout << "No " << label << " found.\n";
+    return;
+  }
+  std::cout << label << ": ";
+  for (const auto& stop : result.second) {
+    std::cout << stop << " ";
+  }
+  std::cout << "\n";
+}
+
+int main() {
+  {
+    // Same map as part1.
+    Map map;
+    map.AddWalkRoute("A", "B");
+    map.AddWalkRoute("A", "D");
+    map.AddWalkRoute("B", "C");
+    map.AddWalkRoute("C", "E");
+    map.AddWalkRoute("D", "E");
+    map.AddWalkRoute("F", "G");
+    map.AddWalkRoute("F", "H");
+
+    map.AddDriveRoute("A", "B");
+    map.AddDriveRoute("B", "C");
+    map.AddDriveRoute("C", "H");
+    map.AddDriveRoute("A", "D");
+    map.AddDriveRoute("D", "E");
+    map.AddDriveRoute("F", "G");
+    map.AddDriveRoute("F", "H");
+
+    CompactMap compact_map = map.Freeze();
+    Traveler traveler;
+    WalkNavigator walk_navigator;
+    DriveNavigator drive_navigator;
+
+    traveler.set_strategy(&walk_navigator);
+    PrintRoute("Walk route from A to E", traveler.Navigate(compact_map, "A", "E"));
+    PrintRoute("walk route from A to G", traveler.Navigate(compact_map, "A", "G"));
+
+    traveler.set_strategy(&drive_navigator);
+    PrintRoute("Drive route from A to G", traveler.Navigate(compact_map, "A", "G"));
+  }
+
+  std::cout << "----------------------------------\n";
+
+  // A side x side grid of streets.
+  const int kSide = 300;
+  const int kQueries = 20;
+  Map map;
+  auto name = [](int r, int c) { return "r" + std::to_string(r) + "c" + std::to_string(c); };
+  for (int r = 0; r < kSide; ++r) {
+    for (int c = 0; c < kSide; ++c) {
+      if (c + 1 < kSide) {
+        map.AddDriveRoute(name(r, c), name(r, c + 1));
+      }
+      if (r + 1 < kSide) {
+        map.AddDriveRoute(name(r, c), name(r + 1, c));
+      }
+    }
+  }
+
+  auto freeze_start = std::chrono::high_resolution_clock::now();
+  CompactMap compact_map = map.Freeze();
+  auto freeze_end = std::chrono::high_resolution_clock::now();
+  std::cout << "Froze " << compact_map.size() << " locations and "
+            << compact_map.GetDriveGraph().num_edges() << " directed edges in "
+            << std::chrono::duration<double, std::milli>(freeze_end - freeze_start).count()
+            << " ms\n";
+
+  std::vector<std::pair<std::string, std::string>> queries;
+  for (int i = 0; i < kQueries; ++i) {
+    queries.push_back({name(i * 7 % kSide, i * 13 % kSide), name(kSide - 1 - i, kSide - 1)});
+  }
+
+  size_t legacy_stops = 0;
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (const auto& [from, to] : queries) {
+    legacy_stops += legacy::FindShortestPath(map.GetDriveAdjList(), from, to).size();
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::milli> legacy_duration = end_time - start_time;
+
+  DriveNavigator drive_navigator;
+  size_t compact_stops = 0;
+  start_time = std::chrono::high_resolution_clock::now();
+  for (const auto& [from, to] : queries) {
+    compact_stops += drive_navigator.Navigate(compact_map, from, to).second.size();
+  }
+  end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::milli> compact_duration = end_time - start_time;
+
+  std::cout << "std::map BFS (part1) | " << legacy_duration.count() / kQueries
+            << " ms/query, total stops = " << legacy_stops << "\n";
+  std::cout << "CSR BFS              | " << compact_duration.count() / kQueries
+            << " ms/query, total stops = " << compact_stops << "\n";
+  return 0;
+}
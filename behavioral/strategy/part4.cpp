@@ -0,0 +1,798 @@
+/*
+  Strategy with precomputation and a route cache.
+
+  In part1, every Traveler::Navigate call runs a full BFS, and a stopover runs two. Our traffic
+  asks for the same origin/destination pairs over and over, and most maps rarely change.
+
+  Here:
+  - Map keeps a version number that is unique in the process: a new map and every
+    AddWalkRoute/AddDriveRoute take the next value of a global counter. Two maps with the same
+    version have the same routes (one is a copy of the other), so a version identifies both the
+    map and its state, even if a new map is later created at the address of an old one.
+  - ContractionHierarchy preprocesses one set of routes of a static map. Locations are contracted
+    one by one, from least to most important, and shortcuts are added where a shortest path went
+    through the contracted location. A query then only searches upward, from both ends, and
+    settles a few hundred locations instead of a large part of the map. Shortcuts are unpacked
+    into the original stops at the end.
+  - PrecomputedNavigator is a strategy backed by a ContractionHierarchy. If the map has changed
+    since the hierarchy was built, it falls back to BFS until Rebuild() is called.
+  - Traveler keeps an LRU cache of routes keyed by (strategy id, from, to). It is cleared whenever
+    it sees a different map version, so a stale route is never returned. Strategy ids are unique
+    in the process like map versions, so a strategy created at the address of a destroyed one
+    never sees the old one's routes.
+
+  Routes are unweighted, so every route has length 1 and a shortest route has the fewest stops.
+  The hierarchy may return a different route than BFS when there are ties, with the same number
+  of stops.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Map {
+ public:
+  Map() : version_(NextVersion()) {}
+
+  void AddWalkRoute(std::string x, std::string y) {
+    walk_adjacency_list_[x].insert(y);
+    walk_adjacency_list_[y].insert(x);
+    version_ = NextVersion();
+  }
+
+  void AddDriveRoute(std::string x, std::string y) {
+    drive_adjacency_list_[x].insert(y);
+    drive_adjacency_list_[y].insert(x);
+    version_ = NextVersion();
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetWalkAdjList() const {
+    return walk_adjacency_list_;
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetDriveAdjList() const {
+    return drive_adjacency_list_;
+  }
+
+  // Changes every time a route is added. Never 0, and never shared with a map that has different
+  // routes.
+  uint64_t version() const {
+    return version_;
+  }
+
+ private:
+  static uint64_t NextVersion() {
+    static std::atomic<uint64_t> next_version(1);
+    return next_version.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::map<std::string, std::set<std::string>>
+      walk_adjacency_list_;  // Adjacency list representation of the map
+  std::map<std::string, std::set<std::string>>
+      drive_adjacency_list_;  // Adjacency list for driving routes
+  uint64_t version_;
+};
+
+using AdjacencyList = std::map<std::string, std::set<std::string>>;
+
+class ContractionHierarchy {
+ public:
+  explicit ContractionHierarchy(const AdjacencyList& adjacency_list) {
+    for (const auto& [name, neighbors] : adjacency_list) {
+      ids_.emplace(name, static_cast<int>(names_.size()));
+      names_.push_back(name);
+    }
+    int n = static_cast<int>(names_.size());
+    std::vector<std::vector<Arc>> graph(n);
+    for (const auto& [name, neighbors] : adjacency_list) {
+      for (const auto& neighbor : neighbors) {
+        graph[ids_[name]].push_back({ids_[neighbor], 1, kNone});
+      }
+    }
+    Contract(graph);
+  }
+
+  // Stops from `from` to `to`, both included, or an empty vector if there is no route.
+  std::vector<std::string> FindShortestPath(const std::string& from, const std::string& to) const {
+    auto from_it = ids_.find(from);
+    auto to_it = ids_.find(to);
+    if (from_it == ids_.end() || to_it == ids_.end()) {
+      return {};
+    }
+    std::vector<int> stops = Query(from_it->second, to_it->second);
+    std::vector<std::string> route;
+    route.reserve(stops.size());
+    for (int id : stops) {
+      route.push_back(names_[id]);
+    }
+    return route;
+  }
+
+  size_t num_shortcuts() const {
+    return num_shortcuts_;
+  }
+
+  // Locations settled by the most recent query on any thread.
+  int last_settled() const {
+    return last_settled_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr int kNone = -1;
+  static constexpr uint32_t kInfinity = std::numeric_limits<uint32_t>::max();
+  static constexpr int kWitnessSettleLimit = 64;
+
+  struct Arc {
+    int to;
+    uint32_t length;
+    int middle;  // kNone for an original route, the contracted location for a shortcut
+  };
+
+  using Entry = std::pair<uint32_t, int>;  // (distance, node)
+  using MinQueue = std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>>;
+
+  // Distances from one source, reset in O(touched) between searches.
+  struct Search {
+    explicit Search(int n) : distance(n, kInfinity), parent(n, kNone) {}
+
+    void Set(int node, uint32_t d, int from) {
+      if (distance[node] == kInfinity) {
+        touched.push_back(node);
+      }
+      distance[node] = d;
+      parent[node] = from;
+    }
+
+    void Reset() {
+      for (int node : touched) {
+        distance[node] = kInfinity;
+        parent[node] = kNone;
+      }
+      touched.clear();
+      queue = MinQueue();
+    }
+
+    std::vector<uint32_t> distance;
+    std::vector<int> parent;
+    std::vector<int> touched;
+    MinQueue queue;
+  };
+
+  /*
+    Contracts nodes in order of edge difference (shortcuts added minus arcs removed, plus the
+    number of already contracted neighbors to spread contraction evenly), with lazy updates.
+  */
+  void Contract(std::vector<std::vector<Arc>>& graph) {
+    int n = static_cast<int>(graph.size());
+    std::vector<bool> contracted(n, false);
+    std::vector<int> contracted_neighbors(n, 0);
+    Search witness(n);
+    std::vector<std::pair<int, Arc>> shortcuts;
+
+    auto priority = [&](int node) {
+      FindShortcuts(graph, contracted, node, witness, shortcuts);
+      int degree = 0;
+      for (const Arc& arc : graph[node]) {
+        degree += contracted[arc.to] ? 0 : 1;
+      }
+      return static_cast<int>(shortcuts.size()) - degree + contracted_neighbors[node];
+    };
+
+    using Candidate = std::pair<int, int>;  // (priority, node)
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> order;
+    for (int node = 0; node < n; ++node) {
+      order.push({priority(node), node});
+    }
+
+    up_.assign(n, {});
+    int rank = 0;
+    rank_.assign(n, 0);
+    while (!order.empty()) {
+      int node = order.top().second;
+      order.pop();
+      int current = priority(node);  // Neighbors may have changed since it was queued
+      if (!order.empty() && current > order.top().first) {
+        order.push({current, node});
+        continue;
+      }
+
+      // `shortcuts` now holds the shortcuts for `node`, computed by priority(node).
+      for (const auto& [from, arc] : shortcuts) {
+        AddOrShorten(graph[from], arc);
+        AddOrShorten(graph[arc.to], {from, arc.length, arc.middle});
+      }
+      for (const Arc& arc : graph[node]) {
+        if (!contracted[arc.to]) {
+          up_[node].push_back(arc);
+          contracted_neighbors[arc.to]++;
+        }
+      }
+      contracted[node] = true;
+      rank_[node] = rank++;
+      graph[node].clear();
+      graph[node].shrink_to_fit();
+    }
+  }
+
+  // Shortcuts needed between the uncontracted neighbors of `node` if it is contracted.
+  void FindShortcuts(const std::vector<std::vector<Arc>>& graph,
+                     const std::vector<bool>& contracted, int node, Search& witness,
+                     std::vector<std::pair<int, Arc>>& shortcuts) {
+    shortcuts.clear();
+    const auto& arcs = graph[node];
+    for (size_t i = 0; i < arcs.size(); ++i) {
+      if (contracted[arcs[i].to]) {
+        continue;
+      }
+      uint32_t max_length = 0;
+      for (size_t j = i + 1; j < arcs.size(); ++j) {
+        max_length = std::max(max_length, arcs[i].length + arcs[j].length);
+      }
+      if (max_length == 0) {
+        continue;
+      }
+
+      // Shortest paths from arcs[i].to that avoid `node`, up to max_length.
+      int source = arcs[i].to;
+      witness.Set(source, 0, kNone);
+      witness.queue.push({0, source});
+      int settled = 0;
+      while (!witness.queue.empty() && settled < kWitnessSettleLimit) {
+        auto [d, current] = witness.queue.top();
+        witness.queue.pop();
+        if (d > witness.distance[current]) {
+          continue;
+        }
+        if (d > max_length) {
+          break;
+        }
+        settled++;
+        for (const Arc& arc : graph[current]) {
+          if (arc.to == node || contracted[arc.to]) {
+            continue;
+          }
+          uint32_t next = d + arc.length;
+          if (next < witness.distance[arc.to]) {
+            witness.Set(arc.to, next, current);
+            witness.queue.push({next, arc.to});
+          }
+        }
+      }
+
+      for (size_t j = i + 1; j < arcs.size(); ++j) {
+        if (contracted[arcs[j].to] || arcs[j].to == source) {
+          continue;
+        }
+        uint32_t via_node = arcs[i].length + arcs[j].length;
+        if (witness.distance[arcs[j].to] > via_node) {
+          shortcuts.push_back({source, {arcs[j].to, via_node, node}});
+        }
+      }
+      witness.Reset();
+    }
+  }
+
+  void AddOrShorten(std::vector<Arc>& arcs, const Arc& arc) {
+    for (Arc& existing : arcs) {
+      if (existing.to == arc.to) {
+        if (arc.length < existing.length) {
+          existing = arc;
+        }
+        return;
+      }
+    }
+    arcs.push_back(arc);
+    if (arc.middle != kNone) {
+      num_shortcuts_++;
+    }
+  }
+
+  // Bidirectional upward search. Both directions use up_, since routes are two-way.
+  std::vector<int> Query(int from, int to) const {
+    int n = static_cast<int>(names_.size());
+    thread_local std::unique_ptr<Search> forward;
+    thread_local std::unique_ptr<Search> backward;
+    if (!forward || static_cast<int>(forward->distance.size()) != n) {
+      forward = std::make_unique<Search>(n);
+      backward = std::make_unique<Search>(n);
+    }
+
+    forward->Set(from, 0, kNone);
+    forward->queue.push({0, from});
+    backward->Set(to, 0, kNone);
+    backward->queue.push({0, to});
+
+    uint32_t best = kInfinity;
+    int meeting = kNone;
+    int settled = 0;
+    auto step = [&](Search& search, const Search& other) {
+      auto [d, current] = search.queue.top();
+      search.queue.pop();
+      if (d > search.distance[current]) {
+        return;
+      }
+      settled++;
+      if (other.distance[current] != kInfinity && d + other.distance[current] < best) {
+        best = d + other.distance[current];
+        meeting = current;
+      }
+      for (const Arc& arc : up_[current]) {
+        uint32_t next = d + arc.length;
+        if (next < search.distance[arc.to]) {
+          search.Set(arc.to, next, current);
+          search.queue.push({next, arc.to});
+        }
+      }
+    };
+
+    // A direction can stop once its smallest distance reaches the best route found so far.
+    while (true) {
+      bool forward_open = !forward->queue.empty() && forward->queue.top().first < best;
+      bool backward_open = !backward->queue.empty() && backward->queue.top().first < best;
+      if (!forward_open && !backward_open) {
+        break;
+      }
+      if (forward_open) {
+        step(*forward, *backward);
+      }
+      if (backward_open) {
+        step(*backward, *forward);
+      }
+    }
+    last_settled_.store(settled, std::memory_order_relaxed);
+
+    std::vector<int> stops;
+    if (meeting != kNone) {
+      std::vector<int> up_path;  // from .. meeting
+      for (int at = meeting; at != kNone; at = forward->parent[at]) {
+        up_path.push_back(at);
+      }
+      std::reverse(up_path.begin(), up_path.end());
+      stops.push_back(from);
+      for (size_t i = 1; i < up_path.size(); ++i) {
+        Unpack(up_path[i - 1], up_path[i], stops);
+      }
+      for (int at = meeting; backward->parent[at] != kNone; at = backward->parent[at]) {
+        Unpack(at, backward->parent[at], stops);
+      }
+    }
+    forward->Reset();
+    backward->Reset();
+    return stops;
+  }
+
+  // Appends the original stops after `a` up to and including `b`.
+  void Unpack(int a, int b, std::vector<int>& stops) const {
+    int low = rank_[a] < rank_[b] ? a : b;
+    int high = low == a ? b : a;
+    for (const Arc& arc : up_[low]) {
+      if (arc.to == high) {
+        if (arc.middle == kNone) {
+          stops.push_back(b);
+        } else {
+          Unpack(a, arc.middle, stops);
+          Unpack(arc.middle, b, stops);
+        }
+        return;
+      }
+    }
+    assert(false && "Arc on a hierarchy path must exist");
+  }
+
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, int> ids_;
+  std::vector<int> rank_;
+  std::vector<std::vector<Arc>> up_;  // Arcs to higher-ranked nodes
+  size_t num_shortcuts_ = 0;
+  mutable std::atomic<int> last_settled_{0};  // Navigators may be shared between threads
+};
+
+class NavigatorStrategy {
+ public:
+  NavigatorStrategy() : id_(NextId()) {}
+
+  // A copy may later answer differently from the original, so it gets an id of its own.
+  NavigatorStrategy(const NavigatorStrategy&) : id_(NextId()) {}
+
+  NavigatorStrategy& operator=(const NavigatorStrategy&) {
+    id_ = NextId();
+    return *this;
+  }
+
+  virtual ~NavigatorStrategy() = default;
+
+  // Never 0, and never shared with another strategy, even one at the same address.
+  uint64_t id() const {
+    return id_;
+  }
+  virtual std::pair<bool, std::vector<std::string>> Navigate(const Map& map, std::string from,
+                                                             std::string to) const = 0;
+
+  static std::vector<std::string> FindShortestPath(const AdjacencyList& adjacency_list,
+                                                   std::string from, std::string to) {
+    std::map<std::string, std::string> visited;  // also store visited from where
+
+    std::queue<std::string> queue;
+    queue.push(from);
+    visited.insert({from, ""});
+
+    bool found = false;
+    while (!queue.empty()) {
+      std::string current = queue.front();
+      queue.pop();
+
+      if (current == to) {
+        found = true;
+        break;
+      }
+
+      auto neighbors = adjacency_list.find(current);
+      if (neighbors == adjacency_list.end()) {
+        continue;
+      }
+      for (const auto& neighbor : neighbors->second) {
+        if (visited.find(neighbor) == visited.end()) {
+          visited.insert({neighbor, current});
+          queue.push(neighbor);
+        }
+      }
+    }
+
+    if (!found) {
+      return {};  // Return empty vector if destination is not reachable
+    }
+    std::vector<std::string> route;
+
+    // Backtrack to find the route
+    for (std::string at = to; !at.empty(); at = visited[at]) {
+      route.push_back(at);
+    }
+    std::reverse(route.begin(), route.end());
+    return route;
+  }
+
+ private:
+  static uint64_t NextId() {
+    static std::atomic<uint64_t> next_id(1);
+    return next_id.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  uint64_t id_;
+};
+
+class WalkNavigator : public NavigatorStrategy {
+ public:
+  std::pair<bool, std::vector<std::string>> Navigate(const Map& map, std::string from,
+                                                     std::string to) const override {
+    std::vector<std::string> route = FindShortestPath(map.GetWalkAdjList(), from, to);
+    return {route.empty() == false, route};
+  }
+};
+
+class DriveNavigator : public NavigatorStrategy {
+ public:
+  std::pair<bool, std::vector<std::string>> Navigate(const Map& map, std::string from,
+                                                     std::string to) const override {
+    std::vector<std::string> route = FindShortestPath(map.GetDriveAdjList(), from, to);
+    return {route.empty() == false, route};
+  }
+};
+
+/*
+  Answers queries from a ContractionHierarchy built for one map version.
+*/
+class PrecomputedNavigator : public NavigatorStrategy {
+ public:
+  enum class Mode { kWalk, kDrive };
+
+  PrecomputedNavigator(const Map& map, Mode mode) : mode_(mode) {
+    Rebuild(map);
+  }
+
+  void Rebuild(const Map& map) {
+    version_ = map.version();
+    hierarchy_ = std::make_unique<ContractionHierarchy>(GetAdjList(map));
+  }
+
+  std::pair<bool, std::vector<std::string>> Navigate(const Map& map, std::string from,
+                                                     std::string to) const override {
+    std::vector<std::string> route =
+        is_current(map) ? hierarchy_->FindShortestPath(from, to)
+                        : FindShortestPath(GetAdjList(map), from, to);  // Stale hierarchy
+    return {route.empty() == false, route};
+  }
+
+  bool is_current(const Map& map) const {
+    return map.version() == version_;
+  }
+
+  const ContractionHierarchy& hierarchy() const {
+    return *hierarchy_;
+  }
+
+ private:
+  const AdjacencyList& GetAdjList(const Map& map) const {
+    return mode_ == Mode::kWalk ? map.GetWalkAdjList() : map.GetDriveAdjList();
+  }
+
+  Mode mode_;
+  uint64_t version_;  // Version of the map the hierarchy was built from
+  std::unique_ptr<ContractionHierarchy> hierarchy_;
+};
+
+using RouteResult = std::pair<bool, std::vector<std::string>>;
+
+/*
+  Least recently used cache of routes keyed by (strategy id, from, to).
+*/
+class RouteCache {
+ public:
+  explicit RouteCache(size_t capacity) : capacity_(capacity) {}
+
+  // nullptr on a miss. The pointer is valid until the next Put or Clear.
+  const RouteResult* Get(const NavigatorStrategy* strategy, const std::string& from,
+                         const std::string& to) {
+    auto it = index_.find(Key{strategy->id(), from, to});
+    if (it == index_.end()) {
+      misses_++;
+      return nullptr;
+    }
+    hits_++;
+    entries_.splice(entries_.begin(), entries_, it->second);  // Most recently used first
+    return &it->second->second;
+  }
+
+  void Put(const NavigatorStrategy* strategy, const std::string& from, const std::string& to,
+           RouteResult route) {
+    if (capacity_ == 0) {
+      return;
+    }
+    Key key{strategy->id(), from, to};
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      it->second->second = std::move(route);
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+    if (entries_.size() == capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+    entries_.emplace_front(std::move(key), std::move(route));
+    index_.emplace(entries_.front().first, entries_.begin());
+  }
+
+  void Clear() {
+    index_.clear();
+    entries_.clear();
+  }
+
+  size_t hits() const {
+    return hits_;
+  }
+
+  size_t misses() const {
+    return misses_;
+  }
+
+ private:
+  struct Key {
+    uint64_t strategy_id;  // Not the address, which a new strategy may reuse
+    std::string from;
+    std::string to;
+
+    bool operator==(const Key& other) const {
+      return strategy_id == other.strategy_id && from == other.from && to == other.to;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key& key) const {
+      size_t hash = std::hash<uint64_t>()(key.strategy_id);
+      hash = hash * 31 + std::hash<std::string>()(key.from);
+      return hash * 31 + std::hash<std::string>()(key.to);
+    }
+  };
+
+  size_t capacity_;
+  std::list<std::pair<Key, RouteResult>> entries_;
+  std::unordered_map<Key, std::list<std::pair<Key, RouteResult>>::iterator, KeyHash> index_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
+
+class Traveler {
+ public:
+  explicit Traveler(size_t cache_capacity = 1024) :
+      strategy_(nullptr), cache_(cache_capacity), cached_version_(0) {}
+
+  void set_strategy(NavigatorStrategy* strategy) {
+    strategy_ = strategy;
+  }
+
+  std::pair<bool, std::vector<std::string>> Navigate(const Map& map, std::string from,
+                                                     std::string to,
+                                                     std::string stopover = std::string()) {
+    assert(strategy_ != nullptr && "Strategy must be set before navigating");
+    if (map.version() != cached_version_) {
+      cache_.Clear();  // Routes were found on another map or an older version of it
+      cached_version_ = map.version();
+    }
+
+    std::vector<std::string> complete_route;
+    if (stopover.empty()) {
+      auto [found, route] = NavigateCached(map, from, to);
+      if (found) {
+        complete_route = route;
+      }
+    } else {
+      auto [found1, route1] = NavigateCached(map, from, stopover);
+      auto [found2, route2] = NavigateCached(map, stopover, to);
+
+      if (found1 && found2) {
+        complete_route = route1;
+        complete_route.insert(complete_route.end(), route2.begin(), route2.end());
+      }
+    }
+
+    return {complete_route.empty() == false, complete_route};
+  }
+
+  const RouteCache& cache() const {
+    return cache_;
+  }
+
+ private:
+  RouteResult NavigateCached(const Map& map, const std::string& from, const std::string& to) {
+    if (const RouteResult* cached = cache_.Get(strategy_, from, to)) {
+      return *cached;
+    }
+    RouteResult route = strategy_->Navigate(map, from, to);
+    cache_.Put(strategy_, from, to, route);
+    return route;
+  }
+
+  NavigatorStrategy* strategy_;  // Strategy for navigation
+  RouteCache cache_;
+  uint64_t cached_version_;  // Map version that the cached routes belong to
+};
+
+void PrintRoute(const std::string& label, const RouteResult& result) {
+  if (!result.first) {
+    std::cout << "No " << label << " found.\n";
+    return;
+  }
+  std::cout << label << ": ";
+  for (const auto& stop : result.second) {
+    std::cout << stop << " ";
+  }
+  std::cout << "\n";
+}
+
+int main() {
+  {
+    // Same map as part1.
+    Map map;
+    map.AddWalkRoute("A", "B");
+    map.AddWalkRoute("A", "D");
+    map.AddWalkRoute("B", "C");
+    map.AddWalkRoute("C", "E");
+    map.AddWalkRoute("D", "E");
+    map.AddWalkRoute("F", "G");
+    map.AddWalkRoute("F", "H");
+
+    map.AddDriveRoute("A", "B");
+    map.AddDriveRoute("B", "C");
+    map.AddDriveRoute("C", "H");
+    map.AddDriveRoute("A", "D");
+    map.AddDriveRoute("D", "E");
+    map.AddDriveRoute("F", "G");
+    map.AddDriveRoute("F", "H");
+
+    Traveler traveler;
+    PrecomputedNavigator walk_navigator(map, PrecomputedNavigator::Mode::kWalk);
+    PrecomputedNavigator drive_navigator(map, PrecomputedNavigator::Mode::kDrive);
+
+    traveler.set_strategy(&walk_navigator);
+    PrintRoute("Walk route from A to E", traveler.Navigate(map, "A", "E"));
+    PrintRoute("walk route from A to G", traveler.Navigate(map, "A", "G"));
+
+    traveler.set_strategy(&drive_navigator);
+    PrintRoute("Drive route from A to G", traveler.Navigate(map, "A", "G"));
+    PrintRoute("Drive route from A to G", traveler.Navigate(map, "A", "G"));
+    std::cout << "Cache hits = " << traveler.cache().hits()
+              << ", misses = " << traveler.cache().misses() << "\n";
+
+    // A new route invalidates the cache, and the hierarchy until it is rebuilt.
+    map.AddDriveRoute("A", "G");
+    PrintRoute("Drive route from A to G after adding A-G", traveler.Navigate(map, "A", "G"));
+    std::cout << "Hierarchy current = " << drive_navigator.is_current(map) << "\n";
+    drive_navigator.Rebuild(map);
+    std::cout << "Hierarchy current after Rebuild = " << drive_navigator.is_current(map) << "\n";
+  }
+
+  std::cout << "----------------------------------\n";
+
+  // A side x side grid of streets with some streets missing, as in a real city.
+  const int kSide = 120;
+  const int kDistinctQueries = 200;
+  const int kQueries = 20000;
+  Map map;
+  std::mt19937 rng(7);
+  std::bernoulli_distribution keep(0.85);
+  auto name = [](int r, int c) { return "r" + std::to_string(r) + "c" + std::to_string(c); };
+  for (int r = 0; r < kSide; ++r) {
+    for (int c = 0; c < kSide; ++c) {
+      if (c + 1 < kSide && (r % 10 == 0 || keep(rng))) {
+        map.AddDriveRoute(name(r, c), name(r, c + 1));
+      }
+      if (r + 1 < kSide && (c % 10 == 0 || keep(rng))) {
+        map.AddDriveRoute(name(r, c), name(r + 1, c));
+      }
+    }
+  }
+
+  auto build_start = std::chrono::high_resolution_clock::now();
+  PrecomputedNavigator precomputed(map, PrecomputedNavigator::Mode::kDrive);
+  auto build_end = std::chrono::high_resolution_clock::now();
+  std::cout << "Contracted " << map.GetDriveAdjList().size() << " locations in "
+            << std::chrono::duration<double>(build_end - build_start).count() << " s, "
+            << precomputed.hierarchy().num_shortcuts() << " shortcuts\n";
+
+  // Popular pairs are asked much more often than others.
+  std::uniform_int_distribution<int> coordinate(0, kSide - 1);
+  std::vector<std::pair<std::string, std::string>> distinct_queries;
+  for (int i = 0; i < kDistinctQueries; ++i) {
+    distinct_queries.push_back({name(coordinate(rng), coordinate(rng)),
+                                name(coordinate(rng), coordinate(rng))});
+  }
+  std::vector<double> weights;
+  for (int i = 0; i < kDistinctQueries; ++i) {
+    weights.push_back(1.0 / (i + 1));
+  }
+  std::discrete_distribution<int> popularity(weights.begin(), weights.end());
+  std::vector<int> queries;
+  for (int i = 0; i < kQueries; ++i) {
+    queries.push_back(popularity(rng));
+  }
+
+  DriveNavigator bfs;
+  auto run = [&](const char* label, NavigatorStrategy& strategy, size_t cache_capacity,
+                 int num_queries) {
+    Traveler traveler(cache_capacity);
+    traveler.set_strategy(&strategy);
+    size_t stops = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < num_queries; ++i) {
+      const auto& [from, to] = distinct_queries[queries[i]];
+      stops += traveler.Navigate(map, from, to).second.size();
+    }
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::micro> duration = end_time - start_time;
+    std::cout << label << " | " << duration.count() / num_queries << " us/query, "
+              << "stops/query = " << static_cast<double>(stops) / num_queries
+              << ", cache hits = " << traveler.cache().hits() << "/" << num_queries << "\n";
+  };
+
+  // BFS is slow, so it answers fewer queries; stops/query must still match.
+  run("BFS                     ", bfs, 0, 500);
+  run("Contraction hierarchy   ", precomputed, 0, 500);
+  run("Contraction hierarchy   ", precomputed, 0, kQueries);
+  run("Hierarchy + cache of 64 ", precomputed, 64, kQueries);
+  return 0;
+}
@@ -0,0 +1,689 @@
+/*
+  Strategy with batched, parallel queries.
+
+  In part1, every Navigate call runs alone on the calling thread, and every BFS allocates its own
+  visited map and queue. A service answering thousands of queries per second wants to use all
+  cores and reuse memory.
+
+  Building on the compact map of part3 (CSR graphs with integer ids):
+  - A strategy only picks the graph (walk or drive); the search itself takes a SearchScratch
+    (visited bitset, parent array, queue) that the caller owns and reuses across queries.
+  - NavigatorPool runs a fixed set of worker threads, each with its own SearchScratch.
+    NavigateBatch hands out the queries of a batch to the workers and returns the routes in the
+    order of the queries.
+  - DistanceBatch answers queries that only need the number of hops with a bit-parallel
+    multi-source BFS: up to 64 sources are searched in one traversal, with one bit per source in
+    a 64-bit mask per location, so one pass over the graph serves up to 64 queries.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class CompactMap;
+
+class Map {
+ public:
+  void AddWalkRoute(std::string x, std::string y) {
+    walk_adjacency_list_[x].insert(y);
+    walk_adjacency_list_[y].insert(x);
+  }
+
+  void AddDriveRoute(std::string x, std::string y) {
+    drive_adjacency_list_[x].insert(y);
+    drive_adjacency_list_[y].insert(x);
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetWalkAdjList() const {
+    return walk_adjacency_list_;
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetDriveAdjList() const {
+    return drive_adjacency_list_;
+  }
+
+  // Compiles the current routes into a read-only CompactMap.
+  CompactMap Freeze() const;
+
+ private:
+  std::map<std::string, std::set<std::string>>
+      walk_adjacency_list_;  // Adjacency list representation of the map
+  std::map<std::string, std::set<std::string>>
+      drive_adjacency_list_;  // Adjacency list for driving routes
+};
+
+using NodeId = uint32_t;
+constexpr NodeId kInvalidNode = ~NodeId(0);
+
+class CsrGraph {
+ public:
+  CsrGraph() : offsets_(1, 0) {}
+
+  CsrGraph(const std::map<std::string, std::set<std::string>>& adjacency_list,
+           const std::unordered_map<std::string, NodeId>& ids, size_t num_nodes) :
+      offsets_(num_nodes + 1, 0) {
+    for (const auto& [name, neighbors] : adjacency_list) {
+      offsets_[ids.at(name) + 1] = static_cast<uint32_t>(neighbors.size());
+    }
+    for (size_t i = 0; i < num_nodes; ++i) {
+      offsets_[i + 1] += offsets_[i];
+    }
+    targets_.resize(offsets_.back());
+    for (const auto& [name, neighbors] : adjacency_list) {
+      NodeId* out = targets_.data() + offsets_[ids.at(name)];
+      for (const auto& neighbor : neighbors) {
+        *out++ = ids.at(neighbor);
+      }
+    }
+  }
+
+  const NodeId* begin(NodeId node) const {
+    return targets_.data() + offsets_[node];
+  }
+
+  const NodeId* end(NodeId node) const {
+    return targets_.data() + offsets_[node + 1];
+  }
+
+  size_t num_nodes() const {
+    return offsets_.size() - 1;
+  }
+
+ private:
+  std::vector<uint32_t> offsets_;  // num_nodes + 1 entries
+  std::vector<NodeId> targets_;
+};
+
+class CompactMap {
+ public:
+  explicit CompactMap(const Map& map) {
+    std::set<std::string> names;
+    for (const auto& [name, neighbors] : map.GetWalkAdjList()) {
+      names.insert(name);
+    }
+    for (const auto& [name, neighbors] : map.GetDriveAdjList()) {
+      names.insert(name);
+    }
+    names_.assign(names.begin(), names.end());
+    for (NodeId id = 0; id < names_.size(); ++id) {
+      ids_.emplace(names_[id], id);
+    }
+    walk_graph_ = CsrGraph(map.GetWalkAdjList(), ids_, names_.size());
+    drive_graph_ = CsrGraph(map.GetDriveAdjList(), ids_, names_.size());
+  }
+
+  // kInvalidNode if the location is not on the map.
+  NodeId id(const std::string& name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? kInvalidNode : it->second;
+  }
+
+  const std::string& name(NodeId id) const {
+    return names_[id];
+  }
+
+  size_t size() const {
+    return names_.size();
+  }
+
+  const CsrGraph& GetWalkGraph() const {
+    return walk_graph_;
+  }
+
+  const CsrGraph& GetDriveGraph() const {
+    return drive_graph_;
+  }
+
+ private:
+  std::vector<std::string> names_;  // Indexed by id
+  std::unordered_map<std::string, NodeId> ids_;
+  CsrGraph walk_graph_;
+  CsrGraph drive_graph_;
+};
+
+CompactMap Map::Freeze() const {
+  return CompactMap(*this);
+}
+
+/*
+  Memory for one BFS at a time. Not thread-safe: every thread needs its own.
+*/
+class SearchScratch {
+ public:
+  void Prepare(size_t num_nodes) {
+    if (parent.size() != num_nodes) {
+      visited.assign((num_nodes + 63) / 64, 0);
+      parent.resize(num_nodes);
+      queue.resize(num_nodes);
+    } else {
+      std::fill(visited.begin(), visited.end(), 0);
+    }
+  }
+
+  bool IsVisited(NodeId node) const {
+    return (visited[node / 64] >> (node % 64)) & 1;
+  }
+
+  void Visit(NodeId node) {
+    visited[node / 64] |= uint64_t(1) << (node % 64);
+  }
+
+  std::vector<uint64_t> visited;  // Bitset, 1 bit per node
+  std::vector<NodeId> parent;     // Only valid for visited nodes
+  std::vector<NodeId> queue;
+};
+
+using RouteResult = std::pair<bool, std::vector<std::string>>;
+
+class NavigatorStrategy {
+ public:
+  virtual ~NavigatorStrategy() = default;
+
+  // The routes this strategy travels on.
+  virtual const CsrGraph& GetGraph(const CompactMap& map) const = 0;
+
+  RouteResult Navigate(const CompactMap& map, const std::string& from, const std::string& to,
+                       SearchScratch& scratch) const {
+    NodeId from_id = map.id(from);
+    NodeId to_id = map.id(to);
+    if (from_id == kInvalidNode || to_id == kInvalidNode) {
+      return {false, {}};
+    }
+    std::vector<std::string> route;
+    for (NodeId id : FindShortestPath(GetGraph(map), from_id, to_id, scratch)) {
+      route.push_back(map.name(id));
+    }
+    return {route.empty() == false, route};
+  }
+
+  static std::vector<NodeId> FindShortestPath(const CsrGraph& graph, NodeId from, NodeId to,
+                                              SearchScratch& scratch) {
+    scratch.Prepare(graph.num_nodes());
+
+    size_t head = 0;
+    size_t tail = 0;
+    scratch.queue[tail++] = from;
+    scratch.Visit(from);
+    scratch.parent[from] = kInvalidNode;
+
+    bool found = false;
+    while (head < tail) {
+      NodeId current = scratch.queue[head++];
+      if (current == to) {
+        found = true;
+        break;
+      }
+      for (const NodeId* it = graph.begin(current); it != graph.end(current); ++it) {
+        if (!scratch.IsVisited(*it)) {
+          scratch.Visit(*it);
+          scratch.parent[*it] = current;
+          scratch.queue[tail++] = *it;
+        }
+      }
+    }
+
+    if (!found) {
+      return {};
+    }
+    std::vector<NodeId> route;
+    for (NodeId at = to; at != kInvalidNode; at = scratch.parent[at]) {
+      route.push_back(at);
+    }
+    std::reverse(route.begin(), route.end());
+    return route;
+  }
+};
+
+class WalkNavigator : public NavigatorStrategy {
+ public:
+  const CsrGraph& GetGraph(const CompactMap& map) const override {
+    return map.GetWalkGraph();
+  }
+};
+
+class DriveNavigator : public NavigatorStrategy {
+ public:
+  const CsrGraph& GetGraph(const CompactMap& map) const override {
+    return map.GetDriveGraph();
+  }
+};
+
+/*
+  Bit-parallel BFS from up to 64 sources at once (multi-source BFS).
+  Bit i of a location's mask stands for sources[i]. `seen` has the sources that reached the
+  location so far, `frontier` the ones that reached it in the last level.
+  The arrays are sized once per graph; each call resets only the locations the previous one
+  touched.
+*/
+class MultiSourceBfs {
+ public:
+  static constexpr size_t kMaxSources = 64;
+
+  // Number of hops from sources[i] to targets[i] for every i, or -1 if unreachable.
+  // Pairs may repeat sources; throws std::invalid_argument if more than kMaxSources are distinct.
+  std::vector<int> Distances(const CsrGraph& graph, const std::vector<NodeId>& sources,
+                             const std::vector<NodeId>& targets) {
+    Reset(graph.num_nodes());
+
+    std::vector<int> distances(sources.size(), -1);
+    std::unordered_map<NodeId, int> bit_of_source;
+    size_t unanswered = 0;
+    for (size_t i = 0; i < sources.size(); ++i) {
+      int next_bit = static_cast<int>(bit_of_source.size());
+      auto [it, inserted] = bit_of_source.insert({sources[i], next_bit});
+      if (bit_of_source.size() > kMaxSources) {
+        throw std::invalid_argument("Too many distinct sources for one multi-source BFS");
+      }
+      if (inserted) {
+        uint64_t bit = uint64_t(1) << it->second;
+        seen_[sources[i]] |= bit;
+        frontier_[sources[i]] |= bit;
+        touched_.push_back(sources[i]);
+      }
+      if (sources[i] == targets[i]) {
+        distances[i] = 0;
+      } else {
+        pending_[targets[i]].push_back({it->second, i});
+        touched_.push_back(targets[i]);
+        unanswered++;
+      }
+    }
+
+    std::vector<NodeId>& active = active_;  // Locations with a non-empty frontier mask
+    std::vector<NodeId>& next_active = next_active_;
+    for (const auto& [source, bit] : bit_of_source) {
+      active.push_back(source);
+    }
+
+    for (int level = 1; !active.empty() && unanswered > 0; ++level) {
+      for (NodeId node : active) {
+        uint64_t mask = frontier_[node];
+        frontier_[node] = 0;
+        for (const NodeId* it = graph.begin(node); it != graph.end(node); ++it) {
+          uint64_t discovered = mask & ~seen_[*it];
+          if (discovered == 0) {
+            continue;
+          }
+          if (next_[*it] == 0) {
+            next_active.push_back(*it);
+          }
+          if (seen_[*it] == 0) {
+            touched_.push_back(*it);
+          }
+          next_[*it] |= discovered;
+          seen_[*it] |= discovered;
+          for (const auto& [bit, query] : pending_[*it]) {
+            if ((discovered >> bit) & 1) {
+              distances[query] = level;
+              unanswered--;
+            }
+          }
+        }
+      }
+      for (NodeId node : next_active) {
+        frontier_[node] = next_[node];
+        next_[node] = 0;
+      }
+      active.swap(next_active);
+      next_active.clear();
+    }
+    return distances;
+  }
+
+ private:
+  // Clears what the previous call left behind, which may have stopped early or thrown.
+  void Reset(size_t num_nodes) {
+    if (seen_.size() != num_nodes) {
+      seen_.assign(num_nodes, 0);
+      frontier_.assign(num_nodes, 0);
+      next_.assign(num_nodes, 0);
+      pending_.assign(num_nodes, {});
+    } else {
+      for (NodeId node : touched_) {
+        seen_[node] = 0;
+        frontier_[node] = 0;
+        next_[node] = 0;
+        pending_[node].clear();
+      }
+    }
+    touched_.clear();
+    active_.clear();
+    next_active_.clear();
+  }
+
+  std::vector<uint64_t> seen_;
+  std::vector<uint64_t> frontier_;
+  std::vector<uint64_t> next_;
+  std::vector<std::vector<std::pair<int, size_t>>> pending_;  // (source bit, query) per target
+  std::vector<NodeId> touched_;  // Locations with any of the above set, possibly repeated
+  std::vector<NodeId> active_;
+  std::vector<NodeId> next_active_;
+};
+
+/*
+  Fixed set of worker threads, each with its own scratch memory. A pool without workers runs
+  each batch on the calling thread.
+  A pool runs one batch at a time: NavigateBatch and DistanceBatch must not be called from two
+  threads at once.
+*/
+class NavigatorPool {
+ public:
+  using Query = std::pair<std::string, std::string>;  // (from, to)
+
+  explicit NavigatorPool(size_t num_threads) :
+      generation_(0), count_(0), remaining_(0), stopping_(false) {
+    for (size_t i = 0; i < num_threads; ++i) {
+      workers_.emplace_back(&NavigatorPool::Run, this);
+    }
+  }
+
+  ~NavigatorPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    start_.notify_all();
+    for (auto& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  std::vector<RouteResult> NavigateBatch(const NavigatorStrategy& strategy, const CompactMap& map,
+                                         const std::vector<Query>& queries) {
+    std::vector<RouteResult> results(queries.size());
+    RunBatch(queries.size(), [&](size_t i, WorkerScratch& scratch) {
+      results[i] = strategy.Navigate(map, queries[i].first, queries[i].second, scratch.search);
+    });
+    return results;
+  }
+
+  // Number of hops for every query, or -1 if unreachable. Queries are grouped so that each
+  // multi-source BFS has at most 64 distinct sources.
+  std::vector<int> DistanceBatch(const NavigatorStrategy& strategy, const CompactMap& map,
+                                 const std::vector<Query>& queries) {
+    std::vector<size_t> order(queries.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    std::vector<NodeId> from_ids(queries.size());
+    std::vector<NodeId> to_ids(queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+      from_ids[i] = map.id(queries[i].first);
+      to_ids[i] = map.id(queries[i].second);
+    }
+    std::sort(order.begin(), order.end(),
+              [&](size_t a, size_t b) { return from_ids[a] < from_ids[b]; });
+
+    // Split into chunks of at most 64 distinct sources.
+    std::vector<std::pair<size_t, size_t>> chunks;  // [begin, end) in `order`
+    size_t begin = 0;
+    size_t distinct = 0;
+    NodeId last_source = kInvalidNode;  // Last source counted in `distinct`
+    for (size_t i = 0; i < order.size(); ++i) {
+      if (from_ids[order[i]] == kInvalidNode || to_ids[order[i]] == kInvalidNode) {
+        continue;  // Answered as unreachable below
+      }
+      if (from_ids[order[i]] != last_source) {
+        if (distinct == MultiSourceBfs::kMaxSources) {
+          chunks.push_back({begin, i});
+          begin = i;
+          distinct = 0;
+        }
+        distinct++;
+        last_source = from_ids[order[i]];
+      }
+    }
+    if (begin < order.size()) {
+      chunks.push_back({begin, order.size()});
+    }
+
+    std::vector<int> distances(queries.size(), -1);
+    const CsrGraph& graph = strategy.GetGraph(map);
+    RunBatch(chunks.size(), [&](size_t c, WorkerScratch& scratch) {
+      std::vector<NodeId> sources;
+      std::vector<NodeId> targets;
+      std::vector<size_t> indices;
+      for (size_t k = chunks[c].first; k < chunks[c].second; ++k) {
+        size_t i = order[k];
+        if (from_ids[i] != kInvalidNode && to_ids[i] != kInvalidNode) {
+          sources.push_back(from_ids[i]);
+          targets.push_back(to_ids[i]);
+          indices.push_back(i);
+        }
+      }
+      std::vector<int> chunk_distances = scratch.multi_source.Distances(graph, sources, targets);
+      for (size_t k = 0; k < indices.size(); ++k) {
+        distances[indices[k]] = chunk_distances[k];
+      }
+    });
+    return distances;
+  }
+
+  size_t size() const {
+    return workers_.size();
+  }
+
+ private:
+  struct WorkerScratch {
+    SearchScratch search;
+    MultiSourceBfs multi_source;
+  };
+
+  // Calls work(i, scratch) for every i in [0, count) on the workers and waits for all of them.
+  // Not reentrant: the pool has one set of batch state.
+  void RunBatch(size_t count, std::function<void(size_t, WorkerScratch&)> work) {
+    if (workers_.empty()) {
+      for (size_t i = 0; i < count; ++i) {
+        work(i, caller_scratch_);
+      }
+      return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_ = std::move(work);
+    count_ = count;
+    next_ = 0;
+    remaining_ = workers_.size();
+    generation_++;
+    start_.notify_all();
+    done_.wait(lock, [this]() { return remaining_ == 0; });
+  }
+
+  void Run() {
+    WorkerScratch scratch;
+    uint64_t seen_generation = 0;
+    while (true) {
+      std::function<void(size_t, WorkerScratch&)>* work;
+      size_t count;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        start_.wait(lock, [&]() { return stopping_ || generation_ != seen_generation; });
+        if (stopping_) {
+          return;
+        }
+        seen_generation = generation_;
+        work = &work_;
+        count = count_;
+      }
+
+      for (size_t i = next_.fetch_add(1); i < count; i = next_.fetch_add(1)) {
+        (*work)(i, scratch);
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--remaining_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  WorkerScratch caller_scratch_;  // Used when there are no workers
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  std::function<void(size_t, WorkerScratch&)> work_;
+  uint64_t generation_;
+  size_t count_;
+  std::atomic<size_t> next_;
+  size_t remaining_;  // Workers still busy with the current batch
+  bool stopping_;
+};
+
+class Traveler {
+ public:
+  Traveler() : strategy_(nullptr) {}
+
+  void set_strategy(NavigatorStrategy* strategy) {
+    strategy_ = strategy;
+  }
+
+  RouteResult Navigate(const CompactMap& map, std::string from, std::string to) {
+    assert(strategy_ != nullptr && "Strategy must be set before navigating");
+    return strategy_->Navigate(map, from, to, scratch_);
+  }
+
+ private:
+  NavigatorStrategy* strategy_;  // Strategy for navigation
+  SearchScratch scratch_;        // Reused by every query of this traveler
+};
+
+void PrintRoute(const std::string& label, const RouteResult& result) {
+  if (!result.first) {
+    std::cout << "No " << label << " found.\n";
+    return;
+  }
+  std::cout << label << ": ";
+  for (const auto& stop : result.second) {
+    std::cout << stop << " ";
+  }
+  std::cout << "\n";
+}
+
+// Number of hops of a route, or -1 if none was found (as in DistanceBatch).
+long long Hops(const RouteResult& result) {
+  return result.first ? static_cast<long long>(result.second.size()) - 1 : -1;
+}
+
+int main() {
+  {
+    // Same map as part1.
+    Map map;
+    map.AddWalkRoute("A", "B");
+    map.AddWalkRoute("A", "D");
+    map.AddWalkRoute("B", "C");
+    map.AddWalkRoute("C", "E");
+    map.AddWalkRoute("D", "E");
+    map.AddWalkRoute("F", "G");
+    map.AddWalkRoute("F", "H");
+
+    map.AddDriveRoute("A", "B");
+    map.AddDriveRoute("B", "C");
+    map.AddDriveRoute("C", "H");
+    map.AddDriveRoute("A", "D");
+    map.AddDriveRoute("D", "E");
+    map.AddDriveRoute("F", "G");
+    map.AddDriveRoute("F", "H");
+
+    CompactMap compact_map = map.Freeze();
+    WalkNavigator walk_navigator;
+    DriveNavigator drive_navigator;
+
+    NavigatorPool pool(2);
+    std::vector<NavigatorPool::Query> queries = {{"A", "E"}, {"A", "G"}, {"H", "D"}};
+    auto routes = pool.NavigateBatch(walk_navigator, compact_map, queries);
+    auto distances = pool.DistanceBatch(drive_navigator, compact_map, queries);
+    for (size_t i = 0; i < queries.size(); ++i) {
+      PrintRoute("walk route from " + queries[i].first + " to " + queries[i].second, routes[i]);
+      std::cout << "Drive distance from " << queries[i].first << " to " << queries[i].second
+                << ": " << distances[i] << " hops\n";
+    }
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const int kSide = 200;
+  const int kQueries = 2048;
+  Map map;
+  auto name = [](int r, int c) { return "r" + std::to_string(r) + "c" + std::to_string(c); };
+  for (int r = 0; r < kSide; ++r) {
+    for (int c = 0; c < kSide; ++c) {
+      if (c + 1 < kSide) {
+        map.AddDriveRoute(name(r, c), name(r, c + 1));
+      }
+      if (r + 1 < kSide) {
+        map.AddDriveRoute(name(r, c), name(r + 1, c));
+      }
+    }
+  }
+  CompactMap compact_map = map.Freeze();
+  DriveNavigator drive_navigator;
+
+  // Few popular origins (e.g. stations), many destinations.
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<int> coordinate(0, kSide - 1);
+  std::vector<std::string> origins;
+  for (int i = 0; i < 128; ++i) {
+    origins.push_back(name(coordinate(rng), coordinate(rng)));
+  }
+  std::uniform_int_distribution<int> origin(0, static_cast<int>(origins.size()) - 1);
+  std::vector<NavigatorPool::Query> queries;
+  for (int i = 0; i < kQueries; ++i) {
+    queries.push_back({origins[origin(rng)], name(coordinate(rng), coordinate(rng))});
+  }
+
+  auto report = [&](const std::string& label, auto run) {
+    auto start_time = std::chrono::high_resolution_clock::now();
+    long long checksum = run();
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end_time - start_time;
+    std::cout << label << " | queries/sec = " << static_cast<long long>(kQueries / duration.count())
+              << ", total hops = " << checksum << "\n";
+  };
+
+  std::cout << "Hardware threads: " << std::thread::hardware_concurrency() << "\n";
+  report("Traveler, one query at a time   ", [&]() {
+    Traveler traveler;
+    traveler.set_strategy(&drive_navigator);
+    long long hops = 0;
+    for (const auto& [from, to] : queries) {
+      hops += Hops(traveler.Navigate(compact_map, from, to));
+    }
+    return hops;
+  });
+  for (size_t threads : {0, 1, 2, 4, 8}) {  // 0: on the calling thread
+    NavigatorPool pool(threads);
+    report("NavigateBatch, " + std::to_string(threads) + " threads         ", [&]() {
+      long long hops = 0;
+      for (const auto& route : pool.NavigateBatch(drive_navigator, compact_map, queries)) {
+        hops += Hops(route);
+      }
+      return hops;
+    });
+  }
+  for (size_t threads : {0, 1, 2, 4, 8}) {  // 0: on the calling thread
+    NavigatorPool pool(threads);
+    report("DistanceBatch, " + std::to_string(threads) + " threads (MS-BFS)", [&]() {
+      long long hops = 0;
+      for (int distance : pool.DistanceBatch(drive_navigator, compact_map, queries)) {
+        hops += distance;
+      }
+      return hops;
+    });
+  }
+  return 0;
+}
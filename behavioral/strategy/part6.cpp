@@ -0,0 +1,492 @@
+/*
+  Strategy with bidirectional search and multi-stop routes.
+
+  In part1:
+  - FindShortestPath explores outward from the start only. On a large map, the number of
+    explored locations grows with the area of a circle around the start that reaches the
+    destination.
+  - Traveler::Navigate with a stopover runs two independent searches and concatenates them, so
+    the stopover appears twice in the route (e.g. "A B C C D").
+
+  Here, building on the compact map of part3:
+  - FindShortestPath searches from both ends and stops when the two searches meet. It always
+    expands the side with the smaller frontier, one whole BFS level at a time, so the first
+    meeting found within a level can be replaced by a shorter one from the same level.
+    Two circles of half the radius cover much less than one full circle.
+  - Visited marks carry a search number (epoch) instead of being cleared, so the scratch memory
+    is reused across queries and across the legs of a route without resetting it.
+  - Traveler::NavigateVia takes an ordered list of stops (start, stopovers..., destination) and
+    joins the legs without repeating the shared stops. Navigate with a stopover uses it.
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class CompactMap;
+
+class Map {
+ public:
+  void AddWalkRoute(std::string x, std::string y) {
+    walk_adjacency_list_[x].insert(y);
+    walk_adjacency_list_[y].insert(x);
+  }
+
+  void AddDriveRoute(std::string x, std::string y) {
+    drive_adjacency_list_[x].insert(y);
+    drive_adjacency_list_[y].insert(x);
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetWalkAdjList() const {
+    return walk_adjacency_list_;
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetDriveAdjList() const {
+    return drive_adjacency_list_;
+  }
+
+  // Compiles the current routes into a read-only CompactMap.
+  CompactMap Freeze() const;
+
+ private:
+  std::map<std::string, std::set<std::string>>
+      walk_adjacency_list_;  // Adjacency list representation of the map
+  std::map<std::string, std::set<std::string>>
+      drive_adjacency_list_;  // Adjacency list for driving routes
+};
+
+using NodeId = uint32_t;
+constexpr NodeId kInvalidNode = ~NodeId(0);
+
+class CsrGraph {
+ public:
+  CsrGraph() : offsets_(1, 0) {}
+
+  CsrGraph(const std::map<std::string, std::set<std::string>>& adjacency_list,
+           const std::unordered_map<std::string, NodeId>& ids, size_t num_nodes) :
+      offsets_(num_nodes + 1, 0) {
+    for (const auto& [name, neighbors] : adjacency_list) {
+      offsets_[ids.at(name) + 1] = static_cast<uint32_t>(neighbors.size());
+    }
+    for (size_t i = 0; i < num_nodes; ++i) {
+      offsets_[i + 1] += offsets_[i];
+    }
+    targets_.resize(offsets_.back());
+    for (const auto& [name, neighbors] : adjacency_list) {
+      NodeId* out = targets_.data() + offsets_[ids.at(name)];
+      for (const auto& neighbor : neighbors) {
+        *out++ = ids.at(neighbor);
+      }
+    }
+  }
+
+  const NodeId* begin(NodeId node) const {
+    return targets_.data() + offsets_[node];
+  }
+
+  const NodeId* end(NodeId node) const {
+    return targets_.data() + offsets_[node + 1];
+  }
+
+  size_t degree(NodeId node) const {
+    return offsets_[node + 1] - offsets_[node];
+  }
+
+  size_t num_nodes() const {
+    return offsets_.size() - 1;
+  }
+
+ private:
+  std::vector<uint32_t> offsets_;  // num_nodes + 1 entries
+  std::vector<NodeId> targets_;
+};
+
+class CompactMap {
+ public:
+  explicit CompactMap(const Map& map) {
+    std::set<std::string> names;
+    for (const auto& [name, neighbors] : map.GetWalkAdjList()) {
+      names.insert(name);
+    }
+    for (const auto& [name, neighbors] : map.GetDriveAdjList()) {
+      names.insert(name);
+    }
+    names_.assign(names.begin(), names.end());
+    for (NodeId id = 0; id < names_.size(); ++id) {
+      ids_.emplace(names_[id], id);
+    }
+    walk_graph_ = CsrGraph(map.GetWalkAdjList(), ids_, names_.size());
+    drive_graph_ = CsrGraph(map.GetDriveAdjList(), ids_, names_.size());
+  }
+
+  // kInvalidNode if the location is not on the map.
+  NodeId id(const std::string& name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? kInvalidNode : it->second;
+  }
+
+  const std::string& name(NodeId id) const {
+    return names_[id];
+  }
+
+  size_t size() const {
+    return names_.size();
+  }
+
+  const CsrGraph& GetWalkGraph() const {
+    return walk_graph_;
+  }
+
+  const CsrGraph& GetDriveGraph() const {
+    return drive_graph_;
+  }
+
+ private:
+  std::vector<std::string> names_;  // Indexed by id
+  std::unordered_map<std::string, NodeId> ids_;
+  CsrGraph walk_graph_;
+  CsrGraph drive_graph_;
+};
+
+CompactMap Map::Freeze() const {
+  return CompactMap(*this);
+}
+
+/*
+  Memory for searches on one graph, reused across searches. Not thread-safe.
+*/
+class SearchScratch {
+ public:
+  struct Mark {
+    uint32_t epoch;  // Search that reached the node; older epochs mean "not visited"
+    uint32_t distance;
+    NodeId parent;
+  };
+
+  // Starts a new search. Marks of earlier searches become invalid without being cleared.
+  void Begin(size_t num_nodes) {
+    if (marks[0].size() != num_nodes) {
+      marks[0].assign(num_nodes, {0, 0, kInvalidNode});
+      marks[1].assign(num_nodes, {0, 0, kInvalidNode});
+      epoch = 0;
+    }
+    if (++epoch == 0) {  // Wrapped around: old marks could look current
+      for (auto& side : marks) {
+        std::fill(side.begin(), side.end(), Mark{0, 0, kInvalidNode});
+      }
+      epoch = 1;
+    }
+    frontier[0].clear();
+    frontier[1].clear();
+  }
+
+  bool IsVisited(int side, NodeId node) const {
+    return marks[side][node].epoch == epoch;
+  }
+
+  void Visit(int side, NodeId node, uint32_t distance, NodeId parent) {
+    marks[side][node] = {epoch, distance, parent};
+  }
+
+  std::vector<Mark> marks[2];  // [0] from the start, [1] from the destination
+  std::vector<NodeId> frontier[2];
+  std::vector<NodeId> next;
+  uint32_t epoch = 0;
+  size_t explored = 0;  // Nodes whose neighbors were scanned, summed over all searches
+};
+
+class NavigatorStrategy {
+ public:
+  virtual ~NavigatorStrategy() = default;
+
+  // The routes this strategy travels on.
+  virtual const CsrGraph& GetGraph(const CompactMap& map) const = 0;
+
+  /*
+    Appends the route from `from` to `to` to `route`, both included. If `route` already ends with
+    `from`, it is not repeated. Returns false, leaving `route` unchanged, if there is no route.
+  */
+  static bool FindShortestPath(const CsrGraph& graph, NodeId from, NodeId to,
+                               SearchScratch& scratch, std::vector<NodeId>& route) {
+    scratch.Begin(graph.num_nodes());
+    scratch.Visit(0, from, 0, kInvalidNode);
+    scratch.Visit(1, to, 0, kInvalidNode);
+    scratch.frontier[0].push_back(from);
+    scratch.frontier[1].push_back(to);
+
+    NodeId meet_from = kInvalidNode;  // Last node on the start side
+    NodeId meet_to = kInvalidNode;    // First node on the destination side
+    uint32_t best = ~uint32_t(0);
+    if (from == to) {
+      meet_from = meet_to = from;
+      best = 0;
+    }
+
+    while (best == ~uint32_t(0) && !scratch.frontier[0].empty() &&
+           !scratch.frontier[1].empty()) {
+      int side = scratch.frontier[0].size() <= scratch.frontier[1].size() ? 0 : 1;
+      int other = 1 - side;
+      scratch.next.clear();
+      for (NodeId current : scratch.frontier[side]) {
+        scratch.explored++;
+        uint32_t distance = scratch.marks[side][current].distance + 1;
+        for (const NodeId* it = graph.begin(current); it != graph.end(current); ++it) {
+          if (scratch.IsVisited(other, *it)) {
+            uint32_t total = distance + scratch.marks[other][*it].distance;
+            if (total < best) {
+              best = total;
+              meet_from = side == 0 ? current : *it;
+              meet_to = side == 0 ? *it : current;
+            }
+          }
+          if (!scratch.IsVisited(side, *it)) {
+            scratch.Visit(side, *it, distance, current);
+            scratch.next.push_back(*it);
+          }
+        }
+      }
+      scratch.frontier[side].swap(scratch.next);
+    }
+
+    if (meet_from == kInvalidNode) {
+      return false;
+    }
+    size_t start = route.size();
+    for (NodeId at = meet_from; at != kInvalidNode; at = scratch.marks[0][at].parent) {
+      route.push_back(at);
+    }
+    std::reverse(route.begin() + start, route.end());
+    if (meet_to != meet_from) {
+      for (NodeId at = meet_to; at != kInvalidNode; at = scratch.marks[1][at].parent) {
+        route.push_back(at);
+      }
+    }
+    if (start > 0 && route[start - 1] == from) {
+      route.erase(route.begin() + start);  // Shared stop between two legs
+    }
+    return true;
+  }
+};
+
+class WalkNavigator : public NavigatorStrategy {
+ public:
+  const CsrGraph& GetGraph(const CompactMap& map) const override {
+    return map.GetWalkGraph();
+  }
+};
+
+class DriveNavigator : public NavigatorStrategy {
+ public:
+  const CsrGraph& GetGraph(const CompactMap& map) const override {
+    return map.GetDriveGraph();
+  }
+};
+
+class Traveler {
+ public:
+  Traveler() : strategy_(nullptr) {}
+
+  void set_strategy(NavigatorStrategy* strategy) {
+    strategy_ = strategy;
+  }
+
+  std::pair<bool, std::vector<std::string>> Navigate(const CompactMap& map, std::string from,
+                                                     std::string to,
+                                                     std::string stopover = std::string()) {
+    if (stopover.empty()) {
+      return NavigateVia(map, {from, to});
+    }
+    return NavigateVia(map, {from, stopover, to});
+  }
+
+  /*
+    Route through `stops` in order. Each stop appears once at the point where two legs join.
+    A single known stop is a route of one location; no stops, or an unknown one, is no route.
+  */
+  std::pair<bool, std::vector<std::string>> NavigateVia(const CompactMap& map,
+                                                        const std::vector<std::string>& stops) {
+    assert(strategy_ != nullptr && "Strategy must be set before navigating");
+    if (stops.size() == 1) {
+      if (map.id(stops[0]) == kInvalidNode) {
+        return {false, {}};
+      }
+      return {true, {stops[0]}};
+    }
+    const CsrGraph& graph = strategy_->GetGraph(map);
+
+    ids_.clear();
+    for (size_t i = 0; i + 1 < stops.size(); ++i) {
+      NodeId from = map.id(stops[i]);
+      NodeId to = map.id(stops[i + 1]);
+      if (from == kInvalidNode || to == kInvalidNode ||
+          !NavigatorStrategy::FindShortestPath(graph, from, to, scratch_, ids_)) {
+        return {false, {}};
+      }
+    }
+
+    std::vector<std::string> route;
+    route.reserve(ids_.size());
+    for (NodeId id : ids_) {
+      route.push_back(map.name(id));
+    }
+    return {route.empty() == false, route};
+  }
+
+  size_t explored() const {
+    return scratch_.explored;
+  }
+
+ private:
+  NavigatorStrategy* strategy_;  // Strategy for navigation
+  SearchScratch scratch_;        // Shared by every leg and every query
+  std::vector<NodeId> ids_;      // Route being built, reused across queries
+};
+
+namespace legacy {
+
+// One-directional BFS as in part3, counting explored nodes the same way.
+size_t FindShortestPathLength(const CsrGraph& graph, NodeId from, NodeId to, size_t& explored) {
+  std::vector<uint32_t> distance(graph.num_nodes(), ~uint32_t(0));
+  std::vector<NodeId> queue = {from};
+  distance[from] = 0;
+  for (size_t head = 0; head < queue.size(); ++head) {
+    NodeId current = queue[head];
+    if (current == to) {
+      return distance[current];
+    }
+    explored++;
+    for (const NodeId* it = graph.begin(current); it != graph.end(current); ++it) {
+      if (distance[*it] == ~uint32_t(0)) {
+        distance[*it] = distance[current] + 1;
+        queue.push_back(*it);
+      }
+    }
+  }
+  return ~size_t(0);
+}
+
+}  // namespace legacy
+
+void PrintRoute(const std::string& label, const std::pair<bool, std::vector<std::string>>& result) {
+  if (!result.first) {
+    std::cout << "No " << label << " found.\n";
+    return;
+  }
+  std::cout << label << ": ";
+  for (const auto& stop : result.second) {
+    std::cout << stop << " ";
+  }
+  std::cout << "\n";
+}
+
+int main() {
+  {
+    // Same map as part1.
+    Map map;
+    map.AddWalkRoute("A", "B");
+    map.AddWalkRoute("A", "D");
+    map.AddWalkRoute("B", "C");
+    map.AddWalkRoute("C", "E");
+    map.AddWalkRoute("D", "E");
+    map.AddWalkRoute("F", "G");
+    map.AddWalkRoute("F", "H");
+
+    map.AddDriveRoute("A", "B");
+    map.AddDriveRoute("B", "C");
+    map.AddDriveRoute("C", "H");
+    map.AddDriveRoute("A", "D");
+    map.AddDriveRoute("D", "E");
+    map.AddDriveRoute("F", "G");
+    map.AddDriveRoute("F", "H");
+
+    CompactMap compact_map = map.Freeze();
+    Traveler traveler;
+    WalkNavigator walk_navigator;
+    DriveNavigator drive_navigator;
+
+    traveler.set_strategy(&walk_navigator);
+    PrintRoute("Walk route from A to E", traveler.Navigate(compact_map, "A", "E"));
+    PrintRoute("walk route from A to G", traveler.Navigate(compact_map, "A", "G"));
+
+    traveler.set_strategy(&drive_navigator);
+    PrintRoute("Drive route from A to G", traveler.Navigate(compact_map, "A", "G"));
+    PrintRoute("Drive route from A to G via C", traveler.Navigate(compact_map, "A", "G", "C"));
+    PrintRoute("Drive route A, E, G, B", traveler.NavigateVia(compact_map, {"A", "E", "G", "B"}));
+    PrintRoute("Drive route A", traveler.NavigateVia(compact_map, {"A"}));
+  }
+
+  std::cout << "----------------------------------\n";
+
+  // A large sparse map: a ring of locations plus random shortcuts, average degree 4.
+  const int kLocations = 300000;
+  const int kQueries = 200;
+  Map map;
+  std::mt19937 rng(13);
+  std::uniform_int_distribution<int> location(0, kLocations - 1);
+  for (int i = 0; i < kLocations; ++i) {
+    map.AddDriveRoute(std::to_string(i), std::to_string((i + 1) % kLocations));
+    map.AddDriveRoute(std::to_string(i), std::to_string(location(rng)));
+  }
+  CompactMap compact_map = map.Freeze();
+  const CsrGraph& graph = compact_map.GetDriveGraph();
+
+  std::vector<std::pair<NodeId, NodeId>> queries;
+  for (int i = 0; i < kQueries; ++i) {
+    queries.push_back({compact_map.id(std::to_string(location(rng))),
+                       compact_map.id(std::to_string(location(rng)))});
+  }
+
+  size_t one_way_explored = 0;
+  size_t one_way_hops = 0;
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (const auto& [from, to] : queries) {
+    one_way_hops += legacy::FindShortestPathLength(graph, from, to, one_way_explored);
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::micro> one_way_duration = end_time - start_time;
+
+  SearchScratch scratch;
+  std::vector<NodeId> route;
+  size_t two_way_hops = 0;
+  start_time = std::chrono::high_resolution_clock::now();
+  for (const auto& [from, to] : queries) {
+    route.clear();
+    NavigatorStrategy::FindShortestPath(graph, from, to, scratch, route);
+    two_way_hops += route.size() - 1;
+  }
+  end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::micro> two_way_duration = end_time - start_time;
+
+  std::cout << "One-directional BFS | " << one_way_duration.count() / kQueries << " us/query, "
+            << one_way_explored / kQueries << " explored/query, total hops = " << one_way_hops
+            << "\n";
+  std::cout << "Bidirectional BFS   | " << two_way_duration.count() / kQueries << " us/query, "
+            << scratch.explored / kQueries << " explored/query, total hops = " << two_way_hops
+            << "\n";
+
+  // A route with 10 stops, as one query: the scratch memory is shared by all legs.
+  std::vector<std::string> stops;
+  for (int i = 0; i < 10; ++i) {
+    stops.push_back(std::to_string(location(rng)));
+  }
+  Traveler traveler;
+  DriveNavigator drive_navigator;
+  traveler.set_strategy(&drive_navigator);
+  start_time = std::chrono::high_resolution_clock::now();
+  auto [found, multi_stop_route] = traveler.NavigateVia(compact_map, stops);
+  end_time = std::chrono::high_resolution_clock::now();
+  std::cout << "10-stop route       | "
+            << std::chrono::duration<double, std::micro>(end_time - start_time).count()
+            << " us, " << multi_stop_route.size() << " stops, " << traveler.explored()
+            << " explored\n";
+  return 0;
+}
@@ -0,0 +1,639 @@
+/*
+  Strategy with a shared, immutable map.
+
+  In part1, Traveler(Map map) copies the whole map (both adjacency maps of string sets) into
+  map_, which is never used since Navigate takes the map as an argument anyway. With millions of
+  routes, these copies dominate startup, and every traveler holds its own.
+
+  Here:
+  - MapSnapshot is an immutable compiled map: sorted location names plus CSR walk and drive graphs
+    (see part3), all stored in one flat buffer of 32-bit words.
+  - A snapshot is either built from a Map in memory, or opened from a prebuilt file with mmap.
+    The file has the same layout as the buffer, so opening it builds nothing: it only checks the
+    offsets and targets in one sequential pass, and the pages are shared by every process that
+    maps the same file. Names are looked up by binary search, so no hash table is needed.
+  - Snapshots are handed out as std::shared_ptr<const MapSnapshot>. Any number of travelers can
+    use one at no copy cost.
+  - SharedMap holds the current snapshot. Publish swaps in a new one atomically. A query pins the
+    snapshot it started with, so it never sees a half-updated map, and the old snapshot is freed
+    when its last query is done.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Map {
+ public:
+  void AddWalkRoute(std::string x, std::string y) {
+    walk_adjacency_list_[x].insert(y);
+    walk_adjacency_list_[y].insert(x);
+  }
+
+  void AddDriveRoute(std::string x, std::string y) {
+    drive_adjacency_list_[x].insert(y);
+    drive_adjacency_list_[y].insert(x);
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetWalkAdjList() const {
+    return walk_adjacency_list_;
+  }
+
+  const std::map<std::string, std::set<std::string>>& GetDriveAdjList() const {
+    return drive_adjacency_list_;
+  }
+
+ private:
+  std::map<std::string, std::set<std::string>>
+      walk_adjacency_list_;  // Adjacency list representation of the map
+  std::map<std::string, std::set<std::string>>
+      drive_adjacency_list_;  // Adjacency list for driving routes
+};
+
+using NodeId = uint32_t;
+constexpr NodeId kInvalidNode = ~NodeId(0);
+
+// Read-only view of a CSR graph stored elsewhere.
+class CsrView {
+ public:
+  CsrView() : offsets_(nullptr), targets_(nullptr), num_nodes_(0) {}
+
+  CsrView(const uint32_t* offsets, const NodeId* targets, size_t num_nodes) :
+      offsets_(offsets), targets_(targets), num_nodes_(num_nodes) {}
+
+  const NodeId* begin(NodeId node) const {
+    return targets_ + offsets_[node];
+  }
+
+  const NodeId* end(NodeId node) const {
+    return targets_ + offsets_[node + 1];
+  }
+
+  size_t num_nodes() const {
+    return num_nodes_;
+  }
+
+  size_t num_edges() const {
+    return offsets_[num_nodes_];
+  }
+
+ private:
+  const uint32_t* offsets_;  // num_nodes + 1 entries
+  const NodeId* targets_;
+  size_t num_nodes_;
+};
+
+/*
+  Layout, in 32-bit words:
+    header:        kMagic, kFormatVersion, num_nodes, walk_edges, drive_edges, name_bytes
+    name_offsets:  num_nodes + 1 byte offsets into names
+    names:         name_bytes characters, sorted, padded to a whole word
+    walk graph:    num_nodes + 1 offsets, walk_edges targets
+    drive graph:   num_nodes + 1 offsets, drive_edges targets
+*/
+class MapSnapshot {
+ public:
+  static std::shared_ptr<const MapSnapshot> Build(const Map& map) {
+    std::set<std::string> unique_names;
+    for (const auto& [name, neighbors] : map.GetWalkAdjList()) {
+      unique_names.insert(name);
+    }
+    for (const auto& [name, neighbors] : map.GetDriveAdjList()) {
+      unique_names.insert(name);
+    }
+    std::vector<std::string> names(unique_names.begin(), unique_names.end());
+    std::unordered_map<std::string, NodeId> ids;
+    for (NodeId i = 0; i < names.size(); ++i) {
+      ids.emplace(names[i], i);
+    }
+    auto id = [&ids](const std::string& name) { return ids.at(name); };
+
+    std::vector<uint32_t> buffer(kHeaderWords, 0);
+    buffer[0] = kMagic;
+    buffer[1] = kFormatVersion;
+    buffer[2] = static_cast<uint32_t>(names.size());
+
+    uint32_t name_bytes = 0;
+    for (const auto& name : names) {
+      buffer.push_back(name_bytes);
+      name_bytes += static_cast<uint32_t>(name.size());
+    }
+    buffer.push_back(name_bytes);
+    buffer[5] = name_bytes;
+    size_t names_start = buffer.size();
+    buffer.resize(names_start + Words(name_bytes));
+    char* out = reinterpret_cast<char*>(buffer.data() + names_start);
+    for (const auto& name : names) {
+      out = std::copy(name.begin(), name.end(), out);
+    }
+
+    auto append_graph = [&](const std::map<std::string, std::set<std::string>>& adjacency_list) {
+      size_t offsets_start = buffer.size();
+      buffer.resize(offsets_start + names.size() + 1, 0);
+      for (const auto& [name, neighbors] : adjacency_list) {
+        buffer[offsets_start + id(name) + 1] = static_cast<uint32_t>(neighbors.size());
+      }
+      for (size_t i = 0; i < names.size(); ++i) {
+        buffer[offsets_start + i + 1] += buffer[offsets_start + i];
+      }
+      uint32_t num_edges = buffer[offsets_start + names.size()];
+      size_t targets_start = buffer.size();
+      buffer.resize(targets_start + num_edges);
+      for (const auto& [name, neighbors] : adjacency_list) {
+        size_t at = targets_start + buffer[offsets_start + id(name)];
+        for (const auto& neighbor : neighbors) {
+          buffer[at++] = id(neighbor);
+        }
+      }
+      return num_edges;
+    };
+    buffer[3] = append_graph(map.GetWalkAdjList());
+    buffer[4] = append_graph(map.GetDriveAdjList());
+
+    return std::shared_ptr<const MapSnapshot>(new MapSnapshot(std::move(buffer)));
+  }
+
+  // Maps a file written by Save. Throws std::runtime_error if it cannot be opened or is invalid.
+  static std::shared_ptr<const MapSnapshot> Open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to open the map file");
+    }
+    struct stat file_status;
+    if (::fstat(fd, &file_status) != 0 || file_status.st_size == 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to read the map file");
+    }
+    size_t size = static_cast<size_t>(file_status.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // The mapping stays valid
+    if (mapping == MAP_FAILED) {
+      throw std::runtime_error("Failed to map the map file");
+    }
+    return std::shared_ptr<const MapSnapshot>(new MapSnapshot(mapping, size));
+  }
+
+  ~MapSnapshot() {
+    if (mapping_ != nullptr) {
+      ::munmap(mapping_, size_ * sizeof(uint32_t));
+    }
+  }
+
+  MapSnapshot(const MapSnapshot&) = delete;
+  MapSnapshot& operator=(const MapSnapshot&) = delete;
+
+  void Save(const std::string& path) const {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Failed to write the map file");
+    }
+    const char* data = reinterpret_cast<const char*>(words_);
+    size_t remaining = size_ * sizeof(uint32_t);
+    while (remaining > 0) {
+      ssize_t written = ::write(fd, data, remaining);
+      if (written <= 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to write the map file");
+      }
+      data += written;
+      remaining -= written;
+    }
+    ::close(fd);
+  }
+
+  // kInvalidNode if the location is not on the map.
+  NodeId id(std::string_view name) const {
+    NodeId low = 0;
+    NodeId high = static_cast<NodeId>(num_nodes_);
+    while (low < high) {
+      NodeId middle = low + (high - low) / 2;
+      if (this->name(middle) < name) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return low < num_nodes_ && this->name(low) == name ? low : kInvalidNode;
+  }
+
+  std::string_view name(NodeId id) const {
+    return std::string_view(names_ + name_offsets_[id], name_offsets_[id + 1] - name_offsets_[id]);
+  }
+
+  size_t size() const {
+    return num_nodes_;
+  }
+
+  bool is_mapped() const {
+    return mapping_ != nullptr;
+  }
+
+  const CsrView& GetWalkGraph() const {
+    return walk_graph_;
+  }
+
+  const CsrView& GetDriveGraph() const {
+    return drive_graph_;
+  }
+
+ private:
+  static constexpr uint32_t kMagic = 0x5350414d;  // "MAPS"
+  static constexpr uint32_t kFormatVersion = 1;
+  static constexpr size_t kHeaderWords = 6;
+
+  static size_t Words(size_t bytes) {
+    return (bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  }
+
+  explicit MapSnapshot(std::vector<uint32_t> buffer) :
+      owned_(std::move(buffer)), mapping_(nullptr), words_(owned_.data()), size_(owned_.size()) {
+    Parse();
+  }
+
+  MapSnapshot(void* mapping, size_t bytes) :
+      mapping_(mapping),
+      words_(static_cast<const uint32_t*>(mapping)),
+      size_(bytes / sizeof(uint32_t)) {
+    if (bytes % sizeof(uint32_t) != 0) {
+      ::munmap(mapping_, bytes);
+      throw std::runtime_error("Invalid map file");
+    }
+    try {
+      Parse();
+    } catch (...) {
+      ::munmap(mapping_, bytes);
+      throw;
+    }
+  }
+
+  // Points the views into the buffer, checking every section against the buffer size.
+  void Parse() {
+    if (size_ < kHeaderWords || words_[0] != kMagic || words_[1] != kFormatVersion) {
+      throw std::runtime_error("Invalid map file");
+    }
+    num_nodes_ = words_[2];
+    size_t walk_edges = words_[3];
+    size_t drive_edges = words_[4];
+    size_t name_bytes = words_[5];
+    size_t expected = kHeaderWords + (num_nodes_ + 1) + Words(name_bytes) + 2 * (num_nodes_ + 1) +
+                      walk_edges + drive_edges;
+    if (size_ != expected) {
+      throw std::runtime_error("Invalid map file");
+    }
+
+    if (num_nodes_ >= kInvalidNode) {
+      throw std::runtime_error("Invalid map file");
+    }
+
+    const uint32_t* at = words_ + kHeaderWords;
+    name_offsets_ = at;
+    CheckOffsets(name_offsets_, name_bytes);
+    at += num_nodes_ + 1;
+    names_ = reinterpret_cast<const char*>(at);
+    at += Words(name_bytes);
+    walk_graph_ = CsrView(at, at + num_nodes_ + 1, num_nodes_);
+    CheckGraph(at, walk_edges);
+    at += num_nodes_ + 1 + walk_edges;
+    drive_graph_ = CsrView(at, at + num_nodes_ + 1, num_nodes_);
+    CheckGraph(at, drive_edges);
+  }
+
+  // Throws unless the num_nodes_ + 1 offsets start at 0, never decrease and end at `end`.
+  void CheckOffsets(const uint32_t* offsets, size_t end) const {
+    if (offsets[0] != 0 || offsets[num_nodes_] != end) {
+      throw std::runtime_error("Invalid map file");
+    }
+    for (size_t i = 0; i < num_nodes_; ++i) {
+      if (offsets[i] > offsets[i + 1]) {
+        throw std::runtime_error("Invalid map file");
+      }
+    }
+  }
+
+  // Throws unless the CSR graph at `offsets` is consistent and only points at known locations.
+  void CheckGraph(const uint32_t* offsets, size_t num_edges) const {
+    CheckOffsets(offsets, num_edges);
+    const NodeId* targets = offsets + num_nodes_ + 1;
+    for (size_t i = 0; i < num_edges; ++i) {
+      if (targets[i] >= num_nodes_) {
+        throw std::runtime_error("Invalid map file");
+      }
+    }
+  }
+
+  std::vector<uint32_t> owned_;  // Empty for a mapped file
+  void* mapping_;                // nullptr for a snapshot built in memory
+  const uint32_t* words_;
+  size_t size_;  // In words
+
+  size_t num_nodes_;
+  const uint32_t* name_offsets_;
+  const char* names_;
+  CsrView walk_graph_;
+  CsrView drive_graph_;
+};
+
+/*
+  The current map, shared by all travelers. Readers and Publish may run concurrently.
+*/
+class SharedMap {
+ public:
+  explicit SharedMap(std::shared_ptr<const MapSnapshot> snapshot) :
+      snapshot_(std::move(snapshot)) {}
+
+  std::shared_ptr<const MapSnapshot> Current() const {
+    return std::atomic_load(&snapshot_);
+  }
+
+  void Publish(std::shared_ptr<const MapSnapshot> snapshot) {
+    std::atomic_store(&snapshot_, std::move(snapshot));
+  }
+
+ private:
+  std::shared_ptr<const MapSnapshot> snapshot_;
+};
+
+// Working arrays for one BFS at a time, reused across searches instead of allocated per query.
+struct SearchScratch {
+  std::vector<uint64_t> visited;  // One bit per location
+  std::vector<NodeId> parent;
+  std::vector<NodeId> queue;
+};
+
+class NavigatorStrategy {
+ public:
+  virtual ~NavigatorStrategy() = default;
+  virtual std::pair<bool, std::vector<NodeId>> Navigate(const MapSnapshot& map, NodeId from,
+                                                        NodeId to,
+                                                        SearchScratch& scratch) const = 0;
+
+  static std::vector<NodeId> FindShortestPath(const CsrView& graph, NodeId from, NodeId to,
+                                              SearchScratch& scratch) {
+    std::vector<uint64_t>& visited = scratch.visited;
+    std::vector<NodeId>& parent = scratch.parent;
+    std::vector<NodeId>& queue = scratch.queue;
+    visited.assign((graph.num_nodes() + 63) / 64, 0);
+    parent.resize(graph.num_nodes());
+    queue.resize(graph.num_nodes());
+
+    size_t head = 0;
+    size_t tail = 0;
+    queue[tail++] = from;
+    visited[from / 64] |= uint64_t(1) << (from % 64);
+    parent[from] = kInvalidNode;
+
+    bool found = false;
+    while (head < tail) {
+      NodeId current = queue[head++];
+      if (current == to) {
+        found = true;
+        break;
+      }
+      for (const NodeId* it = graph.begin(current); it != graph.end(current); ++it) {
+        uint64_t bit = uint64_t(1) << (*it % 64);
+        if ((visited[*it / 64] & bit) == 0) {
+          visited[*it / 64] |= bit;
+          parent[*it] = current;
+          queue[tail++] = *it;
+        }
+      }
+    }
+
+    if (!found) {
+      return {};
+    }
+    std::vector<NodeId> route;
+    for (NodeId at = to; at != kInvalidNode; at = parent[at]) {
+      route.push_back(at);
+    }
+    std::reverse(route.begin(), route.end());
+    return route;
+  }
+};
+
+class WalkNavigator : public NavigatorStrategy {
+ public:
+  std::pair<bool, std::vector<NodeId>> Navigate(const MapSnapshot& map, NodeId from, NodeId to,
+                                                SearchScratch& scratch) const override {
+    std::vector<NodeId> route = FindShortestPath(map.GetWalkGraph(), from, to, scratch);
+    return {route.empty() == false, route};
+  }
+};
+
+class DriveNavigator : public NavigatorStrategy {
+ public:
+  std::pair<bool, std::vector<NodeId>> Navigate(const MapSnapshot& map, NodeId from, NodeId to,
+                                                SearchScratch& scratch) const override {
+    std::vector<NodeId> route = FindShortestPath(map.GetDriveGraph(), from, to, scratch);
+    return {route.empty() == false, route};
+  }
+};
+
+// A traveler is used by one thread at a time; use one traveler per thread.
+class Traveler {
+ public:
+  // Only keeps a reference: no map is copied.
+  explicit Traveler(const SharedMap& map) : map_(map), strategy_(nullptr) {}
+
+  void set_strategy(NavigatorStrategy* strategy) {
+    strategy_ = strategy;
+  }
+
+  // Navigates on the map current at the time of the call, even if a new one is published
+  // meanwhile.
+  std::pair<bool, std::vector<std::string>> Navigate(std::string from, std::string to,
+                                                     std::string stopover = std::string()) const {
+    assert(strategy_ != nullptr && "Strategy must be set before navigating");
+    std::shared_ptr<const MapSnapshot> map = map_.Current();
+
+    std::vector<NodeId> stops = {map->id(from)};
+    if (!stopover.empty()) {
+      stops.push_back(map->id(stopover));
+    }
+    stops.push_back(map->id(to));
+    if (std::find(stops.begin(), stops.end(), kInvalidNode) != stops.end()) {
+      return {false, {}};
+    }
+
+    std::vector<std::string> complete_route;
+    for (size_t i = 0; i + 1 < stops.size(); ++i) {
+      auto [found, route] = strategy_->Navigate(*map, stops[i], stops[i + 1], scratch_);
+      if (!found) {
+        return {false, {}};
+      }
+      // Each leg starts where the previous one ended; list that stop once.
+      for (size_t k = i == 0 ? 0 : 1; k < route.size(); ++k) {
+        complete_route.emplace_back(map->name(route[k]));
+      }
+    }
+    return {complete_route.empty() == false, complete_route};
+  }
+
+ private:
+  const SharedMap& map_;           // The map to navigate
+  NavigatorStrategy* strategy_;    // Strategy for navigation
+  mutable SearchScratch scratch_;  // Reused by every query of this traveler
+};
+
+namespace legacy {
+
+// The part1 traveler, which keeps its own copy of the map.
+class Traveler {
+ public:
+  Traveler(Map map) : map_(map) {}
+
+ private:
+  Map map_;
+};
+
+}  // namespace legacy
+
+void PrintRoute(const std::string& label, const std::pair<bool, std::vector<std::string>>& result) {
+  if (!result.first) {
+    std::cout << "No " << label << " found.\n";
+    return;
+  }
+  std::cout << label << ": ";
+  for (const auto& stop : result.second) {
+    std::cout << stop << " ";
+  }
+  std::cout << "\n";
+}
+
+int main() {
+  {
+    // Same map as part1.
+    Map map;
+    map.AddWalkRoute("A", "B");
+    map.AddWalkRoute("A", "D");
+    map.AddWalkRoute("B", "C");
+    map.AddWalkRoute("C", "E");
+    map.AddWalkRoute("D", "E");
+    map.AddWalkRoute("F", "G");
+    map.AddWalkRoute("F", "H");
+
+    map.AddDriveRoute("A", "B");
+    map.AddDriveRoute("B", "C");
+    map.AddDriveRoute("C", "H");
+    map.AddDriveRoute("A", "D");
+    map.AddDriveRoute("D", "E");
+    map.AddDriveRoute("F", "G");
+    map.AddDriveRoute("F", "H");
+
+    SharedMap shared_map(MapSnapshot::Build(map));
+    Traveler traveler(shared_map);
+    WalkNavigator walk_navigator;
+    DriveNavigator drive_navigator;
+
+    traveler.set_strategy(&walk_navigator);
+    PrintRoute("Walk route from A to E", traveler.Navigate("A", "E"));
+    PrintRoute("walk route from A to G", traveler.Navigate("A", "G"));
+
+    traveler.set_strategy(&drive_navigator);
+    PrintRoute("Drive route from A to G", traveler.Navigate("A", "G"));
+    PrintRoute("Drive route from A to G via C", traveler.Navigate("A", "G", "C"));
+
+    // Publish a new version of the map; the same traveler sees it on its next query.
+    map.AddDriveRoute("A", "G");
+    shared_map.Publish(MapSnapshot::Build(map));
+    PrintRoute("Drive route from A to G after adding A-G", traveler.Navigate("A", "G"));
+  }
+
+  std::cout << "----------------------------------\n";
+
+  // A large sparse map: a ring of locations plus random shortcuts.
+  const int kLocations = 200000;
+  const int kTravelers = 10;
+  Map map;
+  std::mt19937 rng(17);
+  std::uniform_int_distribution<int> location(0, kLocations - 1);
+  for (int i = 0; i < kLocations; ++i) {
+    map.AddWalkRoute(std::to_string(i), std::to_string((i + 1) % kLocations));
+    map.AddDriveRoute(std::to_string(i), std::to_string((i + 1) % kLocations));
+    map.AddDriveRoute(std::to_string(i), std::to_string(location(rng)));
+  }
+
+  auto elapsed_ms = [](auto start_time) {
+    auto end_time = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end_time - start_time).count();
+  };
+
+  auto start_time = std::chrono::high_resolution_clock::now();
+  std::vector<legacy::Traveler> copying_travelers;
+  for (int i = 0; i < kTravelers; ++i) {
+    copying_travelers.emplace_back(map);
+  }
+  std::cout << "part1 Traveler(Map)      | " << elapsed_ms(start_time) / kTravelers
+            << " ms per traveler\n";
+  copying_travelers.clear();
+
+  start_time = std::chrono::high_resolution_clock::now();
+  auto built = MapSnapshot::Build(map);
+  std::cout << "MapSnapshot::Build       | " << elapsed_ms(start_time) << " ms, once\n";
+
+  std::string path = (std::filesystem::temp_directory_path() / "strategy_part7.map").string();
+  built->Save(path);
+
+  start_time = std::chrono::high_resolution_clock::now();
+  auto mapped = MapSnapshot::Open(path);
+  std::cout << "MapSnapshot::Open (mmap) | " << elapsed_ms(start_time) << " ms, "
+            << mapped->size() << " locations, " << mapped->GetDriveGraph().num_edges()
+            << " drive edges\n";
+
+  SharedMap shared_map(mapped);
+  start_time = std::chrono::high_resolution_clock::now();
+  std::vector<Traveler> travelers;
+  for (int i = 0; i < kTravelers; ++i) {
+    travelers.emplace_back(shared_map);
+  }
+  std::cout << "Traveler(SharedMap)      | " << elapsed_ms(start_time) / kTravelers
+            << " ms per traveler\n";
+
+  // Queries keep running on one thread while another publishes new snapshots.
+  DriveNavigator drive_navigator;
+  for (auto& traveler : travelers) {
+    traveler.set_strategy(&drive_navigator);
+  }
+  std::atomic<bool> running(true);
+  std::atomic<long long> queries(0);
+  std::thread reader([&]() {
+    std::mt19937 reader_rng(19);
+    for (size_t i = 0; running; ++i) {
+      auto [found, route] = travelers[i % travelers.size()].Navigate(
+          std::to_string(location(reader_rng)), std::to_string(location(reader_rng)));
+      assert(found && "The ring connects every location");
+      queries++;
+    }
+  });
+  for (int version = 0; version < 4; ++version) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    shared_map.Publish(version % 2 == 0 ? built : mapped);
+  }
+  running = false;
+  reader.join();
+  std::cout << "Queries while publishing 4 snapshots: " << queries << "\n";
+
+  std::filesystem::remove(path);
+  return 0;
+}
@@ -0,0 +1,410 @@
+/*
+  Template method without virtual calls.
+
+  In part2, PizzaMaker::Make calls the virtual hooks MakeDough and PutToppings, and every recipe is
+  a subclass. Each Make costs two indirect calls the compiler cannot inline, even for recipes that
+  do not override a hook.
+
+  To make millions of pizzas, steps here record what they do into a Pizza instead of printing it
+  (Describe prints it afterwards), and there are two alternatives to the virtual version:
+
+  - Compile-time composition (CRTP): PizzaMaker<Recipe>::Make is the same template method, but it
+    calls the hooks on Recipe, which is known at compile time. Recipes hide the default hooks
+    they want to change. Every call is resolved statically, hooks inline into Make, and a hook
+    that does nothing (PutToppings of a cheese pizza) disappears from the generated code.
+
+  - Runtime recipe table: recipes loaded from data (e.g. a menu file) are lists of steps.
+    RecipeTable parses them once into compact step arrays, and Make runs a step array with a
+    switch, so adding a recipe needs no new class and no recompilation.
+*/
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+enum class Ingredient : uint8_t {
+  kDough,
+  kCheeseCrustedDough,
+  kTomatoSauce,
+  kCheese,
+  kPepperoni,
+  kMushrooms,
+};
+
+struct Pizza {
+  static constexpr size_t kMaxLayers = 8;
+
+  void Add(Ingredient ingredient) {
+    assert(num_layers < kMaxLayers && "Too many layers");
+    layers[num_layers++] = ingredient;
+  }
+
+  std::array<Ingredient, kMaxLayers> layers;
+  uint8_t num_layers = 0;
+  bool baked = false;
+};
+
+// Prints the steps that made the pizza, as in part2.
+void Describe(const Pizza& pizza) {
+  for (size_t i = 0; i < pizza.num_layers; ++i) {
+    switch (pizza.layers[i]) {
+      case Ingredient::kDough:
+        std::cout << "- Making dough for pizza\n";
+        break;
+      case Ingredient::kCheeseCrustedDough:
+        std::cout << "- Making cheese-crusted dough for pizza\n";
+        break;
+      case Ingredient::kTomatoSauce:
+        std::cout << "- Putting tomato sauce on pizza\n";
+        break;
+      case Ingredient::kCheese:
+        std::cout << "- Putting cheese on pizza\n";
+        break;
+      case Ingredient::kPepperoni:
+        std::cout << "- Putting pepperoni on pizza\n";
+        break;
+      case Ingredient::kMushrooms:
+        std::cout << "- Putting mushrooms on pizza\n";
+        break;
+    }
+  }
+  if (pizza.baked) {
+    std::cout << "- Baking pizza\n";
+  }
+}
+
+namespace virtual_dispatch {
+
+// The part2 PizzaMaker, recording into a Pizza instead of printing.
+class PizzaMaker {
+ public:
+  virtual ~PizzaMaker() = default;
+
+  void Make(Pizza& pizza) {
+    MakeDough(pizza);
+    PutTomatoSauce(pizza);
+    PutCheese(pizza);
+    PutToppings(pizza);
+    Bake(pizza);
+  }
+
+ protected:
+  virtual void MakeDough(Pizza& pizza) {
+    pizza.Add(Ingredient::kDough);
+  }
+
+  virtual void PutToppings(Pizza&) {}
+
+ private:
+  void PutTomatoSauce(Pizza& pizza) {
+    pizza.Add(Ingredient::kTomatoSauce);
+  }
+
+  void PutCheese(Pizza& pizza) {
+    pizza.Add(Ingredient::kCheese);
+  }
+
+  void Bake(Pizza& pizza) {
+    pizza.baked = true;
+  }
+};
+
+class CheesePizzaMaker : public PizzaMaker {};
+
+class PepperoniPizzaMaker : public PizzaMaker {
+ protected:
+  void PutToppings(Pizza& pizza) override {
+    pizza.Add(Ingredient::kPepperoni);
+  }
+};
+
+class CheeseCrustedPepperoniPizzaMaker : public PepperoniPizzaMaker {
+ protected:
+  void MakeDough(Pizza& pizza) override {
+    pizza.Add(Ingredient::kCheeseCrustedDough);
+  }
+};
+
+}  // namespace virtual_dispatch
+
+/*
+  Recipe is the concrete maker deriving from PizzaMaker<Recipe>. It may define its own MakeDough
+  and PutToppings, which hide the defaults below.
+*/
+template <typename Recipe>
+class PizzaMaker {
+ public:
+  void Make(Pizza& pizza) {
+    recipe().MakeDough(pizza);
+    PutTomatoSauce(pizza);
+    PutCheese(pizza);
+    recipe().PutToppings(pizza);
+    Bake(pizza);
+  }
+
+  // Default hooks
+  void MakeDough(Pizza& pizza) {
+    pizza.Add(Ingredient::kDough);
+  }
+
+  void PutToppings(Pizza&) {}
+
+ private:
+  Recipe& recipe() {
+    return static_cast<Recipe&>(*this);
+  }
+
+  void PutTomatoSauce(Pizza& pizza) {
+    pizza.Add(Ingredient::kTomatoSauce);
+  }
+
+  void PutCheese(Pizza& pizza) {
+    pizza.Add(Ingredient::kCheese);
+  }
+
+  void Bake(Pizza& pizza) {
+    pizza.baked = true;
+  }
+};
+
+// For Cheese Pizza, we can use the default hooks
+class CheesePizzaMaker : public PizzaMaker<CheesePizzaMaker> {};
+
+/*
+  Pepperoni toppings for any recipe. Recipes that want them derive from PepperoniToppings<Self>
+  instead of PizzaMaker<Self>, the same way CheeseCrustedPepperoniPizzaMaker reuses
+  PepperoniPizzaMaker in part2.
+*/
+template <typename Recipe>
+class PepperoniToppings : public PizzaMaker<Recipe> {
+ public:
+  void PutToppings(Pizza& pizza) {
+    pizza.Add(Ingredient::kPepperoni);
+  }
+};
+
+class PepperoniPizzaMaker : public PepperoniToppings<PepperoniPizzaMaker> {};
+
+class CheeseCrustedPepperoniPizzaMaker
+    : public PepperoniToppings<CheeseCrustedPepperoniPizzaMaker> {
+ public:
+  void MakeDough(Pizza& pizza) {
+    pizza.Add(Ingredient::kCheeseCrustedDough);
+  }
+};
+
+/*
+  Recipes loaded at runtime. A recipe is a line "name: step step ...", e.g.
+    margherita: dough tomato_sauce cheese bake
+*/
+class RecipeTable {
+ public:
+  enum class Step : uint8_t {
+    kDough,
+    kCheeseCrustedDough,
+    kTomatoSauce,
+    kCheese,
+    kPepperoni,
+    kMushrooms,
+    kBake,
+  };
+
+  struct Recipe {
+    std::array<Step, Pizza::kMaxLayers + 1> steps;
+    uint8_t num_steps = 0;
+  };
+
+  // Throws std::runtime_error on an unknown step, a recipe with more layers than
+  // Pizza::kMaxLayers, or a recipe with too many steps.
+  void Load(std::istream& input) {
+    static const std::map<std::string, Step> kSteps = {
+        {"dough", Step::kDough},
+        {"cheese_crusted_dough", Step::kCheeseCrustedDough},
+        {"tomato_sauce", Step::kTomatoSauce},
+        {"cheese", Step::kCheese},
+        {"pepperoni", Step::kPepperoni},
+        {"mushrooms", Step::kMushrooms},
+        {"bake", Step::kBake},
+    };
+
+    std::string line;
+    while (std::getline(input, line)) {
+      size_t colon = line.find(':');
+      if (colon == std::string::npos) {
+        continue;  // Blank line or comment
+      }
+      Recipe recipe;
+      size_t num_layers = 0;
+      std::istringstream steps(line.substr(colon + 1));
+      std::string step;
+      while (steps >> step) {
+        auto it = kSteps.find(step);
+        if (it == kSteps.end()) {
+          throw std::runtime_error("Unknown step '" + step + "'");
+        }
+        if (recipe.num_steps == recipe.steps.size()) {
+          throw std::runtime_error("Too many steps in '" + line.substr(0, colon) + "'");
+        }
+        if (it->second != Step::kBake && ++num_layers > Pizza::kMaxLayers) {
+          throw std::runtime_error("Too many layers in '" + line.substr(0, colon) + "'");
+        }
+        recipe.steps[recipe.num_steps++] = it->second;
+      }
+      ids_[line.substr(0, colon)] = recipes_.size();
+      recipes_.push_back(recipe);
+    }
+  }
+
+  // Throws std::out_of_range for an unknown recipe.
+  size_t id(const std::string& name) const {
+    return ids_.at(name);
+  }
+
+  void Make(size_t id, Pizza& pizza) const {
+    const Recipe& recipe = recipes_[id];
+    for (size_t i = 0; i < recipe.num_steps; ++i) {
+      switch (recipe.steps[i]) {
+        case Step::kDough:
+          pizza.Add(Ingredient::kDough);
+          break;
+        case Step::kCheeseCrustedDough:
+          pizza.Add(Ingredient::kCheeseCrustedDough);
+          break;
+        case Step::kTomatoSauce:
+          pizza.Add(Ingredient::kTomatoSauce);
+          break;
+        case Step::kCheese:
+          pizza.Add(Ingredient::kCheese);
+          break;
+        case Step::kPepperoni:
+          pizza.Add(Ingredient::kPepperoni);
+          break;
+        case Step::kMushrooms:
+          pizza.Add(Ingredient::kMushrooms);
+          break;
+        case Step::kBake:
+          pizza.baked = true;
+          break;
+      }
+    }
+  }
+
+ private:
+  std::map<std::string, size_t> ids_;
+  std::vector<Recipe> recipes_;
+};
+
+const char* kMenu = R"(
+cheese: dough tomato_sauce cheese bake
+pepperoni: dough tomato_sauce cheese pepperoni bake
+cheese_crusted_pepperoni: cheese_crusted_dough tomato_sauce cheese pepperoni bake
+funghi: dough tomato_sauce cheese mushrooms bake
+)";
+
+// Makes one pizza per order, where make_one(kind, pizza) makes a pizza of the given kind.
+template <typename MakeOne>
+void Measure(const char* label, const std::vector<uint8_t>& orders, MakeOne make_one) {
+  uint64_t checksum = 0;  // Keeps the compiler from dropping the work
+  auto start_time = std::chrono::high_resolution_clock::now();
+  for (uint8_t kind : orders) {
+    Pizza pizza;
+    make_one(kind, pizza);
+    checksum += pizza.num_layers + static_cast<uint8_t>(pizza.layers[0]) + pizza.baked;
+  }
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::nano> duration = end_time - start_time;
+
+  std::cout << label << " | " << duration.count() / orders.size()
+            << " ns/pizza, checksum = " << checksum << "\n";
+}
+
+int main() {
+  {
+    Pizza pizza;
+    CheesePizzaMaker().Make(pizza);
+    std::cout << "Making Cheese Pizza:\n";
+    Describe(pizza);
+    std::cout << "\n";
+  }
+  {
+    Pizza pizza;
+    PepperoniPizzaMaker().Make(pizza);
+    std::cout << "Making Pepperoni Pizza:\n";
+    Describe(pizza);
+    std::cout << "\n";
+  }
+  {
+    Pizza pizza;
+    CheeseCrustedPepperoniPizzaMaker().Make(pizza);
+    std::cout << "Making Cheese Crusted Pepperoni Pizza:\n";
+    Describe(pizza);
+    std::cout << "\n";
+  }
+
+  RecipeTable table;
+  std::istringstream menu(kMenu);
+  table.Load(menu);
+  {
+    Pizza pizza;
+    table.Make(table.id("funghi"), pizza);
+    std::cout << "Making Funghi Pizza from the recipe table:\n";
+    Describe(pizza);
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const size_t kPizzas = 10000000;
+  std::mt19937 rng(23);
+  std::uniform_int_distribution<int> kind_dist(0, 2);
+  std::vector<uint8_t> mixed_orders(kPizzas);
+  for (auto& kind : mixed_orders) {
+    kind = static_cast<uint8_t>(kind_dist(rng));
+  }
+  std::vector<uint8_t> pepperoni_orders(kPizzas, 1);
+
+  std::vector<std::unique_ptr<virtual_dispatch::PizzaMaker>> virtual_makers;
+  virtual_makers.emplace_back(new virtual_dispatch::CheesePizzaMaker());
+  virtual_makers.emplace_back(new virtual_dispatch::PepperoniPizzaMaker());
+  virtual_makers.emplace_back(new virtual_dispatch::CheeseCrustedPepperoniPizzaMaker());
+
+  CheesePizzaMaker cheese_maker;
+  PepperoniPizzaMaker pepperoni_maker;
+  CheeseCrustedPepperoniPizzaMaker cheese_crusted_pepperoni_maker;
+  auto make_static = [&](uint8_t kind, Pizza& pizza) {
+    switch (kind) {
+      case 0:
+        cheese_maker.Make(pizza);
+        break;
+      case 1:
+        pepperoni_maker.Make(pizza);
+        break;
+      default:
+        cheese_crusted_pepperoni_maker.Make(pizza);
+        break;
+    }
+  };
+
+  std::array<size_t, 3> recipe_ids = {table.id("cheese"), table.id("pepperoni"),
+                                      table.id("cheese_crusted_pepperoni")};
+  auto make_virtual = [&](uint8_t kind, Pizza& pizza) { virtual_makers[kind]->Make(pizza); };
+  auto make_table = [&](uint8_t kind, Pizza& pizza) { table.Make(recipe_ids[kind], pizza); };
+
+  std::cout << "Mixed orders:\n";
+  Measure("Virtual hooks (part2)  ", mixed_orders, make_virtual);
+  Measure("CRTP                   ", mixed_orders, make_static);
+  Measure("Recipe table           ", mixed_orders, make_table);
+  std::cout << "Pepperoni only:\n";
+  Measure("Virtual hooks (part2)  ", pepperoni_orders, make_virtual);
+  Measure("CRTP                   ", pepperoni_orders, make_static);
+  Measure("Recipe table           ", pepperoni_orders, make_table);
+  return 0;
+}
@@ -0,0 +1,453 @@
+/*
+  Template method steps as a pipeline.
+
+  In part2, PizzaMaker::Make runs MakeDough -> PutTomatoSauce -> PutCheese -> PutToppings -> Bake
+  strictly in sequence, one pizza at a time. While a pizza is in the oven, nobody makes dough for
+  the next one.
+
+  Here every step takes some time (simulated with a sleep), and:
+  - PizzaMaker still owns the order of the steps (kSteps) and the hooks that subclasses override.
+    RunStep runs a single step, and Make runs them all, as before.
+  - Kitchen turns every step into a stage with its own workers and a bounded input queue. A pizza
+    moves to the next stage's queue as soon as a step is done, so up to one pizza per worker is
+    in flight at every stage. Slow stages (the oven) can get more workers.
+  - When a queue is full, the previous stage waits (back pressure), so a slow stage cannot make
+    the queues grow without bound.
+  - Per-stage metrics: pizzas processed, busy time (utilization), current and maximum queue depth.
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class Ingredient : uint8_t {
+  kDough,
+  kCheeseCrustedDough,
+  kTomatoSauce,
+  kCheese,
+  kPepperoni,
+};
+
+struct Pizza {
+  std::vector<Ingredient> layers;
+  bool baked = false;
+};
+
+// Prints the steps that made the pizza, as in part2.
+void Describe(const Pizza& pizza) {
+  for (Ingredient ingredient : pizza.layers) {
+    switch (ingredient) {
+      case Ingredient::kDough:
+        std::cout << "- Making dough for pizza\n";
+        break;
+      case Ingredient::kCheeseCrustedDough:
+        std::cout << "- Making cheese-crusted dough for pizza\n";
+        break;
+      case Ingredient::kTomatoSauce:
+        std::cout << "- Putting tomato sauce on pizza\n";
+        break;
+      case Ingredient::kCheese:
+        std::cout << "- Putting cheese on pizza\n";
+        break;
+      case Ingredient::kPepperoni:
+        std::cout << "- Putting pepperoni on pizza\n";
+        break;
+    }
+  }
+  if (pizza.baked) {
+    std::cout << "- Baking pizza\n";
+  }
+}
+
+void SimulateWork(std::chrono::microseconds duration) {
+  std::this_thread::sleep_for(duration);
+}
+
+/*
+  Makers keep no state, so one maker can work on several pizzas from several threads at once.
+*/
+class PizzaMaker {
+ public:
+  enum class Step { kMakeDough, kPutTomatoSauce, kPutCheese, kPutToppings, kBake };
+  static constexpr std::array<Step, 5> kSteps = {Step::kMakeDough, Step::kPutTomatoSauce,
+                                                 Step::kPutCheese, Step::kPutToppings,
+                                                 Step::kBake};
+
+  virtual ~PizzaMaker() = default;
+
+  void Make(Pizza& pizza) const {
+    for (Step step : kSteps) {
+      RunStep(step, pizza);
+    }
+  }
+
+  void RunStep(Step step, Pizza& pizza) const {
+    switch (step) {
+      case Step::kMakeDough:
+        MakeDough(pizza);
+        break;
+      case Step::kPutTomatoSauce:
+        PutTomatoSauce(pizza);
+        break;
+      case Step::kPutCheese:
+        PutCheese(pizza);
+        break;
+      case Step::kPutToppings:
+        PutToppings(pizza);
+        break;
+      case Step::kBake:
+        Bake(pizza);
+        break;
+    }
+  }
+
+ protected:
+  virtual void MakeDough(Pizza& pizza) const {
+    SimulateWork(std::chrono::microseconds(400));
+    pizza.layers.push_back(Ingredient::kDough);
+  }
+
+  virtual void PutToppings(Pizza&) const {
+    /*
+      Default implementation for putting toppings.
+      You may not put any toppings in some pizza types.
+    */
+  }
+
+ private:
+  void PutTomatoSauce(Pizza& pizza) const {
+    SimulateWork(std::chrono::microseconds(100));
+    pizza.layers.push_back(Ingredient::kTomatoSauce);
+  }
+
+  void PutCheese(Pizza& pizza) const {
+    SimulateWork(std::chrono::microseconds(100));
+    pizza.layers.push_back(Ingredient::kCheese);
+  }
+
+  void Bake(Pizza& pizza) const {
+    SimulateWork(std::chrono::microseconds(1000));
+    pizza.baked = true;
+  }
+};
+
+// For Cheese Pizza, we can use the default implementation
+class CheesePizzaMaker : public PizzaMaker {};
+
+class PepperoniPizzaMaker : public PizzaMaker {
+ protected:
+  void PutToppings(Pizza& pizza) const override {
+    SimulateWork(std::chrono::microseconds(200));
+    pizza.layers.push_back(Ingredient::kPepperoni);
+  }
+};
+
+class CheeseCrustedPepperoniPizzaMaker : public PepperoniPizzaMaker {
+ protected:
+  void MakeDough(Pizza& pizza) const override {
+    SimulateWork(std::chrono::microseconds(600));
+    pizza.layers.push_back(Ingredient::kCheeseCrustedDough);
+  }
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct Order {
+  size_t id;
+  const PizzaMaker* maker;
+  Pizza pizza;
+};
+
+/*
+  Blocking bounded queue. Close() lets consumers drain what is left and then stop.
+*/
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity), closed_(false), max_depth_(0) {}
+
+  void Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this]() { return items_.size() < capacity_; });
+    items_.push_back(std::move(item));
+    max_depth_ = std::max(max_depth_, items_.size());
+    lock.unlock();
+    not_empty_.notify_one();
+  }
+
+  // Returns false once the queue is closed and empty.
+  bool Pop(T& item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return false;
+    }
+    item = std::move(items_.front());
+    items_.pop_front();
+    lock.unlock();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+  }
+
+  size_t depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return items_.size();
+  }
+
+  size_t max_depth() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return max_depth_;
+  }
+
+ private:
+  const size_t capacity_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<T> items_;
+  bool closed_;
+  size_t max_depth_;
+};
+
+struct StageStats {
+  long long processed;
+  std::chrono::nanoseconds busy;  // Summed over the stage's workers
+  size_t queue_depth;
+  size_t max_queue_depth;
+};
+
+class Kitchen {
+ public:
+  static constexpr size_t kNumStages = PizzaMaker::kSteps.size();
+
+  struct StageConfig {
+    size_t workers;
+    size_t queue_capacity;
+  };
+
+  // Throws std::invalid_argument if a stage has no workers or a queue capacity of 0: the stage
+  // could then never pass pizzas on, and Collect would wait forever.
+  explicit Kitchen(const std::array<StageConfig, kNumStages>& config) : next_id_(0) {
+    for (const StageConfig& stage : config) {
+      if (stage.workers == 0 || stage.queue_capacity == 0) {
+        throw std::invalid_argument("Every stage needs a worker and a queue capacity");
+      }
+    }
+    for (size_t i = 0; i < kNumStages; ++i) {
+      stages_.emplace_back(new Stage(PizzaMaker::kSteps[i], config[i]));
+    }
+    done_ = std::make_unique<BoundedQueue<Order>>(SIZE_MAX);
+    for (size_t i = 0; i < kNumStages; ++i) {
+      BoundedQueue<Order>* output = i + 1 < kNumStages ? &stages_[i + 1]->input : done_.get();
+      stages_[i]->Start(output);
+    }
+  }
+
+  ~Kitchen() {
+    Close();
+    for (auto& stage : stages_) {
+      stage->Join();
+    }
+  }
+
+  // Blocks while the first stage's queue is full. Returns the order id. May be called from
+  // several threads.
+  size_t Submit(const PizzaMaker* maker) {
+    size_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    stages_.front()->input.Push(Order{id, maker, Pizza()});
+    return id;
+  }
+
+  // No more orders. Pizzas already submitted are still finished.
+  void Close() {
+    stages_.front()->input.Close();
+  }
+
+  // Waits for the next finished pizza. Returns false once closed and everything is collected.
+  bool Collect(Order& order) {
+    return done_->Pop(order);
+  }
+
+  StageStats stats(size_t stage) const {
+    const Stage& s = *stages_[stage];
+    return {s.processed.load(), std::chrono::nanoseconds(s.busy_ns.load()), s.input.depth(),
+            s.input.max_depth()};
+  }
+
+  size_t workers(size_t stage) const {
+    return stages_[stage]->workers.size();
+  }
+
+ private:
+  struct Stage {
+    Stage(PizzaMaker::Step step, const StageConfig& config) :
+        step(step),
+        num_workers(config.workers),
+        input(config.queue_capacity),
+        active_workers(config.workers),
+        processed(0),
+        busy_ns(0) {}
+
+    void Start(BoundedQueue<Order>* output) {
+      for (size_t i = 0; i < num_workers; ++i) {
+        workers.emplace_back([this, output]() {
+          Order order;
+          while (input.Pop(order)) {
+            auto start = Clock::now();
+            order.maker->RunStep(step, order.pizza);
+            busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start)
+                           .count();
+            processed++;
+            output->Push(std::move(order));
+          }
+          // The last worker to finish closes the next stage.
+          if (--active_workers == 0) {
+            output->Close();
+          }
+        });
+      }
+    }
+
+    void Join() {
+      for (auto& worker : workers) {
+        worker.join();
+      }
+      workers.clear();
+    }
+
+    const PizzaMaker::Step step;
+    const size_t num_workers;
+    BoundedQueue<Order> input;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> active_workers;
+    std::atomic<long long> processed;
+    std::atomic<long long> busy_ns;
+  };
+
+  std::vector<std::unique_ptr<Stage>> stages_;
+  std::unique_ptr<BoundedQueue<Order>> done_;  // Finished pizzas
+  std::atomic<size_t> next_id_;
+};
+
+const char* kStageNames[] = {"MakeDough", "PutTomatoSauce", "PutCheese", "PutToppings", "Bake"};
+
+struct LatencySummary {
+  double average_ms;
+  double p99_ms;
+};
+
+LatencySummary Summarize(std::vector<double> latencies_ms) {
+  std::sort(latencies_ms.begin(), latencies_ms.end());
+  double total = 0;
+  for (double latency : latencies_ms) {
+    total += latency;
+  }
+  return {total / latencies_ms.size(), latencies_ms[latencies_ms.size() * 99 / 100]};
+}
+
+int main() {
+  CheesePizzaMaker cheese_pizza_maker;
+  PepperoniPizzaMaker pepperoni_pizza_maker;
+  CheeseCrustedPepperoniPizzaMaker cheese_crusted_pepperoni_pizza_maker;
+  std::array<const PizzaMaker*, 3> makers = {&cheese_pizza_maker, &pepperoni_pizza_maker,
+                                             &cheese_crusted_pepperoni_pizza_maker};
+
+  {
+    Kitchen kitchen({{{1, 4}, {1, 4}, {1, 4}, {1, 4}, {1, 4}}});
+    for (const PizzaMaker* maker : makers) {
+      kitchen.Submit(maker);
+    }
+    kitchen.Close();
+    Order order;
+    while (kitchen.Collect(order)) {
+      std::cout << "Pizza #" << order.id << ":\n";
+      Describe(order.pizza);
+      std::cout << "\n";
+    }
+  }
+
+  std::cout << "----------------------------------\n";
+
+  const size_t kPizzas = 300;
+
+  {
+    // One cook, one pizza at a time, as in part2.
+    std::vector<double> latencies_ms;
+    auto start_time = Clock::now();
+    for (size_t i = 0; i < kPizzas; ++i) {
+      Pizza pizza;
+      auto submitted = Clock::now();
+      makers[i % makers.size()]->Make(pizza);
+      latencies_ms.push_back(
+          std::chrono::duration<double, std::milli>(Clock::now() - submitted).count());
+    }
+    std::chrono::duration<double> duration = Clock::now() - start_time;
+    // All orders arrive at the start, so latency includes waiting for earlier pizzas.
+    for (size_t i = 1; i < latencies_ms.size(); ++i) {
+      latencies_ms[i] += latencies_ms[i - 1];
+    }
+    LatencySummary latency = Summarize(latencies_ms);
+    std::cout << "Sequential Make      | pizzas/sec = "
+              << static_cast<long long>(kPizzas / duration.count())
+              << ", latency avg = " << latency.average_ms << " ms, p99 = " << latency.p99_ms
+              << " ms\n";
+  }
+
+  auto run_kitchen = [&](const std::string& label,
+                         const std::array<Kitchen::StageConfig, Kitchen::kNumStages>& config) {
+    Kitchen kitchen(config);
+    auto start_time = Clock::now();
+    std::thread producer([&]() {
+      for (size_t i = 0; i < kPizzas; ++i) {
+        kitchen.Submit(makers[i % makers.size()]);
+      }
+      kitchen.Close();
+    });
+
+    std::vector<double> latencies_ms;
+    Order order;
+    while (kitchen.Collect(order)) {
+      latencies_ms.push_back(
+          std::chrono::duration<double, std::milli>(Clock::now() - start_time).count());
+    }
+    std::chrono::duration<double> duration = Clock::now() - start_time;
+    producer.join();
+
+    LatencySummary latency = Summarize(latencies_ms);
+    std::cout << label << " | pizzas/sec = " << static_cast<long long>(kPizzas / duration.count())
+              << ", latency avg = " << latency.average_ms << " ms, p99 = " << latency.p99_ms
+              << " ms\n";
+    for (size_t stage = 0; stage < Kitchen::kNumStages; ++stage) {
+      StageStats stats = kitchen.stats(stage);
+      double utilization = std::chrono::duration<double>(stats.busy).count() /
+                           (duration.count() * kitchen.workers(stage));
+      std::cout << "  " << kStageNames[stage] << ": workers = " << kitchen.workers(stage)
+                << ", pizzas/sec = " << static_cast<long long>(stats.processed / duration.count())
+                << ", utilization = " << static_cast<int>(utilization * 100)
+                << "%, max queue depth = " << stats.max_queue_depth << "\n";
+    }
+  };
+
+  run_kitchen("Pipeline, 1 worker  ", {{{1, 8}, {1, 8}, {1, 8}, {1, 8}, {1, 8}}});
+  run_kitchen("Pipeline, 4 ovens   ", {{{2, 8}, {1, 8}, {1, 8}, {1, 8}, {4, 8}}});
+  return 0;
+}
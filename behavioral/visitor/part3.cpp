@@ -0,0 +1,511 @@
+/*
+  Visitor without double virtual dispatch.
+
+  In part2, every animal is allocated on its own, and visiting it costs two indirect calls:
+  the virtual Accept, then the virtual Visit overload it picks. Visiting a large zoo spends
+  its time chasing pointers to scattered objects and through vtables, and species() copies a
+  std::string per call.
+
+  Here:
+
+  - The set of animal kinds is closed (land, water, bird), so an animal is a
+    std::variant<LandAnimal, WaterAnimal, Bird> stored by value. The Zoo keeps all of them
+    in one contiguous vector, and animals hold no pointers and need no virtual destructor.
+
+  - A visitor is any type with an operator() overload per kind. Zoo::VisitAll dispatches with
+    std::visit, and Zoo::VisitAllSwitch with a plain switch on the variant index. Both resolve
+    the overload at compile time, so the visitor body inlines into the loop. Adding a new
+    operation still needs no change to the animal classes.
+
+  - The species is a one-byte enum, and species() returns a std::string_view into a static
+    table, so an animal is 16 bytes and reading its species allocates nothing.
+
+  The price: adding a new animal kind means changing AnyAnimal, and every visitor that lacks
+  the new overload stops compiling (which is also what part2 does with a pure virtual Visit).
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// Part2 visitor, kept as the baseline for the benchmark.
+namespace double_dispatch {
+
+class LandAnimal;
+class WaterAnimal;
+class Bird;
+
+class Visitor {
+ public:
+  virtual ~Visitor() = default;
+
+  virtual void Visit(const LandAnimal* land_animal) = 0;
+  virtual void Visit(const WaterAnimal* water_animal) = 0;
+  virtual void Visit(const Bird* bird) = 0;
+};
+
+class Animal {
+ public:
+  Animal(std::string species, int age, int size) : species_(species), age_(age), size_(size) {}
+
+  virtual ~Animal() = default;
+
+  std::string species() const {
+    return species_;
+  }
+
+  int age() const {
+    return age_;
+  }
+
+  int size() const {
+    return size_;
+  }
+
+  virtual void Accept(Visitor* visitor) const = 0;
+
+ private:
+  std::string species_;
+  int age_;
+  int size_;
+};
+
+class LandAnimal : public Animal {
+ public:
+  LandAnimal(std::string species, int age, int size, int sprint_speed) :
+      Animal(species, age, size), sprint_speed_(sprint_speed) {}
+
+  int sprint_speed() const {
+    return sprint_speed_;
+  }
+
+  void Accept(Visitor* visitor) const override {
+    visitor->Visit(this);
+  }
+
+ private:
+  int sprint_speed_;
+};
+
+class WaterAnimal : public Animal {
+ public:
+  WaterAnimal(std::string species, int age, int size, int swim_speed) :
+      Animal(species, age, size), swim_speed_(swim_speed) {}
+
+  int swim_speed() const {
+    return swim_speed_;
+  }
+
+  void Accept(Visitor* visitor) const override {
+    visitor->Visit(this);
+  }
+
+ private:
+  int swim_speed_;
+};
+
+class Bird : public Animal {
+ public:
+  Bird(std::string species, int age, int size, int fly_speed) :
+      Animal(species, age, size), fly_speed_(fly_speed) {}
+
+  int fly_speed() const {
+    return fly_speed_;
+  }
+
+  void Accept(Visitor* visitor) const override {
+    visitor->Visit(this);
+  }
+
+ private:
+  int fly_speed_;
+};
+
+// Sums what a typical report needs: sizes, and speeds per kind.
+class StatsVisitor : public Visitor {
+ public:
+  void Visit(const LandAnimal* land_animal) override {
+    total_size += land_animal->size();
+    total_sprint_speed += land_animal->sprint_speed();
+    ++num_land_animals;
+  }
+
+  void Visit(const WaterAnimal* water_animal) override {
+    total_size += water_animal->size();
+    total_swim_speed += water_animal->swim_speed();
+    ++num_water_animals;
+  }
+
+  void Visit(const Bird* bird) override {
+    total_size += bird->size();
+    total_fly_speed += bird->fly_speed();
+    ++num_birds;
+  }
+
+  uint64_t total_size = 0;
+  uint64_t total_sprint_speed = 0;
+  uint64_t total_swim_speed = 0;
+  uint64_t total_fly_speed = 0;
+  uint64_t num_land_animals = 0;
+  uint64_t num_water_animals = 0;
+  uint64_t num_birds = 0;
+};
+
+}  // namespace double_dispatch
+
+enum class Species : uint8_t { kDog, kCat, kShark, kDolphin, kEagle, kSparrow };
+
+constexpr std::string_view kSpeciesNames[] = {"Dog", "Cat", "Shark", "Dolphin", "Eagle", "Sparrow"};
+
+class Animal {
+ public:
+  Animal(Species species, int age, int size);
+
+  std::string_view species() const;
+
+  int age() const;
+
+  int size() const;
+
+ private:
+  Species species_;
+  int age_;
+  int size_;
+};
+
+class LandAnimal : public Animal {
+ public:
+  LandAnimal(Species species, int age, int size, int sprint_speed);
+
+  int sprint_speed() const;
+
+ private:
+  int sprint_speed_;
+};
+
+class WaterAnimal : public Animal {
+ public:
+  WaterAnimal(Species species, int age, int size, int swim_speed);
+
+  int swim_speed() const;
+
+ private:
+  int swim_speed_;
+};
+
+class Bird : public Animal {
+ public:
+  Bird(Species species, int age, int size, int fly_speed);
+
+  int fly_speed() const;
+
+ private:
+  int fly_speed_;
+};
+
+using AnyAnimal = std::variant<LandAnimal, WaterAnimal, Bird>;
+
+/*
+  Owns the animals by value, in insertion order.
+
+  Concrete animals (Dog, Cat, ...) add no data to their kind, so storing them as the kind
+  loses nothing.
+*/
+class Zoo {
+ public:
+  void Reserve(size_t num_animals);
+
+  void Add(const AnyAnimal& animal);
+
+  size_t size() const;
+
+  template <typename Visitor>
+  void VisitAll(Visitor& visitor) const {
+    for (const AnyAnimal& animal : animals_) {
+      std::visit(visitor, animal);
+    }
+  }
+
+  // Same as VisitAll, without relying on how the standard library implements std::visit.
+  template <typename Visitor>
+  void VisitAllSwitch(Visitor& visitor) const {
+    for (const AnyAnimal& animal : animals_) {
+      switch (animal.index()) {
+        case 0:
+          visitor(*std::get_if<LandAnimal>(&animal));
+          break;
+        case 1:
+          visitor(*std::get_if<WaterAnimal>(&animal));
+          break;
+        case 2:
+          visitor(*std::get_if<Bird>(&animal));
+          break;
+      }
+    }
+  }
+
+ private:
+  std::vector<AnyAnimal> animals_;
+};
+
+class PrintVisitor {
+ public:
+  void operator()(const LandAnimal& land_animal) const;
+  void operator()(const WaterAnimal& water_animal) const;
+  void operator()(const Bird& bird) const;
+};
+
+// Same sums as double_dispatch::StatsVisitor.
+class StatsVisitor {
+ public:
+  void operator()(const LandAnimal& land_animal) {
+    total_size += land_animal.size();
+    total_sprint_speed += land_animal.sprint_speed();
+    ++num_land_animals;
+  }
+
+  void operator()(const WaterAnimal& water_animal) {
+    total_size += water_animal.size();
+    total_swim_speed += water_animal.swim_speed();
+    ++num_water_animals;
+  }
+
+  void operator()(const Bird& bird) {
+    total_size += bird.size();
+    total_fly_speed += bird.fly_speed();
+    ++num_birds;
+  }
+
+  uint64_t total_size = 0;
+  uint64_t total_sprint_speed = 0;
+  uint64_t total_swim_speed = 0;
+  uint64_t total_fly_speed = 0;
+  uint64_t num_land_animals = 0;
+  uint64_t num_water_animals = 0;
+  uint64_t num_birds = 0;
+};
+
+// Implementation
+Animal::Animal(Species species, int age, int size) : species_(species), age_(age), size_(size) {}
+
+std::string_view Animal::species() const {
+  return kSpeciesNames[static_cast<uint8_t>(species_)];
+}
+
+int Animal::age() const {
+  return age_;
+}
+
+int Animal::size() const {
+  return size_;
+}
+
+LandAnimal::LandAnimal(Species species, int age, int size, int sprint_speed) :
+    Animal(species, age, size), sprint_speed_(sprint_speed) {}
+
+int LandAnimal::sprint_speed() const {
+  return sprint_speed_;
+}
+
+WaterAnimal::WaterAnimal(Species species, int age, int size, int swim_speed) :
+    Animal(species, age, size), swim_speed_(swim_speed) {}
+
+int WaterAnimal::swim_speed() const {
+  return swim_speed_;
+}
+
+Bird::Bird(Species species, int age, int size, int fly_speed) :
+    Animal(species, age, size), fly_speed_(fly_speed) {}
+
+int Bird::fly_speed() const {
+  return fly_speed_;
+}
+
+void Zoo::Reserve(size_t num_animals) {
+  animals_.reserve(num_animals);
+}
+
+void Zoo::Add(const AnyAnimal& animal) {
+  animals_.push_back(animal);
+}
+
+size_t Zoo::size() const {
+  return animals_.size();
+}
+
+void PrintVisitor::operator()(const LandAnimal& land_animal) const {
+  std::cout << "Land Animal: Species = " << land_animal.species()
+            << ", Age = " << land_animal.age() << ", Size = " << land_animal.size()
+            << ", Sprint Speed = " << land_animal.sprint_speed() << "\n";
+}
+
+void PrintVisitor::operator()(const WaterAnimal& water_animal) const {
+  std::cout << "Water Animal: Species = " << water_animal.species()
+            << ", Age = " << water_animal.age() << ", Size = " << water_animal.size()
+            << ", Swim Speed = " << water_animal.swim_speed() << "\n";
+}
+
+void PrintVisitor::operator()(const Bird& bird) const {
+  std::cout << "Bird: Species = " << bird.species() << ", Age = " << bird.age()
+            << ", Size = " << bird.size() << ", Fly Speed = " << bird.fly_speed() << "\n";
+}
+
+// Specific animal classes
+
+class Dog : public LandAnimal {
+ public:
+  Dog(int age, int size, int sprint_speed) : LandAnimal(Species::kDog, age, size, sprint_speed) {}
+};
+
+class Cat : public LandAnimal {
+ public:
+  Cat(int age, int size, int sprint_speed) : LandAnimal(Species::kCat, age, size, sprint_speed) {}
+};
+
+class Shark : public WaterAnimal {
+ public:
+  Shark(int age, int size, int swim_speed) :
+      WaterAnimal(Species::kShark, age, size, swim_speed) {}
+};
+
+class Dolphin : public WaterAnimal {
+ public:
+  Dolphin(int age, int size, int swim_speed) :
+      WaterAnimal(Species::kDolphin, age, size, swim_speed) {}
+};
+
+class Eagle : public Bird {
+ public:
+  Eagle(int age, int size, int fly_speed) : Bird(Species::kEagle, age, size, fly_speed) {}
+};
+
+class Sparrow : public Bird {
+ public:
+  Sparrow(int age, int size, int fly_speed) : Bird(Species::kSparrow, age, size, fly_speed) {}
+};
+
+static_assert(sizeof(Dog) == sizeof(LandAnimal), "Storing a Dog as LandAnimal must lose nothing");
+static_assert(sizeof(Eagle) == sizeof(Bird), "Storing an Eagle as Bird must lose nothing");
+
+// Benchmark
+
+struct AnimalSpec {
+  Species species;
+  int age;
+  int size;
+  int speed;
+};
+
+std::vector<AnimalSpec> RandomAnimals(size_t count) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> species(0, 5);
+  std::uniform_int_distribution<int> value(1, 100);
+  std::vector<AnimalSpec> specs(count);
+  for (AnimalSpec& spec : specs) {
+    spec = {static_cast<Species>(species(rng)), value(rng), value(rng), value(rng)};
+  }
+  return specs;
+}
+
+template <typename Stats>
+uint64_t Checksum(const Stats& stats) {
+  return stats.total_size + stats.total_sprint_speed * 3 + stats.total_swim_speed * 5 +
+         stats.total_fly_speed * 7 + stats.num_land_animals + stats.num_water_animals * 11 +
+         stats.num_birds * 13;
+}
+
+template <typename VisitAll>
+void Measure(const char* label, size_t num_animals, VisitAll visit_all) {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  uint64_t checksum = visit_all();
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  std::cout << label << " | " << num_animals / duration.count() / 1e6
+            << " M visits/s, checksum = " << checksum << "\n";
+}
+
+int main() {
+  PrintVisitor print_visitor;
+  Zoo zoo;
+  zoo.Add(Dog(5, 30, 60));
+  zoo.Add(Cat(3, 10, 50));
+  zoo.Add(Shark(8, 200, 40));
+  zoo.Add(Dolphin(6, 150, 30));
+  zoo.Add(Eagle(4, 5, 100));
+  zoo.Add(Sparrow(2, 1, 20));
+  zoo.VisitAll(print_visitor);
+
+  constexpr size_t kNumAnimals = 10'000'000;
+  std::vector<AnimalSpec> specs = RandomAnimals(kNumAnimals);
+
+  std::vector<std::unique_ptr<double_dispatch::Animal>> old_zoo;
+  old_zoo.reserve(kNumAnimals);
+  for (const AnimalSpec& spec : specs) {
+    std::string species(kSpeciesNames[static_cast<uint8_t>(spec.species)]);
+    switch (spec.species) {
+      case Species::kDog:
+      case Species::kCat:
+        old_zoo.push_back(std::make_unique<double_dispatch::LandAnimal>(species, spec.age,
+                                                                        spec.size, spec.speed));
+        break;
+      case Species::kShark:
+      case Species::kDolphin:
+        old_zoo.push_back(std::make_unique<double_dispatch::WaterAnimal>(species, spec.age,
+                                                                         spec.size, spec.speed));
+        break;
+      case Species::kEagle:
+      case Species::kSparrow:
+        old_zoo.push_back(
+            std::make_unique<double_dispatch::Bird>(species, spec.age, spec.size, spec.speed));
+        break;
+    }
+  }
+
+  Zoo big_zoo;
+  big_zoo.Reserve(kNumAnimals);
+  for (const AnimalSpec& spec : specs) {
+    switch (spec.species) {
+      case Species::kDog:
+      case Species::kCat:
+        big_zoo.Add(LandAnimal(spec.species, spec.age, spec.size, spec.speed));
+        break;
+      case Species::kShark:
+      case Species::kDolphin:
+        big_zoo.Add(WaterAnimal(spec.species, spec.age, spec.size, spec.speed));
+        break;
+      case Species::kEagle:
+      case Species::kSparrow:
+        big_zoo.Add(Bird(spec.species, spec.age, spec.size, spec.speed));
+        break;
+    }
+  }
+
+  std::cout << "Visiting " << kNumAnimals << " animals in random kind order (part2 animal: "
+            << sizeof(double_dispatch::LandAnimal) << " bytes + allocation, variant: "
+            << sizeof(AnyAnimal) << " bytes):\n";
+  Measure("Accept(Visitor*) (part2)", kNumAnimals, [&] {
+    double_dispatch::StatsVisitor stats;
+    for (const auto& animal : old_zoo) {
+      animal->Accept(&stats);
+    }
+    return Checksum(stats);
+  });
+  Measure("std::visit              ", kNumAnimals, [&] {
+    StatsVisitor stats;
+    big_zoo.VisitAll(stats);
+    return Checksum(stats);
+  });
+  Measure("Index switch            ", kNumAnimals, [&] {
+    StatsVisitor stats;
+    big_zoo.VisitAllSwitch(stats);
+    return Checksum(stats);
+  });
+  return 0;
+}
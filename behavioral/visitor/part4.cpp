@@ -0,0 +1,486 @@
+/*
+  Visitor over columns.
+
+  Part2 visits animals one object at a time: a virtual Accept, then a virtual Visit, for each
+  animal, in whatever order the kinds happen to be stored. An aggregation such as "average sprint
+  speed" is a handful of additions per animal, buried under two indirect calls, a pointer chase
+  and a branch the CPU cannot predict.
+
+  Here:
+
+  - ColumnarZoo stores animals partitioned by species, and each species as three columns
+    (ages, sizes, speeds) instead of an array of objects. Adding an animal appends to the
+    columns of its species. Insertion order across species is not kept.
+
+  - A ColumnVisitor still has one Visit overload per kind, as in part2, but each call receives
+    all animals of one species as arrays (LandAnimals, WaterAnimals or Birds). Accept makes at
+    most one virtual call per species, so dispatch cost no longer depends on the zoo size.
+
+  - Inside Visit, an aggregation is a plain loop over contiguous ints that reads only the
+    columns it needs, which the compiler can vectorize.
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Part2 visitor, kept as the baseline for the benchmark.
+namespace double_dispatch {
+
+class LandAnimal;
+class WaterAnimal;
+class Bird;
+
+class Visitor {
+ public:
+  virtual ~Visitor() = default;
+
+  virtual void Visit(const LandAnimal* land_animal) = 0;
+  virtual void Visit(const WaterAnimal* water_animal) = 0;
+  virtual void Visit(const Bird* bird) = 0;
+};
+
+class Animal {
+ public:
+  Animal(std::string species, int age, int size) : species_(species), age_(age), size_(size) {}
+
+  virtual ~Animal() = default;
+
+  std::string species() const {
+    return species_;
+  }
+
+  int age() const {
+    return age_;
+  }
+
+  int size() const {
+    return size_;
+  }
+
+  virtual void Accept(Visitor* visitor) const = 0;
+
+ private:
+  std::string species_;
+  int age_;
+  int size_;
+};
+
+class LandAnimal : public Animal {
+ public:
+  LandAnimal(std::string species, int age, int size, int sprint_speed) :
+      Animal(species, age, size), sprint_speed_(sprint_speed) {}
+
+  int sprint_speed() const {
+    return sprint_speed_;
+  }
+
+  void Accept(Visitor* visitor) const override {
+    visitor->Visit(this);
+  }
+
+ private:
+  int sprint_speed_;
+};
+
+class WaterAnimal : public Animal {
+ public:
+  WaterAnimal(std::string species, int age, int size, int swim_speed) :
+      Animal(species, age, size), swim_speed_(swim_speed) {}
+
+  int swim_speed() const {
+    return swim_speed_;
+  }
+
+  void Accept(Visitor* visitor) const override {
+    visitor->Visit(this);
+  }
+
+ private:
+  int swim_speed_;
+};
+
+class Bird : public Animal {
+ public:
+  Bird(std::string species, int age, int size, int fly_speed) :
+      Animal(species, age, size), fly_speed_(fly_speed) {}
+
+  int fly_speed() const {
+    return fly_speed_;
+  }
+
+  void Accept(Visitor* visitor) const override {
+    visitor->Visit(this);
+  }
+
+ private:
+  int fly_speed_;
+};
+
+class AverageSprintSpeedVisitor : public Visitor {
+ public:
+  void Visit(const LandAnimal* land_animal) override {
+    total_sprint_speed_ += land_animal->sprint_speed();
+    ++num_land_animals_;
+  }
+
+  void Visit(const WaterAnimal*) override {}
+
+  void Visit(const Bird*) override {}
+
+  double average_sprint_speed() const {
+    if (num_land_animals_ == 0) {
+      return 0.0;
+    }
+    return static_cast<double>(total_sprint_speed_) / num_land_animals_;
+  }
+
+ private:
+  int64_t total_sprint_speed_ = 0;
+  int64_t num_land_animals_ = 0;
+};
+
+class SizeHistogramVisitor : public Visitor {
+ public:
+  static constexpr int kBucketWidth = 10;
+  static constexpr int kNumBuckets = 11;
+
+  void Visit(const LandAnimal* land_animal) override {
+    Count(land_animal->size());
+  }
+
+  void Visit(const WaterAnimal* water_animal) override {
+    Count(water_animal->size());
+  }
+
+  void Visit(const Bird* bird) override {
+    Count(bird->size());
+  }
+
+  const std::array<int64_t, kNumBuckets>& buckets() const {
+    return buckets_;
+  }
+
+ private:
+  void Count(int size) {
+    ++buckets_[std::clamp(size / kBucketWidth, 0, kNumBuckets - 1)];
+  }
+
+  std::array<int64_t, kNumBuckets> buckets_{};
+};
+
+}  // namespace double_dispatch
+
+enum class Species : uint8_t { kDog, kCat, kShark, kDolphin, kEagle, kSparrow };
+
+constexpr size_t kNumSpecies = 6;
+
+constexpr std::string_view kSpeciesNames[kNumSpecies] = {"Dog",     "Cat",   "Shark",
+                                                         "Dolphin", "Eagle", "Sparrow"};
+
+// All animals of one species. Row i of every column describes the same animal.
+struct Columns {
+  std::string_view species;
+  size_t count;
+  const int32_t* ages;
+  const int32_t* sizes;
+  const int32_t* speeds;
+};
+
+// speeds are sprint speeds.
+struct LandAnimals : Columns {};
+
+// speeds are swim speeds.
+struct WaterAnimals : Columns {};
+
+// speeds are fly speeds.
+struct Birds : Columns {};
+
+class ColumnVisitor {
+ public:
+  virtual ~ColumnVisitor() = default;
+
+  virtual void Visit(const LandAnimals& land_animals) = 0;
+  virtual void Visit(const WaterAnimals& water_animals) = 0;
+  virtual void Visit(const Birds& birds) = 0;
+};
+
+class ColumnarZoo {
+ public:
+  void Add(Species species, int age, int size, int speed);
+
+  size_t size() const;
+
+  // Calls visitor once per species that has animals.
+  void Accept(ColumnVisitor* visitor) const;
+
+ private:
+  struct SpeciesColumns {
+    std::vector<int32_t> ages;
+    std::vector<int32_t> sizes;
+    std::vector<int32_t> speeds;
+  };
+
+  std::array<SpeciesColumns, kNumSpecies> columns_;
+};
+
+class PrintVisitor : public ColumnVisitor {
+ public:
+  void Visit(const LandAnimals& land_animals) override;
+  void Visit(const WaterAnimals& water_animals) override;
+  void Visit(const Birds& birds) override;
+};
+
+class AverageSprintSpeedVisitor : public ColumnVisitor {
+ public:
+  void Visit(const LandAnimals& land_animals) override;
+  void Visit(const WaterAnimals&) override {}
+  void Visit(const Birds&) override {}
+
+  double average_sprint_speed() const;
+
+ private:
+  int64_t total_sprint_speed_ = 0;
+  int64_t num_land_animals_ = 0;
+};
+
+class SizeHistogramVisitor : public ColumnVisitor {
+ public:
+  static constexpr int kBucketWidth = 10;
+  // The first bucket also takes negative sizes, the last one sizes of 100 and above.
+  static constexpr int kNumBuckets = 11;
+
+  void Visit(const LandAnimals& land_animals) override;
+  void Visit(const WaterAnimals& water_animals) override;
+  void Visit(const Birds& birds) override;
+
+  const std::array<int64_t, kNumBuckets>& buckets() const;
+
+ private:
+  void Count(const Columns& columns);
+
+  std::array<int64_t, kNumBuckets> buckets_{};
+};
+
+// Implementation
+void ColumnarZoo::Add(Species species, int age, int size, int speed) {
+  SpeciesColumns& columns = columns_[static_cast<uint8_t>(species)];
+  columns.ages.push_back(age);
+  columns.sizes.push_back(size);
+  columns.speeds.push_back(speed);
+}
+
+size_t ColumnarZoo::size() const {
+  size_t total = 0;
+  for (const SpeciesColumns& columns : columns_) {
+    total += columns.ages.size();
+  }
+  return total;
+}
+
+void ColumnarZoo::Accept(ColumnVisitor* visitor) const {
+  for (size_t i = 0; i < kNumSpecies; ++i) {
+    const SpeciesColumns& columns = columns_[i];
+    if (columns.ages.empty()) {
+      continue;
+    }
+    Columns view{kSpeciesNames[i], columns.ages.size(), columns.ages.data(),
+                 columns.sizes.data(), columns.speeds.data()};
+    switch (static_cast<Species>(i)) {
+      case Species::kDog:
+      case Species::kCat:
+        visitor->Visit(LandAnimals{view});
+        break;
+      case Species::kShark:
+      case Species::kDolphin:
+        visitor->Visit(WaterAnimals{view});
+        break;
+      case Species::kEagle:
+      case Species::kSparrow:
+        visitor->Visit(Birds{view});
+        break;
+    }
+  }
+}
+
+void PrintVisitor::Visit(const LandAnimals& land_animals) {
+  for (size_t i = 0; i < land_animals.count; ++i) {
+    std::cout << "Land Animal: Species = " << land_animals.species
+              << ", Age = " << land_animals.ages[i] << ", Size = " << land_animals.sizes[i]
+              << ", Sprint Speed = " << land_animals.speeds[i] << "\n";
+  }
+}
+
+void PrintVisitor::Visit(const WaterAnimals& water_animals) {
+  for (size_t i = 0; i < water_animals.count; ++i) {
+    std::cout << "Water Animal: Species = " << water_animals.species
+              << ", Age = " << water_animals.ages[i] << ", Size = " << water_animals.sizes[i]
+              << ", Swim Speed = " << water_animals.speeds[i] << "\n";
+  }
+}
+
+void PrintVisitor::Visit(const Birds& birds) {
+  for (size_t i = 0; i < birds.count; ++i) {
+    std::cout << "Bird: Species = " << birds.species << ", Age = " << birds.ages[i]
+              << ", Size = " << birds.sizes[i] << ", Fly Speed = " << birds.speeds[i] << "\n";
+  }
+}
+
+void AverageSprintSpeedVisitor::Visit(const LandAnimals& land_animals) {
+  int64_t total = 0;
+  for (size_t i = 0; i < land_animals.count; ++i) {
+    total += land_animals.speeds[i];
+  }
+  total_sprint_speed_ += total;
+  num_land_animals_ += land_animals.count;
+}
+
+double AverageSprintSpeedVisitor::average_sprint_speed() const {
+  if (num_land_animals_ == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(total_sprint_speed_) / num_land_animals_;
+}
+
+void SizeHistogramVisitor::Visit(const LandAnimals& land_animals) {
+  Count(land_animals);
+}
+
+void SizeHistogramVisitor::Visit(const WaterAnimals& water_animals) {
+  Count(water_animals);
+}
+
+void SizeHistogramVisitor::Visit(const Birds& birds) {
+  Count(birds);
+}
+
+const std::array<int64_t, SizeHistogramVisitor::kNumBuckets>& SizeHistogramVisitor::buckets()
+    const {
+  return buckets_;
+}
+
+void SizeHistogramVisitor::Count(const Columns& columns) {
+  // Consecutive animals often land in the same bucket; spreading them over four copies of the
+  // histogram keeps one increment from waiting for the previous one.
+  std::array<std::array<int64_t, kNumBuckets>, 4> partial{};
+  size_t i = 0;
+  for (; i + 4 <= columns.count; i += 4) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      ++partial[lane][std::clamp(columns.sizes[i + lane] / kBucketWidth, 0, kNumBuckets - 1)];
+    }
+  }
+  for (; i < columns.count; ++i) {
+    ++partial[0][std::clamp(columns.sizes[i] / kBucketWidth, 0, kNumBuckets - 1)];
+  }
+  for (int bucket = 0; bucket < kNumBuckets; ++bucket) {
+    buckets_[bucket] +=
+        partial[0][bucket] + partial[1][bucket] + partial[2][bucket] + partial[3][bucket];
+  }
+}
+
+// Benchmark
+
+template <typename Run>
+void Measure(const char* label, size_t num_animals, Run run) {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  uint64_t checksum = run();
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double, std::nano> duration = end_time - start_time;
+
+  std::cout << label << " | " << duration.count() / num_animals
+            << " ns/animal, checksum = " << checksum << "\n";
+}
+
+template <typename Histogram>
+uint64_t HistogramChecksum(const Histogram& histogram) {
+  uint64_t checksum = 0;
+  for (int64_t bucket : histogram.buckets()) {
+    checksum = checksum * 31 + bucket;
+  }
+  return checksum;
+}
+
+int main() {
+  ColumnarZoo zoo;
+  zoo.Add(Species::kDog, 5, 30, 60);
+  zoo.Add(Species::kCat, 3, 10, 50);
+  zoo.Add(Species::kShark, 8, 200, 40);
+  zoo.Add(Species::kDolphin, 6, 150, 30);
+  zoo.Add(Species::kEagle, 4, 5, 100);
+  zoo.Add(Species::kSparrow, 2, 1, 20);
+
+  PrintVisitor print_visitor;
+  zoo.Accept(&print_visitor);
+
+  AverageSprintSpeedVisitor average_visitor;
+  zoo.Accept(&average_visitor);
+  std::cout << "Average sprint speed: " << average_visitor.average_sprint_speed() << "\n";
+
+  constexpr size_t kNumAnimals = 10'000'000;
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> species_distribution(0, kNumSpecies - 1);
+  std::uniform_int_distribution<int> value(1, 120);
+
+  std::vector<std::unique_ptr<double_dispatch::Animal>> old_zoo;
+  old_zoo.reserve(kNumAnimals);
+  ColumnarZoo big_zoo;
+  for (size_t i = 0; i < kNumAnimals; ++i) {
+    auto species = static_cast<Species>(species_distribution(rng));
+    int age = value(rng);
+    int size = value(rng);
+    int speed = value(rng);
+    big_zoo.Add(species, age, size, speed);
+
+    std::string name(kSpeciesNames[static_cast<uint8_t>(species)]);
+    switch (species) {
+      case Species::kDog:
+      case Species::kCat:
+        old_zoo.push_back(std::make_unique<double_dispatch::LandAnimal>(name, age, size, speed));
+        break;
+      case Species::kShark:
+      case Species::kDolphin:
+        old_zoo.push_back(std::make_unique<double_dispatch::WaterAnimal>(name, age, size, speed));
+        break;
+      case Species::kEagle:
+      case Species::kSparrow:
+        old_zoo.push_back(std::make_unique<double_dispatch::Bird>(name, age, size, speed));
+        break;
+    }
+  }
+
+  std::cout << "Average sprint speed of " << kNumAnimals << " animals:\n";
+  Measure("Per-object visitor (part2)", kNumAnimals, [&] {
+    double_dispatch::AverageSprintSpeedVisitor visitor;
+    for (const auto& animal : old_zoo) {
+      animal->Accept(&visitor);
+    }
+    return static_cast<uint64_t>(visitor.average_sprint_speed() * 1e6);
+  });
+  Measure("Column visitor            ", kNumAnimals, [&] {
+    AverageSprintSpeedVisitor visitor;
+    big_zoo.Accept(&visitor);
+    return static_cast<uint64_t>(visitor.average_sprint_speed() * 1e6);
+  });
+
+  std::cout << "Size histogram of " << kNumAnimals << " animals:\n";
+  Measure("Per-object visitor (part2)", kNumAnimals, [&] {
+    double_dispatch::SizeHistogramVisitor visitor;
+    for (const auto& animal : old_zoo) {
+      animal->Accept(&visitor);
+    }
+    return HistogramChecksum(visitor);
+  });
+  Measure("Column visitor            ", kNumAnimals, [&] {
+    SizeHistogramVisitor visitor;
+    big_zoo.Accept(&visitor);
+    return HistogramChecksum(visitor);
+  });
+  return 0;
+}
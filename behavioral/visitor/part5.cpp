@@ -0,0 +1,577 @@
+/*
+  Visiting animals on several threads.
+
+  In part2, a visitor walks the animals one by one on the calling thread. For a large zoo, an
+  aggregating visitor is bound by one core, and PrintVisitor by one core formatting text.
+
+  Here:
+
+  - Visitor gets two hooks. Clone returns a new, empty visitor of the same type, and Merge
+    adds the results of such a clone into this visitor.
+
+  - VisitorPool::VisitAll splits the animals into chunks and gives every chunk its own clone,
+    visited on a pool of worker threads. The calling thread merges the clones in chunk order,
+    so Merge always receives the results of the animals right after the ones already merged.
+
+  - That is what keeps printing ordered: PrintVisitor formats into a string buffer, a clone
+    only buffers, and merging appends the clone's text to the output. The output is the same
+    as with a single thread, byte for byte.
+
+  - Only a bounded window of chunks is in flight at a time, so the buffered output of clones
+    does not grow with the size of the zoo.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LandAnimal;
+class WaterAnimal;
+class Bird;
+
+class Visitor {
+ public:
+  virtual ~Visitor() = default;
+
+  virtual void Visit(const LandAnimal* land_animal) = 0;
+  virtual void Visit(const WaterAnimal* water_animal) = 0;
+  virtual void Visit(const Bird* bird) = 0;
+
+  // Returns a visitor of the same type, with the same settings and no results yet.
+  virtual std::unique_ptr<Visitor> Clone() const = 0;
+
+  // Adds the results of other, which came from Clone and visited the animals that follow the
+  // ones this visitor has seen.
+  virtual void Merge(Visitor* other) = 0;
+};
+
+/*
+  Writes one line per animal to out. Text is buffered and written in large pieces; call Flush
+  (or destroy the visitor) to write the rest.
+*/
+class PrintVisitor : public Visitor {
+ public:
+  explicit PrintVisitor(std::ostream* out);
+
+  ~PrintVisitor() override;
+
+  void Visit(const LandAnimal* land_animal) override;
+  void Visit(const WaterAnimal* water_animal) override;
+  void Visit(const Bird* bird) override;
+
+  std::unique_ptr<Visitor> Clone() const override;
+  void Merge(Visitor* other) override;
+
+  void Flush();
+
+ private:
+  static constexpr size_t kFlushSize = 1 << 16;
+
+  void FlushIfFull();
+
+  std::ostream* out_;  // nullptr for clones, which only buffer
+  std::string buffer_;
+};
+
+// Counts animals and sums their sizes and speeds per kind.
+class StatsVisitor : public Visitor {
+ public:
+  void Visit(const LandAnimal* land_animal) override;
+  void Visit(const WaterAnimal* water_animal) override;
+  void Visit(const Bird* bird) override;
+
+  std::unique_ptr<Visitor> Clone() const override;
+  void Merge(Visitor* other) override;
+
+  uint64_t total_size = 0;
+  uint64_t total_sprint_speed = 0;
+  uint64_t total_swim_speed = 0;
+  uint64_t total_fly_speed = 0;
+  uint64_t num_land_animals = 0;
+  uint64_t num_water_animals = 0;
+  uint64_t num_birds = 0;
+};
+
+class Animal {
+ public:
+  Animal(std::string species, int age, int size);
+
+  virtual ~Animal() = default;
+
+  std::string species() const;
+
+  int age() const;
+
+  int size() const;
+
+  virtual void Accept(Visitor* visitor) const = 0;
+
+ private:
+  std::string species_;
+  int age_;
+  int size_;
+};
+
+class LandAnimal : public Animal {
+ public:
+  LandAnimal(std::string species, int age, int size, int sprint_speed);
+
+  int sprint_speed() const;
+
+  void Accept(Visitor* visitor) const override;
+
+ private:
+  int sprint_speed_;
+};
+
+class WaterAnimal : public Animal {
+ public:
+  WaterAnimal(std::string species, int age, int size, int swim_speed);
+
+  int swim_speed() const;
+
+  void Accept(Visitor* visitor) const override;
+
+ private:
+  int swim_speed_;
+};
+
+class Bird : public Animal {
+ public:
+  Bird(std::string species, int age, int size, int fly_speed);
+
+  int fly_speed() const;
+
+  void Accept(Visitor* visitor) const override;
+
+ private:
+  int fly_speed_;
+};
+
+class VisitorPool {
+ public:
+  explicit VisitorPool(size_t num_threads);
+
+  ~VisitorPool();
+
+  // Same result as calling animal->Accept(visitor) for every animal, in order.
+  void VisitAll(const std::vector<std::unique_ptr<Animal>>& animals, Visitor* visitor);
+
+  size_t size() const;
+
+ private:
+  static constexpr size_t kChunkSize = 1 << 14;
+  static constexpr size_t kChunksPerWorker = 4;  // In flight at a time
+
+  // Calls work(i) for every i in [0, count) on the workers and waits for all of them.
+  void RunBatch(size_t count, std::function<void(size_t)> work);
+
+  void Run();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  std::function<void(size_t)> work_;
+  uint64_t generation_;
+  size_t count_;
+  std::atomic<size_t> next_;
+  size_t remaining_;  // Workers still busy with the current batch
+  bool stopping_;
+};
+
+// Implementation
+PrintVisitor::PrintVisitor(std::ostream* out) : out_(out) {}
+
+PrintVisitor::~PrintVisitor() {
+  Flush();
+}
+
+void PrintVisitor::Visit(const LandAnimal* land_animal) {
+  buffer_ += "Land Animal: Species = " + land_animal->species();
+  buffer_ += ", Age = " + std::to_string(land_animal->age());
+  buffer_ += ", Size = " + std::to_string(land_animal->size());
+  buffer_ += ", Sprint Speed = " + std::to_string(land_animal->sprint_speed()) + "\n";
+  FlushIfFull();
+}
+
+void PrintVisitor::Visit(const WaterAnimal* water_animal) {
+  buffer_ += "Water Animal: Species = " + water_animal->species();
+  buffer_ += ", Age = " + std::to_string(water_animal->age());
+  buffer_ += ", Size = " + std::to_string(water_animal->size());
+  buffer_ += ", Swim Speed = " + std::to_string(water_animal->swim_speed()) + "\n";
+  FlushIfFull();
+}
+
+void PrintVisitor::Visit(const Bird* bird) {
+  buffer_ += "Bird: Species = " + bird->species();
+  buffer_ += ", Age = " + std::to_string(bird->age());
+  buffer_ += ", Size = " + std::to_string(bird->size());
+  buffer_ += ", Fly Speed = " + std::to_string(bird->fly_speed()) + "\n";
+  FlushIfFull();
+}
+
+std::unique_ptr<Visitor> PrintVisitor::Clone() const {
+  return std::make_unique<PrintVisitor>(nullptr);
+}
+
+void PrintVisitor::Merge(Visitor* other) {
+  std::string& text = static_cast<PrintVisitor*>(other)->buffer_;
+  if (buffer_.empty()) {
+    buffer_.swap(text);
+  } else {
+    buffer_ += text;
+  }
+  FlushIfFull();
+}
+
+void PrintVisitor::Flush() {
+  if (out_ != nullptr && !buffer_.empty()) {
+    out_->write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+  }
+}
+
+void PrintVisitor::FlushIfFull() {
+  if (buffer_.size() >= kFlushSize) {
+    Flush();
+  }
+}
+
+void StatsVisitor::Visit(const LandAnimal* land_animal) {
+  total_size += land_animal->size();
+  total_sprint_speed += land_animal->sprint_speed();
+  ++num_land_animals;
+}
+
+void StatsVisitor::Visit(const WaterAnimal* water_animal) {
+  total_size += water_animal->size();
+  total_swim_speed += water_animal->swim_speed();
+  ++num_water_animals;
+}
+
+void StatsVisitor::Visit(const Bird* bird) {
+  total_size += bird->size();
+  total_fly_speed += bird->fly_speed();
+  ++num_birds;
+}
+
+std::unique_ptr<Visitor> StatsVisitor::Clone() const {
+  return std::make_unique<StatsVisitor>();
+}
+
+void StatsVisitor::Merge(Visitor* other) {
+  const auto& stats = *static_cast<StatsVisitor*>(other);
+  total_size += stats.total_size;
+  total_sprint_speed += stats.total_sprint_speed;
+  total_swim_speed += stats.total_swim_speed;
+  total_fly_speed += stats.total_fly_speed;
+  num_land_animals += stats.num_land_animals;
+  num_water_animals += stats.num_water_animals;
+  num_birds += stats.num_birds;
+}
+
+Animal::Animal(std::string species, int age, int size) :
+    species_(species), age_(age), size_(size) {}
+
+std::string Animal::species() const {
+  return species_;
+}
+
+int Animal::age() const {
+  return age_;
+}
+
+int Animal::size() const {
+  return size_;
+}
+
+LandAnimal::LandAnimal(std::string species, int age, int size, int sprint_speed) :
+    Animal(species, age, size), sprint_speed_(sprint_speed) {}
+
+int LandAnimal::sprint_speed() const {
+  return sprint_speed_;
+}
+
+void LandAnimal::Accept(Visitor* visitor) const {
+  visitor->Visit(this);
+}
+
+WaterAnimal::WaterAnimal(std::string species, int age, int size, int swim_speed) :
+    Animal(species, age, size), swim_speed_(swim_speed) {}
+
+int WaterAnimal::swim_speed() const {
+  return swim_speed_;
+}
+
+void WaterAnimal::Accept(Visitor* visitor) const {
+  visitor->Visit(this);
+}
+
+Bird::Bird(std::string species, int age, int size, int fly_speed) :
+    Animal(species, age, size), fly_speed_(fly_speed) {}
+
+int Bird::fly_speed() const {
+  return fly_speed_;
+}
+
+void Bird::Accept(Visitor* visitor) const {
+  visitor->Visit(this);
+}
+
+VisitorPool::VisitorPool(size_t num_threads) :
+    generation_(0), count_(0), remaining_(0), stopping_(false) {
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&VisitorPool::Run, this);
+  }
+}
+
+VisitorPool::~VisitorPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void VisitorPool::VisitAll(const std::vector<std::unique_ptr<Animal>>& animals,
+                           Visitor* visitor) {
+  size_t num_chunks = (animals.size() + kChunkSize - 1) / kChunkSize;
+  if (workers_.empty() || num_chunks <= 1) {
+    for (const auto& animal : animals) {
+      animal->Accept(visitor);
+    }
+    return;
+  }
+
+  size_t window = workers_.size() * kChunksPerWorker;
+  std::vector<std::unique_ptr<Visitor>> clones(window);
+  for (size_t first_chunk = 0; first_chunk < num_chunks; first_chunk += window) {
+    size_t count = std::min(window, num_chunks - first_chunk);
+    for (size_t i = 0; i < count; ++i) {
+      clones[i] = visitor->Clone();
+    }
+    RunBatch(count, [&](size_t i) {
+      size_t begin = (first_chunk + i) * kChunkSize;
+      size_t end = std::min(begin + kChunkSize, animals.size());
+      for (size_t k = begin; k < end; ++k) {
+        animals[k]->Accept(clones[i].get());
+      }
+    });
+    for (size_t i = 0; i < count; ++i) {
+      visitor->Merge(clones[i].get());
+      clones[i].reset();
+    }
+  }
+}
+
+size_t VisitorPool::size() const {
+  return workers_.size();
+}
+
+void VisitorPool::RunBatch(size_t count, std::function<void(size_t)> work) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_ = std::move(work);
+  count_ = count;
+  next_ = 0;
+  remaining_ = workers_.size();
+  generation_++;
+  start_.notify_all();
+  done_.wait(lock, [this]() { return remaining_ == 0; });
+}
+
+void VisitorPool::Run() {
+  uint64_t seen_generation = 0;
+  while (true) {
+    std::function<void(size_t)>* work;
+    size_t count;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_.wait(lock, [&]() { return stopping_ || generation_ != seen_generation; });
+      if (stopping_) {
+        return;
+      }
+      seen_generation = generation_;
+      work = &work_;
+      count = count_;
+    }
+
+    for (size_t i = next_.fetch_add(1); i < count; i = next_.fetch_add(1)) {
+      (*work)(i);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--remaining_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+// Specific animal classes
+
+class Dog : public LandAnimal {
+ public:
+  Dog(int age, int size, int sprint_speed) : LandAnimal("Dog", age, size, sprint_speed) {}
+};
+
+class Cat : public LandAnimal {
+ public:
+  Cat(int age, int size, int sprint_speed) : LandAnimal("Cat", age, size, sprint_speed) {}
+};
+
+class Shark : public WaterAnimal {
+ public:
+  Shark(int age, int size, int swim_speed) : WaterAnimal("Shark", age, size, swim_speed) {}
+};
+
+class Dolphin : public WaterAnimal {
+ public:
+  Dolphin(int age, int size, int swim_speed) : WaterAnimal("Dolphin", age, size, swim_speed) {}
+};
+
+class Eagle : public Bird {
+ public:
+  Eagle(int age, int size, int fly_speed) : Bird("Eagle", age, size, fly_speed) {}
+};
+
+class Sparrow : public Bird {
+ public:
+  Sparrow(int age, int size, int fly_speed) : Bird("Sparrow", age, size, fly_speed) {}
+};
+
+// Benchmark
+
+std::vector<std::unique_ptr<Animal>> RandomAnimals(size_t count) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> kind(0, 5);
+  std::uniform_int_distribution<int> value(1, 100);
+  std::vector<std::unique_ptr<Animal>> animals;
+  animals.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    int age = value(rng);
+    int size = value(rng);
+    int speed = value(rng);
+    switch (kind(rng)) {
+      case 0:
+        animals.push_back(std::make_unique<Dog>(age, size, speed));
+        break;
+      case 1:
+        animals.push_back(std::make_unique<Cat>(age, size, speed));
+        break;
+      case 2:
+        animals.push_back(std::make_unique<Shark>(age, size, speed));
+        break;
+      case 3:
+        animals.push_back(std::make_unique<Dolphin>(age, size, speed));
+        break;
+      case 4:
+        animals.push_back(std::make_unique<Eagle>(age, size, speed));
+        break;
+      default:
+        animals.push_back(std::make_unique<Sparrow>(age, size, speed));
+        break;
+    }
+  }
+  return animals;
+}
+
+uint64_t Checksum(const StatsVisitor& stats) {
+  return stats.total_size + stats.total_sprint_speed * 3 + stats.total_swim_speed * 5 +
+         stats.total_fly_speed * 7 + stats.num_land_animals + stats.num_water_animals * 11 +
+         stats.num_birds * 13;
+}
+
+// Returns seconds taken by visit().
+template <typename Visit>
+double Seconds(Visit visit) {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  visit();
+  auto end_time = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double>(end_time - start_time).count();
+}
+
+int main() {
+  std::vector<std::unique_ptr<Animal>> zoo;
+  zoo.push_back(std::make_unique<Dog>(5, 30, 60));
+  zoo.push_back(std::make_unique<Cat>(3, 10, 50));
+  zoo.push_back(std::make_unique<Shark>(8, 200, 40));
+  zoo.push_back(std::make_unique<Dolphin>(6, 150, 30));
+  zoo.push_back(std::make_unique<Eagle>(4, 5, 100));
+  zoo.push_back(std::make_unique<Sparrow>(2, 1, 20));
+
+  VisitorPool pool(4);
+  {
+    PrintVisitor print_visitor(&std::cout);
+    pool.VisitAll(zoo, &print_visitor);
+  }
+
+  // Parallel printing must produce exactly what a single thread prints.
+  std::vector<std::unique_ptr<Animal>> sample = RandomAnimals(200'000);
+  std::ostringstream serial_output;
+  std::ostringstream parallel_output;
+  {
+    PrintVisitor serial_visitor(&serial_output);
+    for (const auto& animal : sample) {
+      animal->Accept(&serial_visitor);
+    }
+    PrintVisitor parallel_visitor(&parallel_output);
+    pool.VisitAll(sample, &parallel_visitor);
+  }
+  std::cout << "Parallel output identical to serial output: "
+            << (serial_output.str() == parallel_output.str() ? "yes" : "NO") << "\n";
+
+  constexpr size_t kNumAnimals = 10'000'000;
+  std::vector<std::unique_ptr<Animal>> animals = RandomAnimals(kNumAnimals);
+  std::ofstream null_output("/dev/null");
+
+  std::cout << "Visiting " << kNumAnimals << " animals, "
+            << std::thread::hardware_concurrency() << " hardware threads available:\n";
+  StatsVisitor serial_stats;
+  double serial_stats_seconds = Seconds([&] {
+    for (const auto& animal : animals) {
+      animal->Accept(&serial_stats);
+    }
+  });
+  double serial_print_seconds = Seconds([&] {
+    PrintVisitor print_visitor(&null_output);
+    for (const auto& animal : animals) {
+      animal->Accept(&print_visitor);
+    }
+  });
+  std::cout << "Threads | StatsVisitor ms (speedup) | PrintVisitor ms (speedup)\n";
+  std::cout << "serial  | " << serial_stats_seconds * 1e3 << " | " << serial_print_seconds * 1e3
+            << "\n";
+
+  for (size_t num_threads : {1, 2, 4, 8}) {
+    VisitorPool benchmark_pool(num_threads);
+    StatsVisitor stats;
+    double stats_seconds = Seconds([&] { benchmark_pool.VisitAll(animals, &stats); });
+    double print_seconds = Seconds([&] {
+      PrintVisitor print_visitor(&null_output);
+      benchmark_pool.VisitAll(animals, &print_visitor);
+    });
+
+    if (Checksum(stats) != Checksum(serial_stats)) {
+      std::cout << "Checksum mismatch with " << num_threads << " threads\n";
+    }
+    std::cout << num_threads << "       | " << stats_seconds * 1e3 << " ("
+              << serial_stats_seconds / stats_seconds << "x) | " << print_seconds * 1e3 << " ("
+              << serial_print_seconds / print_seconds << "x)\n";
+  }
+  return 0;
+}
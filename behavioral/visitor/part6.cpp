@@ -0,0 +1,685 @@
+/*
+  Exporting animals without per-animal I/O.
+
+  PrintVisitor in part2 writes every field through std::cout << and ends every line with
+  std::endl, which flushes: one write system call per animal, plus stream formatting and a
+  species() string copy for every field. Dumping millions of animals spends its time there
+  rather than writing bytes.
+
+  Here, export visitors serialize animals into an OutputBuffer:
+
+  - OutputBuffer is one large block of memory, allocated once. Visitors append text or bytes
+    to it, and it is written to a file descriptor with a single write() whenever it is full,
+    so a dump takes (size / capacity) system calls.
+
+  - Integers are formatted with std::to_chars straight into the buffer: no locale, no stream
+    state, no temporary strings. species() returns a reference instead of a copy, so visiting
+    allocates nothing.
+
+  - CsvExportVisitor writes CSV with a header row, JsonLinesExportVisitor one JSON object per
+    line, and BinaryExportVisitor compact records (see its comment for the layout).
+*/
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class LandAnimal;
+class WaterAnimal;
+class Bird;
+
+class Visitor {
+ public:
+  virtual ~Visitor() = default;
+
+  virtual void Visit(const LandAnimal* land_animal) = 0;
+  virtual void Visit(const WaterAnimal* water_animal) = 0;
+  virtual void Visit(const Bird* bird) = 0;
+};
+
+// A reusable block of memory in front of a file descriptor.
+class OutputBuffer {
+ public:
+  static constexpr size_t kDefaultCapacity = 1 << 20;
+  static constexpr size_t kMaxIntChars = 20;  // Sign and 19 digits of an int64_t
+
+  // Does not take ownership of fd. A capacity below kMaxIntChars is raised to kMaxIntChars.
+  explicit OutputBuffer(int fd, size_t capacity = kDefaultCapacity);
+
+  // Writes whatever is still buffered. Call Flush first to see write errors.
+  ~OutputBuffer();
+
+  void Append(std::string_view text);
+
+  void Append(char c);
+
+  void AppendInt(int64_t value);
+
+  void AppendBytes(const void* data, size_t size);
+
+  // Writes the buffered bytes to the file descriptor. Throws std::runtime_error on failure; the
+  // bytes not written yet stay buffered for the next Flush.
+  void Flush();
+
+  uint64_t bytes_written() const;
+
+  uint64_t num_writes() const;
+
+ private:
+  // Returns room for at least size bytes, flushing first if needed. size <= capacity.
+  char* Reserve(size_t size);
+
+  void WriteAll(const char* data, size_t size);
+
+  int fd_;
+  std::unique_ptr<char[]> data_;
+  size_t capacity_;
+  size_t size_;
+  uint64_t bytes_written_;
+  uint64_t num_writes_;
+};
+
+// One row per animal: kind,species,age,size,speed. speed is the sprint, swim or fly speed.
+class CsvExportVisitor : public Visitor {
+ public:
+  // Writes the header row.
+  explicit CsvExportVisitor(OutputBuffer* out);
+
+  void Visit(const LandAnimal* land_animal) override;
+  void Visit(const WaterAnimal* water_animal) override;
+  void Visit(const Bird* bird) override;
+
+ private:
+  void Write(std::string_view kind, const std::string& species, int age, int size, int speed);
+
+  OutputBuffer* out_;
+};
+
+// One object per line, e.g. {"kind":"land","species":"Dog","age":5,"size":30,"sprint_speed":60}
+class JsonLinesExportVisitor : public Visitor {
+ public:
+  explicit JsonLinesExportVisitor(OutputBuffer* out);
+
+  void Visit(const LandAnimal* land_animal) override;
+  void Visit(const WaterAnimal* water_animal) override;
+  void Visit(const Bird* bird) override;
+
+ private:
+  void Write(std::string_view kind, const std::string& species, int age, int size,
+             std::string_view speed_name, int speed);
+
+  OutputBuffer* out_;
+};
+
+/*
+  The file starts with the 4 bytes "ZOO1". Each animal is then:
+    uint8   kind (0 = land, 1 = water, 2 = bird)
+    uint16  length of species
+    char[]  species, not terminated
+    int32   age, size, speed
+  Integers are in the byte order of the machine that wrote the file.
+*/
+class BinaryExportVisitor : public Visitor {
+ public:
+  // Writes the file header.
+  explicit BinaryExportVisitor(OutputBuffer* out);
+
+  void Visit(const LandAnimal* land_animal) override;
+  void Visit(const WaterAnimal* water_animal) override;
+  void Visit(const Bird* bird) override;
+
+ private:
+  void Write(uint8_t kind, const std::string& species, int32_t age, int32_t size, int32_t speed);
+
+  OutputBuffer* out_;
+};
+
+// Part2 PrintVisitor, kept as the baseline for the benchmark.
+class PrintVisitor : public Visitor {
+ public:
+  explicit PrintVisitor(std::ostream* out);
+
+  void Visit(const LandAnimal* land_animal) override;
+  void Visit(const WaterAnimal* water_animal) override;
+  void Visit(const Bird* bird) override;
+
+ private:
+  std::ostream* out_;
+};
+
+class Animal {
+ public:
+  Animal(std::string species, int age, int size);
+
+  virtual ~Animal() = default;
+
+  const std::string& species() const;
+
+  int age() const;
+
+  int size() const;
+
+  virtual void Accept(Visitor* visitor) const = 0;
+
+ private:
+  std::string species_;
+  int age_;
+  int size_;
+};
+
+class LandAnimal : public Animal {
+ public:
+  LandAnimal(std::string species, int age, int size, int sprint_speed);
+
+  int sprint_speed() const;
+
+  void Accept(Visitor* visitor) const override;
+
+ private:
+  int sprint_speed_;
+};
+
+class WaterAnimal : public Animal {
+ public:
+  WaterAnimal(std::string species, int age, int size, int swim_speed);
+
+  int swim_speed() const;
+
+  void Accept(Visitor* visitor) const override;
+
+ private:
+  int swim_speed_;
+};
+
+class Bird : public Animal {
+ public:
+  Bird(std::string species, int age, int size, int fly_speed);
+
+  int fly_speed() const;
+
+  void Accept(Visitor* visitor) const override;
+
+ private:
+  int fly_speed_;
+};
+
+// Implementation
+OutputBuffer::OutputBuffer(int fd, size_t capacity) :
+    fd_(fd),
+    data_(new char[std::max(capacity, kMaxIntChars)]),
+    capacity_(std::max(capacity, kMaxIntChars)),
+    size_(0),
+    bytes_written_(0),
+    num_writes_(0) {}
+
+OutputBuffer::~OutputBuffer() {
+  try {
+    Flush();
+  } catch (const std::runtime_error&) {
+    // Nobody left to tell
+  }
+}
+
+void OutputBuffer::Append(std::string_view text) {
+  if (text.size() > capacity_) {
+    Flush();
+    WriteAll(text.data(), text.size());
+    return;
+  }
+  std::memcpy(Reserve(text.size()), text.data(), text.size());
+  size_ += text.size();
+}
+
+void OutputBuffer::Append(char c) {
+  *Reserve(1) = c;
+  size_++;
+}
+
+void OutputBuffer::AppendInt(int64_t value) {
+  char* begin = Reserve(kMaxIntChars);
+  size_ += std::to_chars(begin, begin + kMaxIntChars, value).ptr - begin;
+}
+
+void OutputBuffer::AppendBytes(const void* data, size_t size) {
+  Append(std::string_view(static_cast<const char*>(data), size));
+}
+
+void OutputBuffer::Flush() {
+  uint64_t bytes_written_before = bytes_written_;
+  try {
+    WriteAll(data_.get(), size_);
+  } catch (const std::runtime_error&) {
+    size_t written = bytes_written_ - bytes_written_before;
+    std::memmove(data_.get(), data_.get() + written, size_ - written);
+    size_ -= written;
+    throw;
+  }
+  size_ = 0;
+}
+
+uint64_t OutputBuffer::bytes_written() const {
+  return bytes_written_;
+}
+
+uint64_t OutputBuffer::num_writes() const {
+  return num_writes_;
+}
+
+char* OutputBuffer::Reserve(size_t size) {
+  if (capacity_ - size_ < size) {
+    Flush();
+  }
+  return data_.get() + size_;
+}
+
+void OutputBuffer::WriteAll(const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd_, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("Failed to write export: ") + std::strerror(errno));
+    }
+    num_writes_++;
+    bytes_written_ += written;
+    data += written;
+    size -= written;
+  }
+}
+
+namespace {
+
+// True if text can go into CSV and JSON as is.
+bool IsPlain(std::string_view text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\' || c == ',' || static_cast<unsigned char>(c) < 0x20) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void AppendCsvField(std::string_view text, OutputBuffer* out) {
+  if (IsPlain(text)) {
+    out->Append(text);
+    return;
+  }
+  out->Append('"');
+  for (char c : text) {
+    if (c == '"') {
+      out->Append('"');
+    }
+    out->Append(c);
+  }
+  out->Append('"');
+}
+
+void AppendJsonString(std::string_view text, OutputBuffer* out) {
+  out->Append('"');
+  if (IsPlain(text)) {
+    out->Append(text);
+  } else {
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        out->Append('\\');
+        out->Append(c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        constexpr char kHex[] = "0123456789abcdef";
+        out->Append("\\u00");
+        out->Append(kHex[c >> 4]);
+        out->Append(kHex[c & 0xf]);
+      } else {
+        out->Append(c);
+      }
+    }
+  }
+  out->Append('"');
+}
+
+}  // namespace
+
+CsvExportVisitor::CsvExportVisitor(OutputBuffer* out) : out_(out) {
+  out_->Append("kind,species,age,size,speed\n");
+}
+
+void CsvExportVisitor::Visit(const LandAnimal* land_animal) {
+  Write("land", land_animal->species(), land_animal->age(), land_animal->size(),
+        land_animal->sprint_speed());
+}
+
+void CsvExportVisitor::Visit(const WaterAnimal* water_animal) {
+  Write("water", water_animal->species(), water_animal->age(), water_animal->size(),
+        water_animal->swim_speed());
+}
+
+void CsvExportVisitor::Visit(const Bird* bird) {
+  Write("bird", bird->species(), bird->age(), bird->size(), bird->fly_speed());
+}
+
+void CsvExportVisitor::Write(std::string_view kind, const std::string& species, int age,
+                             int size, int speed) {
+  out_->Append(kind);
+  out_->Append(',');
+  AppendCsvField(species, out_);
+  out_->Append(',');
+  out_->AppendInt(age);
+  out_->Append(',');
+  out_->AppendInt(size);
+  out_->Append(',');
+  out_->AppendInt(speed);
+  out_->Append('\n');
+}
+
+JsonLinesExportVisitor::JsonLinesExportVisitor(OutputBuffer* out) : out_(out) {}
+
+void JsonLinesExportVisitor::Visit(const LandAnimal* land_animal) {
+  Write("land", land_animal->species(), land_animal->age(), land_animal->size(), "sprint_speed",
+        land_animal->sprint_speed());
+}
+
+void JsonLinesExportVisitor::Visit(const WaterAnimal* water_animal) {
+  Write("water", water_animal->species(), water_animal->age(), water_animal->size(),
+        "swim_speed", water_animal->swim_speed());
+}
+
+void JsonLinesExportVisitor::Visit(const Bird* bird) {
+  Write("bird", bird->species(), bird->age(), bird->size(), "fly_speed", bird->fly_speed());
+}
+
+void JsonLinesExportVisitor::Write(std::string_view kind, const std::string& species, int age,
+                                   int size, std::string_view speed_name, int speed) {
+  out_->Append("{\"kind\":\"");
+  out_->Append(kind);
+  out_->Append("\",\"species\":");
+  AppendJsonString(species, out_);
+  out_->Append(",\"age\":");
+  out_->AppendInt(age);
+  out_->Append(",\"size\":");
+  out_->AppendInt(size);
+  out_->Append(",\"");
+  out_->Append(speed_name);
+  out_->Append("\":");
+  out_->AppendInt(speed);
+  out_->Append("}\n");
+}
+
+BinaryExportVisitor::BinaryExportVisitor(OutputBuffer* out) : out_(out) {
+  out_->Append("ZOO1");
+}
+
+void BinaryExportVisitor::Visit(const LandAnimal* land_animal) {
+  Write(0, land_animal->species(), land_animal->age(), land_animal->size(),
+        land_animal->sprint_speed());
+}
+
+void BinaryExportVisitor::Visit(const WaterAnimal* water_animal) {
+  Write(1, water_animal->species(), water_animal->age(), water_animal->size(),
+        water_animal->swim_speed());
+}
+
+void BinaryExportVisitor::Visit(const Bird* bird) {
+  Write(2, bird->species(), bird->age(), bird->size(), bird->fly_speed());
+}
+
+void BinaryExportVisitor::Write(uint8_t kind, const std::string& species, int32_t age,
+                                int32_t size, int32_t speed) {
+  if (species.size() > UINT16_MAX) {
+    throw std::runtime_error("Species name too long for binary export: " + species);
+  }
+  auto length = static_cast<uint16_t>(species.size());
+  int32_t numbers[] = {age, size, speed};
+  out_->AppendBytes(&kind, sizeof(kind));
+  out_->AppendBytes(&length, sizeof(length));
+  out_->Append(species);
+  out_->AppendBytes(numbers, sizeof(numbers));
+}
+
+PrintVisitor::PrintVisitor(std::ostream* out) : out_(out) {}
+
+void PrintVisitor::Visit(const LandAnimal* land_animal) {
+  *out_ << "Land Animal: Species = " << land_animal->species() << ", Age = " << land_animal->age()
+        << ", Size = " << land_animal->size()
+        << ", Sprint Speed = " << land_animal->sprint_speed() << std::endl;
+}
+
+void PrintVisitor::Visit(const WaterAnimal* water_animal) {
+  *out_ << "Water Animal: Species = " << water_animal->species()
+        << ", Age = " << water_animal->age() << ", Size = " << water_animal->size()
+        << ", Swim Speed = " << water_animal->swim_speed() << std::endl;
+}
+
+void PrintVisitor::Visit(const Bird* bird) {
+  *out_ << "Bird: Species = " << bird->species() << ", Age = " << bird->age()
+        << ", Size = " << bird->size() << ", Fly Speed = " << bird->fly_speed() << std::endl;
+}
+
+Animal::Animal(std::string species, int age, int size) :
+    species_(species), age_(age), size_(size) {}
+
+const std::string& Animal::species() const {
+  return species_;
+}
+
+int Animal::age() const {
+  return age_;
+}
+
+int Animal::size() const {
+  return size_;
+}
+
+LandAnimal::LandAnimal(std::string species, int age, int size, int sprint_speed) :
+    Animal(species, age, size), sprint_speed_(sprint_speed) {}
+
+int LandAnimal::sprint_speed() const {
+  return sprint_speed_;
+}
+
+void LandAnimal::Accept(Visitor* visitor) const {
+  visitor->Visit(this);
+}
+
+WaterAnimal::WaterAnimal(std::string species, int age, int size, int swim_speed) :
+    Animal(species, age, size), swim_speed_(swim_speed) {}
+
+int WaterAnimal::swim_speed() const {
+  return swim_speed_;
+}
+
+void WaterAnimal::Accept(Visitor* visitor) const {
+  visitor->Visit(this);
+}
+
+Bird::Bird(std::string species, int age, int size, int fly_speed) :
+    Animal(species, age, size), fly_speed_(fly_speed) {}
+
+int Bird::fly_speed() const {
+  return fly_speed_;
+}
+
+void Bird::Accept(Visitor* visitor) const {
+  visitor->Visit(this);
+}
+
+// Specific animal classes
+
+class Dog : public LandAnimal {
+ public:
+  Dog(int age, int size, int sprint_speed) : LandAnimal("Dog", age, size, sprint_speed) {}
+};
+
+class Cat : public LandAnimal {
+ public:
+  Cat(int age, int size, int sprint_speed) : LandAnimal("Cat", age, size, sprint_speed) {}
+};
+
+class Shark : public WaterAnimal {
+ public:
+  Shark(int age, int size, int swim_speed) : WaterAnimal("Shark", age, size, swim_speed) {}
+};
+
+class Dolphin : public WaterAnimal {
+ public:
+  Dolphin(int age, int size, int swim_speed) : WaterAnimal("Dolphin", age, size, swim_speed) {}
+};
+
+class Eagle : public Bird {
+ public:
+  Eagle(int age, int size, int fly_speed) : Bird("Eagle", age, size, fly_speed) {}
+};
+
+class Sparrow : public Bird {
+ public:
+  Sparrow(int age, int size, int fly_speed) : Bird("Sparrow", age, size, fly_speed) {}
+};
+
+// Benchmark
+
+std::vector<std::unique_ptr<Animal>> RandomAnimals(size_t count) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> kind(0, 5);
+  std::uniform_int_distribution<int> value(1, 100);
+  std::vector<std::unique_ptr<Animal>> animals;
+  animals.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    int age = value(rng);
+    int size = value(rng);
+    int speed = value(rng);
+    switch (kind(rng)) {
+      case 0:
+        animals.push_back(std::make_unique<Dog>(age, size, speed));
+        break;
+      case 1:
+        animals.push_back(std::make_unique<Cat>(age, size, speed));
+        break;
+      case 2:
+        animals.push_back(std::make_unique<Shark>(age, size, speed));
+        break;
+      case 3:
+        animals.push_back(std::make_unique<Dolphin>(age, size, speed));
+        break;
+      case 4:
+        animals.push_back(std::make_unique<Eagle>(age, size, speed));
+        break;
+      default:
+        animals.push_back(std::make_unique<Sparrow>(age, size, speed));
+        break;
+    }
+  }
+  return animals;
+}
+
+// Runs do_export(path) and prints its throughput. do_export returns its number of writes.
+template <typename Export>
+void Measure(const char* label, const std::string& path, size_t num_animals, Export do_export) {
+  auto start_time = std::chrono::high_resolution_clock::now();
+  uint64_t num_writes = do_export(path);
+  auto end_time = std::chrono::high_resolution_clock::now();
+  std::chrono::duration<double> duration = end_time - start_time;
+
+  std::cout << label << " | " << num_animals / duration.count() / 1e6 << " M animals/s, "
+            << duration.count() * 1e3 << " ms, " << num_writes << " write calls\n";
+}
+
+// Closes the file descriptor when it goes out of scope.
+class ScopedFd {
+ public:
+  explicit ScopedFd(int fd) : fd_(fd) {}
+
+  ~ScopedFd() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  ScopedFd(const ScopedFd&) = delete;
+  ScopedFd& operator=(const ScopedFd&) = delete;
+
+  int get() const {
+    return fd_;
+  }
+
+ private:
+  int fd_;
+};
+
+template <typename ExportVisitor>
+uint64_t Export(const std::vector<std::unique_ptr<Animal>>& animals, const std::string& path) {
+  ScopedFd fd(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644));
+  if (fd.get() < 0) {
+    throw std::runtime_error("Failed to open " + path + ": " + std::strerror(errno));
+  }
+  OutputBuffer out(fd.get());  // Destroyed, and so flushed, before fd is closed
+  ExportVisitor visitor(&out);
+  for (const auto& animal : animals) {
+    animal->Accept(&visitor);
+  }
+  out.Flush();
+  return out.num_writes();
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::unique_ptr<Animal>> zoo;
+  zoo.push_back(std::make_unique<Dog>(5, 30, 60));
+  zoo.push_back(std::make_unique<Cat>(3, 10, 50));
+  zoo.push_back(std::make_unique<Shark>(8, 200, 40));
+  zoo.push_back(std::make_unique<Dolphin>(6, 150, 30));
+  zoo.push_back(std::make_unique<Eagle>(4, 5, 100));
+  zoo.push_back(std::make_unique<Sparrow>(2, 1, 20));
+
+  std::cout.flush();  // The export goes to fd 1 directly
+  {
+    OutputBuffer out(STDOUT_FILENO);
+    CsvExportVisitor csv_visitor(&out);
+    for (const auto& animal : zoo) {
+      animal->Accept(&csv_visitor);
+    }
+    JsonLinesExportVisitor json_visitor(&out);
+    for (const auto& animal : zoo) {
+      animal->Accept(&json_visitor);
+    }
+    out.Flush();
+  }
+
+  // Exports go to /dev/null unless a directory is given, so the numbers measure formatting.
+  std::string directory = argc > 1 ? argv[1] : "";
+  auto path = [&](const char* name) {
+    return directory.empty() ? std::string("/dev/null") : directory + name;
+  };
+
+  constexpr size_t kNumAnimals = 10'000'000;
+  std::vector<std::unique_ptr<Animal>> animals = RandomAnimals(kNumAnimals);
+  std::cout << "Exporting " << kNumAnimals << " animals to "
+            << (directory.empty() ? "/dev/null" : directory) << ":\n";
+  Measure("PrintVisitor, std::endl (part2)", path("/zoo.txt"), kNumAnimals,
+          [&](const std::string& file) {
+            std::ofstream out(file);
+            PrintVisitor visitor(&out);
+            for (const auto& animal : animals) {
+              animal->Accept(&visitor);
+            }
+            return static_cast<uint64_t>(animals.size());  // One per std::endl
+          });
+  Measure("CSV                            ", path("/zoo.csv"), kNumAnimals,
+          [&](const std::string& file) { return Export<CsvExportVisitor>(animals, file); });
+  Measure("JSON lines                     ", path("/zoo.jsonl"), kNumAnimals,
+          [&](const std::string& file) { return Export<JsonLinesExportVisitor>(animals, file); });
+  Measure("Binary                         ", path("/zoo.bin"), kNumAnimals,
+          [&](const std::string& file) { return Export<BinaryExportVisitor>(animals, file); });
+  return 0;
+}
@@ -0,0 +1,437 @@
+/*
+  A shared, byte-budgeted file cache behind FileStorageProxy.
+
+  In part1, every FileStorageProxy keeps its own std::map<std::string, File>:
+  - Two proxies on the same service both miss on the same file.
+  - The cache grows without bound and is never invalidated by Store, so a proxy keeps returning
+    the old content of a file that was stored again.
+  - A hit returns a full copy of File, which is two strings.
+
+  Here:
+  - FileCache is shared by any number of proxies. It holds std::shared_ptr<const File>, so a hit
+    hands out a reference to the cached file instead of a copy.
+  - The cache is split into shards, each with its own mutex and LRU list, so loads of different
+    files from different threads rarely wait for each other. A file always goes to the same
+    shard, chosen by the hash of its name.
+  - Each shard gets an equal part of a total byte budget. When a shard is over its budget, the
+    least recently used files are evicted.
+  - Store writes through to the service and then invalidates the cached file. A load that
+    started before the Store does not put the old content back into the cache (see Insert).
+  - FileCache counts hits, misses, evictions and invalidations.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+void SleepMS(int milliseconds) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+}  // namespace
+
+class File {
+ public:
+  File(std::string filename, std::string content) :
+      filename_(std::move(filename)), content_(std::move(content)) {}
+
+  const std::string& filename() const {
+    return filename_;
+  }
+
+  const std::string& content() const {
+    return content_;
+  }
+
+ private:
+  std::string filename_;
+  std::string content_;
+};
+
+/*
+  Same as part1, except that the network delay is configurable and the storage can be used from
+  several threads.
+*/
+class RemoteFileStorage {
+ public:
+  explicit RemoteFileStorage(int latency_ms) : latency_ms_(latency_ms) {}
+
+  void Connect() {
+    SleepMS(latency_ms_ * 10);  // Simulate network delay
+
+    std::cout << "Connected to remote file storage." << std::endl;
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    storage_.clear();
+  }
+
+  void Store(File file) {
+    SleepMS(latency_ms_);  // Simulate network delay
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    storage_.insert_or_assign(file.filename(), std::move(file));
+  }
+
+  File Load(const std::string& filename) const {
+    SleepMS(latency_ms_);  // Simulate network delay
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = storage_.find(filename);
+    if (it != storage_.end()) {
+      return it->second;
+    }
+    throw std::runtime_error("File not found");
+  }
+
+  void Disconnect() {
+    SleepMS(latency_ms_ * 10);  // Simulate network delay
+
+    std::cout << "Disconnected from remote file storage." << std::endl;
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    storage_.clear();
+  }
+
+ private:
+  int latency_ms_;
+  mutable std::shared_mutex mutex_;
+  std::map<std::string, File> storage_;
+};
+
+class IFileStorageProxy {
+ public:
+  virtual ~IFileStorageProxy() = default;
+  virtual void Store(File file) = 0;
+  virtual std::shared_ptr<const File> Load(const std::string& filename) = 0;
+};
+
+class FileStorageService : public IFileStorageProxy {
+ public:
+  explicit FileStorageService(int latency_ms = 100) :
+      remote_storage_(std::make_unique<RemoteFileStorage>(latency_ms)) {}
+
+  void Store(File file) override {
+    remote_storage_->Store(std::move(file));
+  }
+
+  std::shared_ptr<const File> Load(const std::string& filename) override {
+    return std::make_shared<const File>(remote_storage_->Load(filename));
+  }
+
+  void Connect() {
+    remote_storage_->Connect();
+  }
+
+  void Disconnect() {
+    remote_storage_->Disconnect();
+  }
+
+ private:
+  std::unique_ptr<RemoteFileStorage> remote_storage_;
+};
+
+/*
+  Sharded LRU cache of files, limited to a total number of bytes. Thread-safe.
+*/
+class FileCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+    size_t num_files = 0;
+    size_t bytes = 0;
+  };
+
+  // Bytes charged per file on top of its name and content, for the list and index entries.
+  static constexpr size_t kEntryOverhead = 128;
+
+  explicit FileCache(size_t byte_budget, size_t num_shards = 16) :
+      shard_budget_(byte_budget / std::max<size_t>(num_shards, 1)),
+      shards_(std::max<size_t>(num_shards, 1)) {}
+
+  // nullptr on a miss.
+  std::shared_ptr<const File> Get(const std::string& filename) {
+    Shard& shard = ShardFor(filename);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(filename);
+    if (it == shard.index.end()) {
+      shard.misses++;
+      return nullptr;
+    }
+    shard.hits++;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);  // Most recent first
+    return *it->second;
+  }
+
+  // Call before loading filename from the service, and pass the result to Insert.
+  uint64_t Version(const std::string& filename) {
+    Shard& shard = ShardFor(filename);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.version;
+  }
+
+  /*
+    Caches file, unless its shard was invalidated after version was taken: the file may then have
+    been loaded before a Store and be older than what the service has now. Files bigger than a
+    shard's budget are not cached.
+  */
+  void Insert(std::shared_ptr<const File> file, uint64_t version) {
+    size_t charge = Charge(*file);
+    if (charge > shard_budget_) {
+      return;
+    }
+    Shard& shard = ShardFor(file->filename());
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (shard.version != version) {
+      return;
+    }
+    auto it = shard.index.find(file->filename());
+    if (it != shard.index.end()) {
+      auto entry = it->second;
+      shard.bytes -= Charge(**entry);
+      shard.index.erase(it);  // The key views the old file, so drop it before the file
+      shard.entries.erase(entry);
+    }
+    shard.entries.push_front(std::move(file));
+    shard.index.emplace(shard.entries.front()->filename(), shard.entries.begin());
+    shard.bytes += charge;
+    while (shard.bytes > shard_budget_) {
+      const std::shared_ptr<const File>& victim = shard.entries.back();
+      shard.bytes -= Charge(*victim);
+      shard.index.erase(victim->filename());
+      shard.entries.pop_back();
+      shard.evictions++;
+    }
+  }
+
+  // Drops filename from the cache and fails any Insert that took its version before this call.
+  void Invalidate(const std::string& filename) {
+    Shard& shard = ShardFor(filename);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.version++;
+    shard.invalidations++;
+    auto it = shard.index.find(filename);
+    if (it != shard.index.end()) {
+      auto entry = it->second;
+      shard.bytes -= Charge(**entry);
+      shard.index.erase(it);
+      shard.entries.erase(entry);
+    }
+  }
+
+  Stats stats() const {
+    Stats stats;
+    for (const Shard& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      stats.hits += shard.hits;
+      stats.misses += shard.misses;
+      stats.evictions += shard.evictions;
+      stats.invalidations += shard.invalidations;
+      stats.num_files += shard.entries.size();
+      stats.bytes += shard.bytes;
+    }
+    return stats;
+  }
+
+ private:
+  struct Shard {
+    mutable std::mutex mutex;
+    std::list<std::shared_ptr<const File>> entries;  // Most recently used first
+    // Keys view the filename of the file they point to, which lives as long as the entry.
+    std::unordered_map<std::string_view, std::list<std::shared_ptr<const File>>::iterator> index;
+    size_t bytes = 0;
+    uint64_t version = 0;  // Bumped by every Invalidate
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t invalidations = 0;
+  };
+
+  static size_t Charge(const File& file) {
+    return file.filename().size() + file.content().size() + kEntryOverhead;
+  }
+
+  Shard& ShardFor(std::string_view filename) {
+    return shards_[std::hash<std::string_view>()(filename) % shards_.size()];
+  }
+
+  size_t shard_budget_;
+  std::vector<Shard> shards_;
+};
+
+/*
+  FileStorageProxy as in part1, but caching goes through a FileCache that may be shared with
+  other proxies. Pass nullptr to disable caching.
+*/
+class FileStorageProxy : public IFileStorageProxy {
+  static std::atomic<int> instance_count_;  // Assumes the first and last proxy do not race
+
+ public:
+  FileStorageProxy(FileStorageService* file_storage_service, FileCache* cache = nullptr) :
+      file_storage_service_(file_storage_service), cache_(cache) {
+    // Connect if this is the first instance
+    if (++instance_count_ == 1) {
+      file_storage_service_->Connect();
+    }
+  }
+
+  ~FileStorageProxy() {
+    // Disconnect if this is the last instance
+    if (--instance_count_ == 0) {
+      file_storage_service_->Disconnect();
+    }
+  }
+
+  void Store(File file) override {
+    std::string filename = file.filename();
+    file_storage_service_->Store(std::move(file));
+    if (cache_) {
+      cache_->Invalidate(filename);  // After the write, so no load can cache the old content
+    }
+  }
+
+  std::shared_ptr<const File> Load(const std::string& filename) override {
+    if (!cache_) {
+      return file_storage_service_->Load(filename);
+    }
+    if (auto file = cache_->Get(filename)) {
+      return file;
+    }
+    uint64_t version = cache_->Version(filename);
+    auto file = file_storage_service_->Load(filename);
+    cache_->Insert(file, version);
+    return file;
+  }
+
+ private:
+  FileStorageService* file_storage_service_;
+  FileCache* cache_;
+};
+
+std::atomic<int> FileStorageProxy::instance_count_{0};
+
+void PrintStats(const FileCache& cache) {
+  FileCache::Stats stats = cache.stats();
+  std::cout << "Cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+            << stats.evictions << " evictions, " << stats.invalidations << " invalidations, "
+            << stats.num_files << " files, " << stats.bytes << " bytes" << std::endl;
+}
+
+int main() {
+  {
+    File file1("example.txt", "This is an example file content.");
+    File file2("example2.txt", "This is another example file content.");
+
+    FileStorageService file_storage_service;
+    FileCache cache(1 << 20);
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    IFileStorageProxy* file_storage_proxy1 = new FileStorageProxy(&file_storage_service, &cache);
+    IFileStorageProxy* file_storage_proxy2 = new FileStorageProxy(&file_storage_service, &cache);
+
+    file_storage_proxy1->Store(file1);
+    file_storage_proxy2->Store(file2);
+
+    // Each file is loaded once from the service. Later loads from either proxy are hits.
+    std::shared_ptr<const File> loaded_file1 = file_storage_proxy2->Load("example.txt");
+    std::shared_ptr<const File> loaded_file2 = file_storage_proxy1->Load("example2.txt");
+    for (int i = 0; i < 9; ++i) {
+      loaded_file1 = file_storage_proxy1->Load("example.txt");
+      loaded_file2 = file_storage_proxy2->Load("example2.txt");
+    }
+
+    // Storing again invalidates the cached file, so the next load sees the new content.
+    file_storage_proxy1->Store(File("example.txt", "This is the updated example file content."));
+    loaded_file1 = file_storage_proxy2->Load("example.txt");
+
+    delete file_storage_proxy1;
+    delete file_storage_proxy2;
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Loaded file1: " << loaded_file1->filename()
+              << ", Content: " << loaded_file1->content() << std::endl;
+    std::cout << "Loaded file2: " << loaded_file2->filename()
+              << ", Content: " << loaded_file2->content() << std::endl;
+    PrintStats(cache);
+
+    std::chrono::duration<double, std::milli> duration = end_time - start_time;
+
+    int expected_time = 1000;  // Connection time
+    expected_time += 100 * 3;  // Store time, stored total 3 times
+    expected_time += 100 * 3;  // Load time, loaded from the service total 3 times
+    expected_time += 1000;     // Disconnection time
+
+    std::cout << "Expected Time taken to store and load files: " << expected_time
+              << " + (cache-related overhead) ms" << std::endl;
+    std::cout << "Actual Time taken to store and load files: " << duration.count() << " ms"
+              << std::endl;
+  }
+
+  std::cout << "----------------------------------------" << std::endl;
+  {
+    /*
+      Several threads load from a set of files about four times bigger than the cache, a few
+      files much more often than the rest, while one thread keeps storing new versions.
+    */
+    constexpr int kNumFiles = 256;
+    constexpr size_t kFileSize = 4096;
+    constexpr int kNumThreads = 8;
+    constexpr int kLoadsPerThread = 2000;
+
+    FileStorageService file_storage_service(1);
+    FileCache cache(kNumFiles / 4 * kFileSize);
+    FileStorageProxy writer(&file_storage_service, &cache);
+    for (int i = 0; i < kNumFiles; ++i) {
+      writer.Store(File("file" + std::to_string(i), std::string(kFileSize, 'a')));
+    }
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back([&, t] {
+        FileStorageProxy proxy(&file_storage_service, &cache);
+        std::mt19937 rng(t);
+        std::exponential_distribution<double> popularity(16.0 / kNumFiles);
+        for (int i = 0; i < kLoadsPerThread; ++i) {
+          int index = static_cast<int>(popularity(rng)) % kNumFiles;
+          proxy.Load("file" + std::to_string(index));
+        }
+      });
+    }
+    threads.emplace_back([&] {
+      for (int i = 0; i < 20; ++i) {
+        writer.Store(File("file" + std::to_string(i), std::string(kFileSize, 'b' + i % 20)));
+      }
+    });
+    for (auto& thread : threads) {
+      thread.join();
+    }
+
+    auto end_time = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double, std::milli> duration = end_time - start_time;
+
+    std::cout << kNumThreads * kLoadsPerThread << " loads by " << kNumThreads << " threads in "
+              << duration.count() << " ms" << std::endl;
+    PrintStats(cache);
+  }
+  return 0;
+}